@@ -0,0 +1,167 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#include <LittleFS.h>
+#include <cJSON.h>
+
+#include "core/Heap.h"
+
+#ifndef CORE_HEAP_TRACE
+
+static std::atomic<uint64_t> allocCount{0};
+static std::atomic<uint64_t> allocBytes{0};
+
+void *operator new(size_t size) {
+    allocCount.fetch_add(1, std::memory_order_relaxed);
+    allocBytes.fetch_add(size, std::memory_order_relaxed);
+    if (void *ptr = malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+static void *countingMalloc(size_t size) {
+    allocCount.fetch_add(1, std::memory_order_relaxed);
+    allocBytes.fetch_add(size, std::memory_order_relaxed);
+    return malloc(size);
+}
+
+void operator delete(void *ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+    free(ptr);
+}
+
+namespace alloc {
+    void hookJson() {
+        cJSON_Hooks hooks{countingMalloc, free};
+        cJSON_InitHooks(&hooks);
+    }
+
+    uint64_t count() {
+        return allocCount.load(std::memory_order_relaxed);
+    }
+
+    uint64_t bytes() {
+        return allocBytes.load(std::memory_order_relaxed);
+    }
+
+    void report() {}
+}
+
+#else
+
+// operator new belongs to core/Heap.cpp in traced builds, take the numbers from there
+namespace alloc {
+    void hookJson() {
+        heap::begin();
+    }
+
+    uint64_t count() {
+        return heap::total().allocs;
+    }
+
+    uint64_t bytes() {
+        return heap::total().allocBytes;
+    }
+
+    void report() {
+        printf("%-8s %10s %10s %10s %10s\n", "tag", "live", "peak", "allocs", "frees");
+        for (uint8_t tag = 0; tag < Heap_Tag_Max; tag++) {
+            auto stats = heap::stats((HeapTag) tag);
+            printf("%-8s %10u %10u %10u %10u\n", heap::tagName((HeapTag) tag), stats.liveBytes, stats.peakBytes, stats.allocs, stats.frees);
+        }
+    }
+}
+
+#endif
+
+static std::string benchFilter;
+static size_t failedChecks = 0;
+
+uint64_t Benchmark::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool Benchmark::enabled(std::string_view name) {
+    return benchFilter.empty() || name.find(benchFilter) != std::string_view::npos;
+}
+
+void Benchmark::setFilter(std::string_view filter) {
+    benchFilter = filter;
+}
+
+bool Benchmark::check(bool ok, const char *format, ...) {
+    if (!ok) {
+        failedChecks++;
+        fprintf(stderr, "CHECK FAILED: ");
+        va_list args;
+        va_start(args, format);
+        vfprintf(stderr, format, args);
+        va_end(args);
+        fprintf(stderr, "\n");
+    }
+    return ok;
+}
+
+size_t Benchmark::getFailedCount() {
+    return failedChecks;
+}
+
+Benchmark::Benchmark(std::string_view name, size_t expectedOps) : _name(name) {
+    _samples.reserve(expectedOps);
+}
+
+void Benchmark::begin() {
+    _allocs = alloc::count();
+    _bytes = alloc::bytes();
+    _startNs = now();
+}
+
+void Benchmark::end(size_t ops) {
+    _elapsedNs = now() - _startNs;
+    _allocs = alloc::count() - _allocs;
+    _bytes = alloc::bytes() - _bytes;
+    _ops = ops;
+}
+
+void Benchmark::report() {
+    std::sort(_samples.begin(), _samples.end());
+    auto percentile = [this](double p) -> uint32_t {
+        if (_samples.empty()) {
+            return 0;
+        }
+        return _samples[std::min(_samples.size() - 1, (size_t) (p * (double) _samples.size()))];
+    };
+
+    double ops = _ops ? (double) _ops : 1;
+    printf("%-32s %12.0f ops/s  p50 %8u ns  p90 %8u ns  p99 %8u ns  max %9u ns  %6.2f allocs/op  %8.1f B/op\n",
+           _name.c_str(),
+           _elapsedNs ? ops * 1e9 / (double) _elapsedNs : 0.0,
+           percentile(0.50),
+           percentile(0.90),
+           percentile(0.99),
+           _samples.empty() ? 0 : _samples.back(),
+           (double) _allocs / ops,
+           (double) _bytes / ops
+    );
+}
+
+void writeFile(const char *path, std::string_view content) {
+    File file = LittleFS.open(path, FILE_WRITE, true);
+    if (!file) {
+        fprintf(stderr, "can't write %s\n", path);
+        abort();
+    }
+    file.write(reinterpret_cast<const uint8_t *>(content.data()), content.size());
+    file.close();
+}
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "core/MessageBus.h"
+
+namespace alloc {
+    /**
+     * Process-wide counters fed by the operator new replacement in Benchmark.cpp.
+     */
+    uint64_t count();
+
+    uint64_t bytes();
+
+    /**
+     * cJSON allocates with malloc, route it through the same counters.
+     */
+    void hookJson();
+
+    /**
+     * Per-tag table, only filled in CORE_HEAP_TRACE builds.
+     */
+    void report();
+}
+
+class Benchmark {
+    std::string _name;
+    std::vector<uint32_t> _samples;
+
+    uint64_t _startNs{0};
+    uint64_t _elapsedNs{0};
+    uint64_t _allocs{0};
+    uint64_t _bytes{0};
+    size_t _ops{0};
+public:
+    static uint64_t now();
+
+    static bool enabled(std::string_view name);
+
+    static void setFilter(std::string_view filter);
+
+    /**
+     * A correctness check next to a bench: on failure prints the printf-style message and
+     * makes the run exit non-zero. Returns ok.
+     */
+    static bool check(bool ok, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+    static size_t getFailedCount();
+
+    explicit Benchmark(std::string_view name, size_t expectedOps = 0);
+
+    void begin();
+
+    void sample(uint64_t ns) {
+        _samples.push_back(ns > UINT32_MAX ? UINT32_MAX : (uint32_t) ns);
+    }
+
+    void end(size_t ops);
+
+    void report();
+
+    /**
+     * Measures every call of op separately; a short warm-up run is not recorded.
+     */
+    template<typename F>
+    static void run(std::string_view name, size_t iterations, F &&op) {
+        if (!enabled(name)) {
+            return;
+        }
+        for (size_t idx = 0; idx < iterations / 10; idx++) {
+            op();
+        }
+
+        Benchmark bench(name, iterations);
+        bench.begin();
+        for (size_t idx = 0; idx < iterations; idx++) {
+            auto start = now();
+            op();
+            bench.sample(now() - start);
+        }
+        bench.end(iterations);
+        bench.report();
+    }
+};
+
+/**
+ * Bus that drops everything posted to it, used to measure producers in isolation.
+ */
+class NullMessageBus : public MessageBus {
+public:
+    size_t posted{0};
+
+    void subscribe(MessageSubscriber *) override {}
+
+    void subscribe(MsgId, MessageSubscriber *) override {}
+
+    void subscribe(MsgId, uint32_t, MessageSubscriber *) override {}
+
+    void unsubscribe(MessageSubscriber *) override {}
+
+    void onMessage(const Message &) override {}
+
+    void loop() override {}
+
+    void sendMessage(const Message &) override {}
+
+    PostStatus postMessage(Message::Ptr &msg) override {
+        posted++;
+        msg.reset();
+        return Post_Queued;
+    }
+
+    PostStatus tryPostMessage(Message::Ptr &msg) override {
+        return postMessage(msg);
+    }
+
+    PostStatus postMessageISR(Message::Ptr &msg) override {
+        return postMessage(msg);
+    }
+
+    void *acquireISRSlot(size_t, size_t) override {
+        return nullptr;
+    }
+
+    bool postISRSlot(Message *) override {
+        return false;
+    }
+
+    void scheduleMessage(uint32_t, Message::Ptr &msg) override {
+        postMessage(msg);
+    }
+
+    bool schedule(uint32_t, bool, const std::function<void()> &) override {
+        return false;
+    }
+
+    CorrelationId expectReply(MsgId, uint32_t, ReplyHandler &) override {
+        return 0;
+    }
+
+    void cancelReply(CorrelationId) override {}
+
+    bool retain(MsgId, RetainedCopy) override {
+        return false;
+    }
+
+    std::shared_ptr<const Message> getRetained(MsgId, uint32_t *version) override {
+        if (version) {
+            *version = 0;
+        }
+        return {};
+    }
+
+    uint32_t getRetainedVersion(MsgId) override {
+        return 0;
+    }
+
+    bool setOverflowPolicy(MsgId, OverflowPolicy, uint32_t) override {
+        return true;
+    }
+
+protected:
+    std::vector<std::unique_ptr<MessageSubscriber>> _owned;
+
+    void adopt(MessageSubscriber *subscriber) override {
+        _owned.emplace_back(subscriber);
+    }
+};
+
+void writeFile(const char *path, std::string_view content);
+
+void runBusBenchmarks();
+
+void runPropertiesBenchmarks();
+
+void runJsonBenchmarks();
+
+void runMqttBenchmarks();
+
+void runSimBenchmarks();
+
+void runTraceBenchmarks();
+
+void runStaticBenchmarks();
+
+void runWorkerBenchmarks();
+
+void runTelemetryBenchmarks();
+
+void runBridgeBenchmarks();
+
+void runRateBenchmarks();
+
+void runFileBenchmarks();
@@ -0,0 +1,166 @@
+#include <algorithm>
+#include <cstdio>
+
+#include "Benchmark.h"
+#include "core/service/BridgeService.h"
+#include "core/sim/SimBus.h"
+
+namespace {
+    const char *config = R"({
+    "mqtt": {
+        "uri": "mqtts://broker.local:8883",
+        "username": "device",
+        "password": "secret",
+        "ca-cert-file": "/certs/ca.pem",
+        "client-cert-file": "/certs/client.pem",
+        "client-key-file": "/certs/client.key",
+        "device-name": "%s",
+        "product-name": "fleet"
+    }
+})";
+
+    constexpr size_t Messages = 20000;
+    // messages per burst, a burst every 25 ms against a 20 ms linger
+    constexpr size_t Burst = 20;
+
+    struct Published {
+        std::vector<std::string> payloads;
+        size_t bytes{0};
+    };
+
+    /**
+     * A device on the simulated clock with MqttService and a bridge.
+     */
+    struct Device {
+        TRegistry<TSimMessageBus<10>> registry;
+        MqttService *mqtt;
+        BridgeService *bridge;
+        esp_mqtt_client_handle_t client;
+        Published published;
+
+        Device(const char *name, const CodecRegistry &codecs, uint32_t lingerMs) {
+            char text[512];
+            snprintf(text, sizeof(text), config, name);
+            std::string path = std::string("/bench-bridge-") + name + ".json";
+            writeFile(path.c_str(), text);
+
+            registry.getPropsLoader().addReader("mqtt", defaultPropertiesReader<MqttProperties>);
+            mqtt = &registry.create<MqttService>();
+            bridge = &registry.create<BridgeService>(*mqtt, codecs, "/bus/out", "/bus/in", lingerMs);
+            bridge->exportType<TelemetrySummary>();
+            bridge->importType<TelemetrySummary>();
+            for (auto *service: registry.getServices()) {
+                service->setup();
+            }
+            registry.getPropsLoader().load(path.c_str());
+            registry.getMessageBus().sendMessage(WifiConnected{});
+
+            client = esp_mqtt_fake_last_client();
+            esp_mqtt_fake_set_publish_hook(client, [](void *arg, const char *, const char *data, int len, int, int) {
+                auto &published = *static_cast<Published *>(arg);
+                published.payloads.emplace_back(data, len);
+                published.bytes += len;
+            }, &published);
+        }
+
+        void deliver(const std::string &topic, const std::string &payload) {
+            esp_mqtt_event_t event{};
+            event.event_id = MQTT_EVENT_DATA;
+            event.topic = const_cast<char *>(topic.data());
+            event.topic_len = (int) topic.size();
+            event.data = const_cast<char *>(payload.data());
+            event.data_len = event.total_data_len = (int) payload.size();
+            esp_mqtt_fake_dispatch(client, &event);
+        }
+
+        void settle() {
+            sim::clock().advance(25);
+            registry.getMessageBus().loop();
+        }
+    };
+
+    TelemetrySummary makeSummary(size_t idx) {
+        TelemetrySummary msg;
+        msg.metric = idx % 2 ? "free-heap" : "loop-us";
+        msg.windowMs = 60000;
+        msg.count = 60 + idx % 7;
+        msg.min = 10.0f + (float) (idx % 5);
+        msg.max = 90.0f;
+        msg.mean = 42.5f;
+        msg.p50 = 40.0f;
+        msg.p90 = 80.0f;
+        msg.p99 = 89.0f;
+        return msg;
+    }
+
+    void exportAll(Device &device, const char *name) {
+        auto &bus = device.registry.getMessageBus();
+        size_t idx = 0;
+        Benchmark::run(name, Messages, [&]() {
+            bus.sendMessage(makeSummary(idx));
+            if (++idx % Burst == 0) {
+                device.settle();
+            }
+        });
+        device.settle();
+    }
+
+    /**
+     * Bursts of TelemetrySummary exported by one device and imported by another: publishes
+     * and bytes batched against a publish per message, the importing side re-exporting
+     * nothing although it exports the same type, and the exporter dropping its own echo.
+     */
+    void benchBridge() {
+        if (!Benchmark::enabled("bridge.")) {
+            return;
+        }
+        writeFile("/certs/ca.pem", std::string(1200, 'c'));
+        writeFile("/certs/client.pem", std::string(1100, 'p'));
+        writeFile("/certs/client.key", std::string(1700, 'k'));
+
+        CodecRegistry codecs;
+        addSystemCodecs(codecs);
+
+        Device single("node-single", codecs, 0);
+        exportAll(single, "bridge.export_unbatched");
+
+        Device a("node-a", codecs, 20);
+        Device b("node-b", codecs, 20);
+        exportAll(a, "bridge.export_batched");
+
+        auto topic = std::string("/fleet/node-b/bus/in");
+        size_t idx = 0;
+        auto &batches = a.published.payloads;
+        Benchmark::run("bridge.import_batch", batches.size(), [&]() {
+            b.deliver(topic, batches[idx++ % batches.size()]);
+            b.registry.getMessageBus().loop();
+        });
+        b.settle();
+
+        a.deliver("/fleet/node-a/bus/in", batches.front());
+        a.registry.getMessageBus().loop();
+
+        // MQTT 3.1.1 PUBLISH at QoS 1: fixed header, topic and packet id on top of the payload
+        auto wire = [](const Published &published, size_t topicSize) {
+            return published.bytes + published.payloads.size() * (1 + 2 + 2 + topicSize + 2);
+        };
+        auto &as = a.bridge->getStats();
+        auto &bs = b.bridge->getStats();
+        auto &ss = single.bridge->getStats();
+        printf("  unbatched: %u messages in %u publishes, %zu B on the wire\n",
+               ss.exported, ss.batchesOut, wire(single.published, strlen("/fleet/node-single/bus/out")));
+        printf("  batched:   %u messages in %u publishes, %zu B on the wire (%.1fx fewer publishes, %.1fx fewer bytes)\n",
+               as.exported, as.batchesOut, wire(a.published, strlen("/fleet/node-a/bus/out")),
+               (double) ss.batchesOut / as.batchesOut,
+               (double) wire(single.published, strlen("/fleet/node-single/bus/out")) / wire(a.published, strlen("/fleet/node-a/bus/out")));
+        printf("  importer:  %u imported from %u batches, %u re-exported, %u rejected; exporter echoes dropped: %u\n",
+               bs.imported, bs.batchesIn, bs.exported, bs.rejected, as.echoes);
+        // the batches are alike (half a burst each), so replays during the warmup add up too
+        Benchmark::check(bs.imported == bs.batchesIn * (as.exported / as.batchesOut) && !bs.exported && as.echoes == 1,
+                         "bridge: round trip lost messages or looped");
+    }
+}
+
+void runBridgeBenchmarks() {
+    benchBridge();
+}
@@ -0,0 +1,673 @@
+#include <atomic>
+#include <cstdio>
+#include <thread>
+
+#include "Benchmark.h"
+#include "core/service/SysService.h"
+#include "core/sim/SimBus.h"
+
+namespace {
+    enum BenchMessageId {
+        Bench_Ping,
+        Bench_Msg1,
+        Bench_Msg2,
+        Bench_Msg3,
+        Bench_Telemetry,
+        Bench_Echo_Request,
+        Bench_Echo_Reply,
+        Bench_Unanswered,
+        Bench_Gpio,
+        Bench_Link,
+    };
+
+    struct PingMessage : TMessage<Bench_Ping> {
+        uint64_t sentNs{0};
+        uint32_t seq{0};
+    };
+
+    struct Msg1 : TMessage<Bench_Msg1> {
+        uint32_t value{0};
+    };
+
+    struct Msg2 : TMessage<Bench_Msg2> {
+        uint32_t value{0};
+    };
+
+    struct Msg3 : TMessage<Bench_Msg3> {
+        uint32_t value{0};
+    };
+
+    struct TelemetryMessage : TMessage<Bench_Telemetry> {
+        uint32_t channel{0};
+        uint32_t value{0};
+
+        [[nodiscard]] bool isConflated() const override {
+            return true;
+        }
+
+        [[nodiscard]] uint32_t getKey() const override {
+            return channel;
+        }
+    };
+
+    struct GpioEvent : TMessage<Bench_Gpio> {
+        uint32_t pin;
+        uint32_t level;
+
+        GpioEvent(uint32_t pin, uint32_t level) : pin(pin), level(level) {}
+    };
+
+    struct EchoRequest : TRequest<Bench_Echo_Request> {
+        uint32_t value{0};
+    };
+
+    struct EchoReply : TReply<Bench_Echo_Reply> {
+        uint32_t value{0};
+    };
+
+    struct UnansweredRequest : TRequest<Bench_Unanswered> {
+    };
+
+    class FourWaySubscriber : public TMessageSubscriber<FourWaySubscriber, Msg1, Msg2, Msg3, PingMessage> {
+    public:
+        uint32_t total{0};
+
+        void onMessage(const Msg1 &msg) { total += msg.value; }
+
+        void onMessage(const Msg2 &msg) { total += msg.value; }
+
+        void onMessage(const Msg3 &msg) { total += msg.value; }
+
+        void onMessage(const PingMessage &msg) { total += msg.seq; }
+    };
+
+    void benchPostDispatch() {
+        const char *name = "bus.post_dispatch";
+        if (!Benchmark::enabled(name)) {
+            return;
+        }
+
+        constexpr size_t iterations = 200000;
+        TMessageBus<10> queue;
+        MessageBus &bus = queue;
+        Benchmark bench(name, iterations);
+
+        std::atomic<size_t> received{0};
+        bus.subscribe<PingMessage>([&](const PingMessage &msg) {
+            bench.sample(Benchmark::now() - msg.sentNs);
+            received.fetch_add(1, std::memory_order_release);
+        });
+
+        std::atomic<bool> running{true};
+        std::thread consumer([&]() {
+            while (running.load()) {
+                bus.loop();
+            }
+        });
+
+        bench.begin();
+        for (size_t idx = 0; idx < iterations; idx++) {
+            PingMessage msg;
+            msg.seq = idx;
+            msg.sentNs = Benchmark::now();
+            bus.postMessage(msg);
+        }
+        while (received.load(std::memory_order_acquire) < iterations) {
+            std::this_thread::yield();
+        }
+        bench.end(iterations);
+
+        running = false;
+        consumer.join();
+        bench.report();
+    }
+
+    /**
+     * Cost of postFromISR itself while the bus task drains the events, the "ISR" retries on overflow.
+     */
+    void benchPostFromISR() {
+        const char *name = "bus.post_from_isr";
+        if (!Benchmark::enabled(name)) {
+            return;
+        }
+
+        constexpr size_t iterations = 200000;
+        TMessageBus<10> queue;
+        MessageBus &bus = queue;
+        Benchmark bench(name, iterations);
+
+        std::atomic<size_t> received{0};
+        bus.subscribe<GpioEvent>([&](const GpioEvent &) {
+            received.fetch_add(1, std::memory_order_release);
+        });
+
+        std::atomic<bool> running{true};
+        std::thread consumer([&]() {
+            while (running.load()) {
+                bus.loop();
+            }
+        });
+
+        bench.begin();
+        for (size_t idx = 0; idx < iterations; idx++) {
+            while (true) {
+                auto start = Benchmark::now();
+                bool posted = bus.postFromISR<GpioEvent>((uint32_t) 4, (uint32_t) (idx & 1));
+                bench.sample(Benchmark::now() - start);
+                if (posted) {
+                    break;
+                }
+                std::this_thread::yield();
+            }
+        }
+        while (received.load(std::memory_order_acquire) < iterations) {
+            std::this_thread::yield();
+        }
+        bench.end(iterations);
+
+        running = false;
+        consumer.join();
+        bench.report();
+        printf("  overflows while the bus task lagged: %u\n", queue.getISROverflowCount());
+    }
+
+    /**
+     * Consumer stalled: without conflation the producer would block on the 11th post.
+     */
+    void benchPostConflated() {
+        const char *name = "bus.post_conflated_stalled";
+        if (!Benchmark::enabled(name)) {
+            return;
+        }
+
+        TMessageBus<10> queue;
+        MessageBus &bus = queue;
+        size_t delivered = 0;
+        bus.subscribe<TelemetryMessage>([&delivered](const TelemetryMessage &) {
+            delivered++;
+        });
+
+        TelemetryMessage msg;
+        uint32_t seq = 0;
+        Benchmark::run(name, 200000, [&]() {
+            msg.channel = seq % 4;
+            msg.value = seq++;
+            bus.postMessage(msg);
+        });
+
+        bus.loop();
+        printf("%-32s delivered %zu, replaced %u\n", name, delivered, queue.getReplacedCount());
+    }
+
+    /**
+     * A consumer that stalled: every post after the first ten meets a full queue. Each policy
+     * keeps a different part of the stream and none of them holds the producer.
+     */
+    void benchOverflow(const char *name, OverflowPolicy policy) {
+        if (!Benchmark::enabled(name)) {
+            return;
+        }
+
+        TSimMessageBus<10> queue;
+        MessageBus &bus = queue;
+        queue.setOverflowPolicy(policy, 0);
+        std::vector<uint32_t> delivered;
+        bus.subscribe<Msg1>([&delivered](const Msg1 &msg) {
+            delivered.push_back(msg.value);
+        });
+
+        uint32_t statuses[Post_Dropped + 1]{};
+        Msg1 msg;
+        Benchmark::run(name, 100000, [&]() {
+            msg.value++;
+            statuses[bus.postMessage(msg)]++;
+        });
+
+        bus.loop();
+        printf(
+                "  queued %u, evicted %u, spilled %u, dropped %u (%u of Msg1), delivered %zu: %u..%u\n",
+                statuses[Post_Queued], statuses[Post_Evicted], statuses[Post_Spilled], statuses[Post_Dropped],
+                queue.getDroppedCount(Msg1::ID), delivered.size(), delivered.front(), delivered.back()
+        );
+    }
+
+    void benchOverflowBlock() {
+        const char *name = "bus.overflow_block_5ms";
+        if (!Benchmark::enabled(name)) {
+            return;
+        }
+
+        TMessageBus<10> queue;
+        MessageBus &bus = queue;
+        queue.setOverflowPolicy(Overflow_Block, 5);
+        Msg1 msg;
+        for (size_t idx = 0; idx < 10; idx++) {
+            bus.postMessage(msg);
+        }
+
+        uint32_t dropped = 0;
+        Benchmark::run(name, 50, [&]() {
+            dropped += bus.postMessage(msg) == Post_Dropped;
+        });
+        printf("  dropped %u after the timeout\n", dropped);
+    }
+
+    /**
+     * tryPostMessage() on a full queue whose policy would block forever: a timer or network
+     * task gets Post_Dropped back at once instead of waiting for the bus task.
+     */
+    void benchOverflowTryPost() {
+        const char *name = "bus.overflow_try_post";
+        if (!Benchmark::enabled(name)) {
+            return;
+        }
+
+        TMessageBus<10> queue;
+        MessageBus &bus = queue;
+        Msg1 msg;
+        for (size_t idx = 0; idx < 10; idx++) {
+            bus.postMessage(msg);
+        }
+
+        uint32_t dropped = 0;
+        Benchmark::run(name, 10000, [&]() {
+            dropped += bus.tryPostMessage(msg) == Post_Dropped;
+        });
+        printf("  dropped %u, counted by the bus %u\n", dropped, queue.getDroppedCount(Msg1::ID));
+        Benchmark::check(dropped == 11000 && queue.getDroppedCount(Msg1::ID) == 11000, "%s: a full queue did not drop", name);
+    }
+
+    void benchRequestReply() {
+        const char *name = "bus.request_reply";
+        if (!Benchmark::enabled(name)) {
+            return;
+        }
+
+        TMessageBus<10> queue;
+        MessageBus &bus = queue;
+        bus.subscribe<EchoRequest>([&bus](const EchoRequest &req) {
+            EchoReply rep;
+            rep.value = req.value;
+            bus.reply(req, rep);
+        });
+
+        std::atomic<bool> running{true};
+        std::thread consumer([&]() {
+            while (running.load()) {
+                bus.loop();
+            }
+        });
+
+        EchoRequest req;
+        std::atomic<uint32_t> replied{0};
+        Benchmark::run(name, 50000, [&]() {
+            req.value++;
+            uint32_t expected = replied.load() + 1;
+            bus.request<EchoReply>(req, 1000, [&replied](const EchoReply *rep) {
+                if (rep) {
+                    replied.fetch_add(1, std::memory_order_release);
+                }
+            });
+            while (replied.load(std::memory_order_acquire) != expected) {
+                std::this_thread::yield();
+            }
+        });
+
+        ReplyFuture<EchoReply> future;
+        req.value = 42;
+        bool answered = bus.request<EchoReply>(req, 1000, future) && future.wait() && future.get().value == 42;
+
+        ReplyFuture<EchoReply> expired;
+        auto start = Benchmark::now();
+        bool timedOut = bus.request<EchoReply>(UnansweredRequest{}, 20, expired) && !expired.wait();
+        printf("%-32s future: %s, timeout: %s after %llu ms\n", name, answered ? "ok" : "failed", timedOut ? "ok" : "failed",
+               (unsigned long long) ((Benchmark::now() - start) / 1000000));
+        Benchmark::check(answered && timedOut, "%s: request not answered or not timed out", name);
+
+        running = false;
+        consumer.join();
+
+        // a dropped request fails at once and gives its slot back, twice as many as there are slots
+        bus.setOverflowPolicy(EchoRequest::ID, Overflow_DropNewest);
+        Msg1 filler;
+        for (size_t idx = 0; idx < 10; idx++) {
+            bus.postMessage(filler);
+        }
+        uint32_t refused = 0, called = 0;
+        for (size_t idx = 0; idx < 16; idx++) {
+            refused += !bus.request<EchoReply>(req, 1000, [&called](const EchoReply *) { called++; });
+        }
+        queue.loop();
+        bool again = bus.request<EchoReply>(req, 1000, [&called](const EchoReply *rep) { called += rep != nullptr; });
+        queue.loop();
+        printf("  dropped requests: %u refused, %u callbacks, next request %s\n", refused, called, again ? "ok" : "failed");
+        Benchmark::check(refused == 16 && called == 1 && again, "%s: a dropped request held its slot", name);
+    }
+
+    void benchSendMessage() {
+        TMessageBus<10> queue;
+        MessageBus &bus = queue;
+        // dispatched from this thread as the bus task would
+        queue.bindDispatchTask();
+        uint32_t total = 0;
+        for (int idx = 0; idx < 8; idx++) {
+            bus.subscribe<Msg1>([&total](const Msg1 &msg) {
+                total += msg.value;
+            });
+        }
+
+        Msg1 msg;
+        msg.value = 1;
+        Benchmark::run("bus.send_8_subscribers", 500000, [&]() {
+            bus.sendMessage(msg);
+        });
+    }
+
+    /**
+     * 32 per-topic consumers of MqttMessage: filtering inside each handler vs the bus key index.
+     */
+    void benchTopicConsumers() {
+        constexpr int topics = 32;
+        uint32_t hits = 0;
+
+        TMessageBus<10> plainQueue;
+        MessageBus &plain = plainQueue;
+        TMessageBus<10> keyedQueue;
+        MessageBus &keyed = keyedQueue;
+        TMessageBus<10> filteredQueue;
+        MessageBus &filtered = filteredQueue;
+        plainQueue.bindDispatchTask();
+        keyedQueue.bindDispatchTask();
+        filteredQueue.bindDispatchTask();
+
+        std::vector<std::string> names;
+        for (int idx = 0; idx < topics; idx++) {
+            names.push_back("/bench/device/topic-" + std::to_string(idx));
+        }
+        for (auto &topic: names) {
+            plain.subscribe<MqttMessage>([&hits, &topic](const MqttMessage &msg) {
+                if (msg.topic == topic) {
+                    hits++;
+                }
+            });
+            keyed.subscribe<MqttMessage>(messageKey(topic), [&hits](const MqttMessage &) {
+                hits++;
+            });
+            filtered.subscribe<MqttMessage>([&topic](const MqttMessage &msg) {
+                return msg.topic == topic;
+            }, [&hits](const MqttMessage &) {
+                hits++;
+            });
+        }
+
+        MqttMessage msg;
+        msg.topic = names[topics / 2];
+        Benchmark::run("bus.topic_32_handler_filter", 500000, [&]() {
+            plain.sendMessage(msg);
+        });
+        Benchmark::run("bus.topic_32_predicate_index", 500000, [&]() {
+            filtered.sendMessage(msg);
+        });
+        Benchmark::run("bus.topic_32_key_index", 500000, [&]() {
+            keyed.sendMessage(msg);
+        });
+    }
+
+    /**
+     * Dispatch on this thread while two threads subscribe and unsubscribe callbacks and a handler
+     * adds one-shot subscribers that drop themselves from inside their own delivery. The steady
+     * subscriber has to see every message and nothing may stay retired once the churn stops.
+     */
+    void benchSubscribeChurn() {
+        constexpr size_t messages = 200000;
+        if (!Benchmark::enabled("bus.subscribe_churn")) {
+            return;
+        }
+        TMessageBus<10> queue;
+        MessageBus &bus = queue;
+        // a read from another task before dispatch starts must not take the tables over
+        size_t early = 1;
+        std::thread([&queue, &early]() {
+            early = queue.getSubscriberCount();
+        }).join();
+        // dispatch runs here, the churn threads read as guests
+        queue.bindDispatchTask();
+        std::atomic<uint32_t> steady{0}, churned{0}, oneShots{0};
+        std::atomic<bool> running{true};
+
+        bus.subscribe<Msg1>([&steady](const Msg1 &) {
+            steady++;
+        });
+        bus.subscribe<Msg1>([&bus, &oneShots](const Msg1 &msg) {
+            if (msg.value % 1000 == 0) {
+                auto *self = new MessageSubscriber *{};
+                *self = bus.subscribe<Msg1>([&bus, &oneShots, self](const Msg1 &) {
+                    oneShots++;
+                    bus.unsubscribe(*self);
+                    delete self;
+                });
+            }
+        });
+
+        std::vector<std::thread> churn;
+        for (int idx = 0; idx < 2; idx++) {
+            churn.emplace_back([&bus, &running, &churned]() {
+                while (running) {
+                    auto *sub = bus.subscribe<Msg1>([&churned](const Msg1 &) {
+                        churned++;
+                    });
+                    std::this_thread::yield();
+                    bus.unsubscribe(sub);
+                }
+            });
+        }
+
+        Msg1 msg;
+        Benchmark bench("bus.subscribe_churn");
+        bench.begin();
+        for (size_t idx = 1; idx <= messages; idx++) {
+            msg.value = idx;
+            auto start = Benchmark::now();
+            bus.sendMessage(msg);
+            bench.sample(Benchmark::now() - start);
+        }
+        bench.end(messages);
+        running = false;
+        for (auto &thread: churn) {
+            thread.join();
+        }
+        bench.report();
+
+        // a one-shot subscribed by the last messages may still be waiting for its first delivery
+        msg.value = 1;
+        bus.sendMessage(msg);
+        bool ok = early == 0 && steady == messages + 1 && oneShots == messages / 1000 && queue.getSubscriberCount() == 2 && queue.getRetiredCount() == 0;
+        printf("%-32s steady %u/%zu, churned deliveries %u, one-shots %u, retired %zu: %s\n", "", steady.load(), messages + 1,
+               churned.load(), oneShots.load(), queue.getRetiredCount(), ok ? "ok" : "FAILED");
+        Benchmark::check(ok, "bus.subscribe_churn: lost deliveries or leaked tables");
+    }
+
+    // last-value state, as WifiConnected
+    struct LinkState : TMessage<Bench_Link> {
+        FixedString<15> ip;
+        uint32_t seq{0};
+    };
+
+    /**
+     * Retained state: what an update costs the dispatch (one copy), what a reader pays for a
+     * snapshot or a version check instead of keeping its own copy, and a late subscriber
+     * getting the current value replayed.
+     */
+    void benchRetained() {
+        if (!Benchmark::enabled("bus.retained_")) {
+            return;
+        }
+        TSimMessageBus<10> queue;
+        MessageBus &bus = queue;
+        queue.bindDispatchTask();
+        uint32_t total = 0;
+        bus.subscribe<LinkState>([&total](const LinkState &msg) {
+            total += msg.seq;
+        });
+
+        LinkState link;
+        link.ip = "192.168.100.200";
+        Benchmark::run("bus.retained_send_plain", 500000, [&]() {
+            link.seq++;
+            bus.sendMessage(link);
+        });
+        bus.retain<LinkState>();
+        Benchmark::run("bus.retained_send_retained", 500000, [&]() {
+            link.seq++;
+            bus.sendMessage(link);
+        });
+
+        uint32_t seen = 0;
+        Benchmark::run("bus.retained_snapshot", 1000000, [&]() {
+            seen += bus.getRetained<LinkState>()->seq;
+        });
+        uint32_t version = 0;
+        Benchmark::run("bus.retained_version", 1000000, [&]() {
+            version += bus.getRetainedVersion<LinkState>();
+        });
+
+        uint32_t first = 0, second = 0;
+        std::string ip;
+        bus.subscribe<LinkState>([&](const LinkState &msg) {
+            first++;
+            ip = msg.ip;
+        });
+        bus.loop();
+        // a newer value dispatched after subscribe() is not replayed on top of it
+        bus.subscribe<LinkState>([&](const LinkState &) {
+            second++;
+        });
+        link.seq++;
+        bus.sendMessage(link);
+        bus.loop();
+        printf("  late subscribers: %u and %u deliveries (expected 2 and 1), ip %s\n", first, second, ip.c_str());
+        Benchmark::check(first == 2 && second == 1, "bus.retained: late subscribers got %u and %u deliveries", first, second);
+    }
+
+    // every message it gets, for the order of a replay
+    struct ReplayLog : MessageSubscriber {
+        std::vector<MsgId> ids;
+
+        void onMessage(const Message &msg) override {
+            ids.push_back(msg.getMsgId());
+        }
+    };
+
+    /**
+     * Connection state retained as MqttService does, Connected registered before Disconnected:
+     * a late subscriber must end with the one dispatched last, whichever that was.
+     */
+    void benchRetainedOrder() {
+        const char *name = "bus.retained_order";
+        if (!Benchmark::enabled(name)) {
+            return;
+        }
+        bool ok = true;
+        for (bool reconnected: {true, false}) {
+            TSimMessageBus<10> queue;
+            MessageBus &bus = queue;
+            queue.bindDispatchTask();
+            bus.retain<MqttConnected>();
+            bus.retain<MqttDisconnected>();
+            bus.retain<MqttReady>();
+            if (reconnected) {
+                bus.sendMessage(MqttDisconnected{});
+                bus.sendMessage(MqttConnected{});
+            } else {
+                bus.sendMessage(MqttConnected{});
+                bus.sendMessage(MqttDisconnected{});
+            }
+
+            ReplayLog log;
+            bus.subscribe(&log);
+            bus.loop();
+            MsgId expected = reconnected ? (MsgId) MqttConnected::ID : (MsgId) MqttDisconnected::ID;
+            bool last = log.ids.size() == 2 && log.ids.back() == expected;
+            printf("%-32s %-12s replayed %zu, ends on the latest: %s\n", name, reconnected ? "reconnected" : "disconnected",
+                   log.ids.size(), last ? "ok" : "FAILED");
+            ok &= last;
+            bus.unsubscribe(&log);
+        }
+        Benchmark::check(ok, "%s: a late subscriber ended on the older connection state", name);
+    }
+
+    /**
+     * Core messages as they are retained and posted: the copy a retained WifiConnected takes on
+     * every dispatch, and a posted TelemetrySummary, next to the inline sizes the build checks.
+     */
+    void benchMessageCopy() {
+        if (!Benchmark::enabled("bus.copy_")) {
+            return;
+        }
+        printf("  sizeof: WifiConnected %zu, TelemetrySummary %zu, MqttReady %zu, Message %zu\n",
+               sizeof(WifiConnected), sizeof(TelemetrySummary), sizeof(MqttReady), sizeof(Message));
+
+        TSimMessageBus<10> queue;
+        MessageBus &bus = queue;
+        queue.bindDispatchTask();
+        bus.retain<WifiConnected>();
+        WifiConnected wifi;
+        wifi.ip = "192.168.100.200";
+        wifi.gw = "192.168.100.1";
+        wifi.mask = "255.255.255.0";
+        wifi.mac = "24:6F:28:A1:B2:C3";
+        Benchmark::run("bus.copy_wifi_retained", 500000, [&]() {
+            wifi.totalMs++;
+            bus.sendMessage(wifi);
+        });
+
+        uint32_t count = 0;
+        bus.subscribe<TelemetrySummary>([&count](const TelemetrySummary &msg) {
+            count += msg.count;
+        });
+        TelemetrySummary summary;
+        summary.metric = "mqtt-publish-latency-us";
+        summary.count = 1;
+        Benchmark::run("bus.copy_summary_posted", 500000, [&]() {
+            bus.postMessage(summary);
+            bus.loop();
+        });
+    }
+
+    void benchSubscriberDispatch() {
+        FourWaySubscriber subscriber;
+        PingMessage ping;
+        ping.seq = 1;
+        MessageSubscriber &base = subscriber;
+        Benchmark::run("subscriber.dispatch_4_types", 1000000, [&]() {
+            base.onMessage(ping);
+        });
+
+        Msg2 other;
+        TMessageFuncSubscriber<Msg1> func([&subscriber](const Msg1 &msg) {
+            subscriber.total += msg.value;
+        });
+        Benchmark::run("subscriber.func_miss", 1000000, [&]() {
+            func.onMessage(other);
+        });
+    }
+}
+
+void runBusBenchmarks() {
+    benchPostDispatch();
+    benchPostFromISR();
+    benchPostConflated();
+    benchOverflow("bus.overflow_drop_newest", Overflow_DropNewest);
+    benchOverflow("bus.overflow_drop_oldest", Overflow_DropOldest);
+    benchOverflow("bus.overflow_spill", Overflow_Spill);
+    benchOverflowBlock();
+    benchOverflowTryPost();
+    benchRequestReply();
+    benchSendMessage();
+    benchRetained();
+    benchRetainedOrder();
+    benchMessageCopy();
+    benchSubscriberDispatch();
+    benchSubscribeChurn();
+    benchTopicConsumers();
+}
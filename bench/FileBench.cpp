@@ -0,0 +1,182 @@
+#include <algorithm>
+#include <cstdio>
+
+#include "Benchmark.h"
+#include "core/service/FileService.h"
+
+namespace {
+    const char *bootFiles[] = {
+            "/bench-file/config.json", "/bench-file/ca.pem", "/bench-file/client.pem", "/bench-file/client.key",
+    };
+
+    const char *scanFile = "/bench-file/trace.bin";
+    constexpr size_t ScanSize = 64 * 1024;
+    constexpr size_t ScanChunk = 64;
+
+    void writeFiles() {
+        std::string config = "{\n    \"mqtt\": {\n";
+        while (config.size() < 900) {
+            config += "        \"key-" + std::to_string(config.size()) + "\": \"value\",\n";
+        }
+        config += "        \"end\": true\n    }\n}\n";
+        writeFile(bootFiles[0], config);
+        writeFile(bootFiles[1], std::string(1200, 'c'));
+        writeFile(bootFiles[2], std::string(1100, 'p'));
+        writeFile(bootFiles[3], std::string(1700, 'k'));
+        std::string scan(ScanSize, '\0');
+        for (size_t idx = 0; idx < scan.size(); idx++) {
+            scan[idx] = (char) (idx * 31);
+        }
+        writeFile(scanFile, scan);
+    }
+
+    // how MqttService and PropertiesLoader read files before FileCache
+    void readLegacy(const char *path, std::string &result) {
+        if (auto file = LittleFS.open(path); file) {
+            result.clear();
+            while (file.available()) {
+                result.append(file.readString().c_str());
+            }
+        }
+    }
+
+    void printStats(FileCache &cache, std::string_view prefix) {
+        cache.forEachStats([prefix](const FileStats &stats) {
+            if (stats.path.view().substr(0, prefix.size()) == prefix) {
+                printf("  %-24s %6u reads %8u B  blocks %5u hit %5u missed %5u ahead  %5u opens %7u us\n",
+                       stats.path.c_str(), stats.reads, stats.bytes, stats.hits, stats.misses, stats.prefetched,
+                       stats.opens, stats.ioUs);
+            }
+        });
+    }
+
+    /**
+     * The config and the three certificates a boot reads: the old grow-as-you-go loop, sized
+     * reads from flash and sized reads the cache answers.
+     */
+    void benchBootFiles() {
+        if (!Benchmark::enabled("file.boot_")) {
+            return;
+        }
+        std::string out;
+        Benchmark::run("file.boot_legacy", 20000, [&]() {
+            for (auto *path: bootFiles) {
+                readLegacy(path, out);
+            }
+        });
+
+        FileCache cold;
+        Benchmark::run("file.boot_sized", 20000, [&]() {
+            for (auto *path: bootFiles) {
+                cold.invalidate(path);
+                cold.read(path, out);
+            }
+        });
+
+        FileCache warm;
+        Benchmark::run("file.boot_cached", 20000, [&]() {
+            for (auto *path: bootFiles) {
+                warm.read(path, out);
+            }
+        });
+        printStats(warm, "/bench-file/c");
+    }
+
+    /**
+     * A 64 KB file read front to back in 64 byte chunks, with and without read-ahead, and the
+     * same scan interleaved with config reads to show the scan does not evict them.
+     */
+    void benchScan() {
+        if (!Benchmark::enabled("file.scan_")) {
+            return;
+        }
+        uint8_t chunk[ScanChunk];
+        for (size_t ahead: {0, 2, 6}) {
+            FileCache cache(16, ahead);
+            char name[48];
+            snprintf(name, sizeof(name), "file.scan_64b_ahead_%zu", ahead);
+            uint32_t sum = 0;
+            size_t offset = 0;
+            Benchmark::run(name, ScanSize / ScanChunk * 10, [&]() {
+                if (offset >= ScanSize) {
+                    offset = 0;
+                    cache.invalidate(scanFile);
+                }
+                cache.read(scanFile, offset, chunk, sizeof(chunk));
+                sum += chunk[0];
+                offset += ScanChunk;
+            });
+            printStats(cache, scanFile);
+        }
+
+        FileCache cache;
+        std::string config;
+        cache.read(bootFiles[0], config);
+        size_t offset = 0;
+        for (size_t idx = 0; idx < ScanSize / ScanChunk; idx++, offset += ScanChunk) {
+            cache.read(scanFile, offset, chunk, sizeof(chunk));
+            if (idx % 64 == 0) {
+                cache.read(bootFiles[0], config);
+            }
+        }
+        printStats(cache, bootFiles[0]);
+    }
+
+    /**
+     * Batches of readAsync() through a worker and the bus, the content checked against a
+     * synchronous read. bus.loop() returns only after a full idle wait, so an op is a batch
+     * and its time includes that wait.
+     */
+    void benchAsync() {
+        if (!Benchmark::enabled("file.read_async")) {
+            return;
+        }
+        constexpr size_t Batch = 16;
+        TRegistry<TMessageBus<10>> registry;
+        auto &workers = registry.create<WorkerService>(1, 4);
+        auto &files = registry.create<FileService>(workers);
+        workers.setup();
+        auto &bus = registry.getMessageBus();
+
+        size_t received = 0;
+        size_t mismatched = 0;
+        size_t refused = 0;
+        std::string expected;
+        files.getCache().read(bootFiles[3], expected);
+        bus.subscribe<FileRead>([&](const FileRead &msg) {
+            received++;
+            if (msg.status != ESP_OK || msg.data != expected) {
+                mismatched++;
+            }
+        });
+        Benchmark::run("file.read_async_x16", 20, [&]() {
+            auto target = received;
+            for (size_t idx = 0; idx < Batch; idx++) {
+                if (files.readAsync(bootFiles[3])) {
+                    target++;
+                } else {
+                    refused++;
+                }
+            }
+            while (received < target) {
+                bus.loop();
+            }
+        });
+        printf("  %zu delivered, %zu mismatched, %zu refused\n", received, mismatched, refused);
+        Benchmark::check(received && !mismatched, "file.read_async: %zu of %zu reads differ", mismatched, received);
+    }
+}
+
+void runFileBenchmarks() {
+    const char *names[] = {
+            "file.boot_legacy", "file.boot_sized", "file.boot_cached",
+            "file.scan_64b_ahead_0", "file.scan_64b_ahead_2", "file.scan_64b_ahead_6", "file.read_async_x16",
+    };
+    if (std::none_of(std::begin(names), std::end(names), Benchmark::enabled)) {
+        return;
+    }
+    writeFiles();
+    benchBootFiles();
+    benchScan();
+    benchAsync();
+}
@@ -0,0 +1,141 @@
+#include <cstdio>
+
+#include "Benchmark.h"
+#include "core/service/MqttService.h"
+
+namespace {
+    enum BenchJsonId {
+        Bench_Json_Status = 0x20,
+        Bench_Json_Command,
+        Bench_Json_Device,
+    };
+
+    struct StatusSample : TMessage<Bench_Json_Status> {
+        std::string status;
+        uint32_t timestamp{0};
+        uint32_t heap{0};
+        int32_t rssi{0};
+    };
+
+    struct CommandSample : TMessage<Bench_Json_Command> {
+        uint8_t actionId{0};
+        uint32_t value{0};
+    };
+
+    /**
+     * A slow-changing device: uptime moves every sample, heap and rssi now and then, the rest
+     * hardly ever.
+     */
+    struct DeviceSample : TMessage<Bench_Json_Device> {
+        std::string status{"active"};
+        std::string firmware{"1.4.2"};
+        std::string ip{"192.168.1.42"};
+        uint32_t uptime{0};
+        uint32_t freeHeap{180000};
+        int32_t rssi{-61};
+        uint8_t channel{6};
+        bool mqttConnected{true};
+        uint32_t errors{0};
+        float temperature{41.5f};
+    };
+
+    const char *commandJson = R"({"action-id": 7, "value": 123456})";
+}
+
+void toJson(const StatusSample &msg, cJSON *json) {
+    cJSON_AddStringToObject(json, "status", msg.status.c_str());
+    cJSON_AddNumberToObject(json, "timestamp", msg.timestamp);
+    cJSON_AddNumberToObject(json, "heap", msg.heap);
+    cJSON_AddNumberToObject(json, "rssi", msg.rssi);
+}
+
+void fromJson(cJSON *json, CommandSample &msg) {
+    cJSON *item = json->child;
+    while (item) {
+        if (!strcmp(item->string, "action-id") && item->type == cJSON_Number) {
+            msg.actionId = (uint8_t) item->valuedouble;
+        } else if (!strcmp(item->string, "value") && item->type == cJSON_Number) {
+            msg.value = (uint32_t) item->valuedouble;
+        }
+        item = item->next;
+    }
+}
+
+void toJson(const DeviceSample &msg, cJSON *json) {
+    cJSON_AddStringToObject(json, "status", msg.status.c_str());
+    cJSON_AddStringToObject(json, "firmware", msg.firmware.c_str());
+    cJSON_AddStringToObject(json, "ip", msg.ip.c_str());
+    cJSON_AddNumberToObject(json, "uptime", msg.uptime);
+    cJSON_AddNumberToObject(json, "free-heap", msg.freeHeap);
+    cJSON_AddNumberToObject(json, "rssi", msg.rssi);
+    cJSON_AddNumberToObject(json, "channel", msg.channel);
+    cJSON_AddBoolToObject(json, "mqtt-connected", msg.mqttConnected);
+    cJSON_AddNumberToObject(json, "errors", msg.errors);
+    cJSON_AddNumberToObject(json, "temperature", msg.temperature);
+}
+
+namespace {
+    DeviceSample deviceAt(uint32_t second) {
+        DeviceSample sample;
+        sample.uptime = second;
+        sample.freeHeap = 180000 - (second / 7 % 4) * 512;
+        sample.rssi = -61 - (int32_t) (second / 13 % 3);
+        sample.errors = second / 300;
+        sample.temperature = 41.5f + (float) (second / 60 % 2) * 0.5f;
+        return sample;
+    }
+
+    /**
+     * Ten minutes of a 1 Hz device status, full JSON every second against change-only
+     * publishing with a keyframe a minute.
+     */
+    void benchDelta() {
+        if (!Benchmark::enabled("json.delta_device_1hz")) {
+            return;
+        }
+        NullMessageBus bus;
+        size_t fullBytes = 0;
+        for (uint32_t second = 0; second < 600; second++) {
+            auto mqtt = makeJsonMqttMsg("/status", deviceAt(second));
+            fullBytes += static_cast<MqttMessage &>(*mqtt).payload.size();
+        }
+
+        JsonDeltaPublisher delta(60);
+        for (uint32_t second = 0; second < 600; second++) {
+            delta.send(bus, "/status", deviceAt(second));
+        }
+        auto &stats = delta.getStats();
+        printf("%-32s 600 samples: full %zu B, delta %llu B (%.1fx fewer), %u keyframes, %u deltas, %u unchanged\n",
+               "json.delta_device_1hz", fullBytes, (unsigned long long) stats.bytes, (double) fullBytes / stats.bytes,
+               stats.keyframes, stats.deltas, stats.unchanged);
+
+        uint32_t second = 0;
+        Benchmark::run("json.encode_device_full", 100000, [&]() {
+            sendJsonMqttMsg(bus, "/status", deviceAt(second++));
+        });
+        second = 0;
+        Benchmark::run("json.encode_device_delta", 100000, [&]() {
+            delta.send(bus, "/status", deviceAt(second++));
+        });
+    }
+}
+
+void runJsonBenchmarks() {
+    NullMessageBus bus;
+
+    StatusSample status;
+    status.status = "active";
+    status.timestamp = 123456;
+    status.heap = 180000;
+    status.rssi = -61;
+    Benchmark::run("json.encode_status", 100000, [&]() {
+        sendJsonMqttMsg(bus, "/status", status);
+    });
+
+    std::string_view payload(commandJson);
+    Benchmark::run("json.decode_command", 100000, [&]() {
+        recvJsonMqttMsg<CommandSample>(bus, payload);
+    });
+
+    benchDelta();
+}
@@ -0,0 +1,386 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#include "Benchmark.h"
+#include "core/service/MqttService.h"
+#include "core/sim/SimBus.h"
+
+namespace {
+    const char *config = R"({
+    "mqtt": {
+        "uri": "mqtts://broker.local:8883",
+        "username": "device",
+        "password": "secret",
+        "ca-cert-file": "/certs/ca.pem",
+        "client-cert-file": "/certs/client.pem",
+        "client-key-file": "/certs/client.key",
+        "device-name": "bench-device",
+        "product-name": "bench-product"
+    }
+})";
+
+    void injectData(esp_mqtt_client_handle_t client, std::string &topic, std::string &payload, size_t fragment) {
+        for (size_t offset = 0; offset < payload.size(); offset += fragment) {
+            esp_mqtt_event_t event{};
+            event.event_id = MQTT_EVENT_DATA;
+            // like esp-mqtt, only the first fragment carries the topic
+            if (!offset) {
+                event.topic = topic.data();
+                event.topic_len = (int) topic.size();
+            }
+            event.data = payload.data() + offset;
+            event.data_len = (int) std::min(fragment, payload.size() - offset);
+            event.current_data_offset = (int) offset;
+            event.total_data_len = (int) payload.size();
+            esp_mqtt_fake_dispatch(client, &event);
+        }
+    }
+}
+
+namespace {
+    /**
+     * 4 KB MqttMessage posted to a bus with three subscribers keeping the payload and MqttService
+     * publishing it: with shared buffers nothing copies the payload after the producer.
+     */
+    void benchPublishFanout() {
+        const char *name = "mqtt.publish_4k_fanout";
+        if (!Benchmark::enabled(name)) {
+            return;
+        }
+
+        TRegistry<TSimMessageBus<10>> registry;
+        registry.getPropsLoader().addReader("mqtt", defaultPropertiesReader<MqttProperties>);
+        auto &mqtt = registry.create<MqttService>();
+        mqtt.setup();
+        registry.getPropsLoader().load("/bench-mqtt.json");
+        registry.getMessageBus().sendMessage(WifiConnected{});
+
+        size_t published = 0;
+        esp_mqtt_fake_set_publish_hook(esp_mqtt_fake_last_client(), [](void *arg, const char *, const char *, int len, int, int) {
+            *static_cast<size_t *>(arg) += len;
+        }, &published);
+
+        MessageBus &bus = registry.getMessageBus();
+        MqttMessage msg;
+        msg.topic = "/telemetry/snapshot";
+        msg.payload = std::string(4096, 'x');
+        std::vector<decltype(msg.payload)> kept(3);
+        for (size_t idx = 0; idx < kept.size(); idx++) {
+            bus.subscribe<MqttMessage>([&kept, idx](const MqttMessage &msg) {
+                kept[idx] = msg.payload;
+            });
+        }
+
+        Benchmark::run(name, 50000, [&]() {
+            bus.postMessage(msg);
+            bus.loop();
+        });
+        Benchmark::check(published == 55000 * msg.payload.size(), "mqtt: published %zu bytes", published);
+    }
+
+    void benchPublishTopic() {
+        if (!Benchmark::enabled("mqtt.publish_by_")) {
+            return;
+        }
+
+        TRegistry<TSimMessageBus<10>> registry;
+        registry.getPropsLoader().addReader("mqtt", defaultPropertiesReader<MqttProperties>);
+        auto &mqtt = registry.create<MqttService>();
+        // registered before the config sets the prefix, resolved again once it does
+        auto topic = mqtt.addTopic("/telemetry/temperature", 1);
+        mqtt.setup();
+        registry.getPropsLoader().load("/bench-mqtt.json");
+        registry.getMessageBus().sendMessage(WifiConnected{});
+
+        std::string last;
+        esp_mqtt_fake_set_publish_hook(esp_mqtt_fake_last_client(), [](void *arg, const char *topic, const char *, int, int, int) {
+            auto &last = *static_cast<std::string *>(arg);
+            if (last != topic) {
+                last = topic;
+            }
+        }, &last);
+
+        std::string payload(64, 'p');
+        Benchmark::run("mqtt.publish_by_topic_string", 200000, [&]() {
+            mqtt.publish("/telemetry/temperature", 1, payload);
+        });
+        Benchmark::run("mqtt.publish_by_topic_id", 200000, [&]() {
+            mqtt.publish(topic, payload);
+        });
+        Benchmark::check(last == "/bench-product/bench-device/telemetry/temperature", "mqtt: published to %s", last.c_str());
+
+        // a new device name once the client runs keeps the old prefix until a restart
+        std::string renamed(config);
+        renamed.replace(renamed.find("bench-device"), strlen("bench-device"), "renamed-device");
+        writeFile("/bench-mqtt-renamed.json", renamed);
+        registry.getPropsLoader().load("/bench-mqtt-renamed.json");
+        mqtt.publish(topic, payload);
+        Benchmark::check(last == "/bench-product/bench-device/telemetry/temperature", "mqtt: after a rename published to %s", last.c_str());
+    }
+
+    struct SubscribeLog {
+        std::vector<int> acks;
+        size_t packets{0};
+        size_t bytes{0};
+    };
+
+    // SUBSCRIBE wire size: fixed header, packet id, then length, filter and qos per topic
+    size_t subscribeBytes(const esp_mqtt_topic_t *topics, int size) {
+        size_t remaining = 2;
+        for (int idx = 0; idx < size; idx++) {
+            remaining += 2 + strlen(topics[idx].filter) + 1;
+        }
+        return 1 + (remaining < 128 ? 1 : 2) + remaining;
+    }
+
+    /**
+     * Reconnect with 32 inbound topics: what a clean session costs in SUBSCRIBE packets and
+     * bytes batched versus a packet per topic, and a resumed persistent session that sends none.
+     * The time is the esp-mqtt task's share per reconnect, CONNACK to MqttReady.
+     */
+    void benchResubscribe() {
+        const char *name = "mqtt.resubscribe_32";
+        if (!Benchmark::enabled("mqtt.resubscribe_")) {
+            return;
+        }
+        std::string persistent(config);
+        persistent.replace(persistent.find("\"uri\""), 0, "\"persistent-session\": true,\n        ");
+        writeFile("/bench-mqtt-persistent.json", persistent);
+
+        for (bool resume: {false, true}) {
+            TRegistry<TSimMessageBus<10>> registry;
+            registry.getPropsLoader().addReader("mqtt", defaultPropertiesReader<MqttProperties>);
+            auto &mqtt = registry.create<MqttService>();
+            mqtt.setup();
+            registry.getPropsLoader().load(resume ? "/bench-mqtt-persistent.json" : "/bench-mqtt.json");
+            for (int idx = 0; idx < 32; idx++) {
+                char topic[48];
+                snprintf(topic, sizeof(topic), "/actuator/channel-%02d/set", idx);
+                mqtt.subscribe(topic, 1, [](std::string_view, std::string_view) {});
+            }
+            auto &bus = registry.getMessageBus();
+            bus.sendMessage(WifiConnected{});
+
+            MqttReady ready;
+            size_t readyCount = 0;
+            bus.subscribe<MqttReady>([&](const MqttReady &msg) {
+                ready = msg;
+                readyCount++;
+            });
+
+            auto client = esp_mqtt_fake_last_client();
+            SubscribeLog log;
+            esp_mqtt_fake_set_subscribe_hook(client, [](void *arg, int msgId, const esp_mqtt_topic_t *topics, int size) {
+                auto &log = *static_cast<SubscribeLog *>(arg);
+                log.acks.push_back(msgId);
+                log.packets++;
+                log.bytes += subscribeBytes(topics, size);
+            }, &log);
+
+            esp_mqtt_event_t connecting{};
+            connecting.event_id = MQTT_EVENT_BEFORE_CONNECT;
+            esp_mqtt_event_t connected{};
+            connected.event_id = MQTT_EVENT_CONNECTED;
+            connected.session_present = resume;
+            auto reconnect = [&]() {
+                esp_mqtt_fake_dispatch(client, &connecting);
+                esp_mqtt_fake_dispatch(client, &connected);
+                // the broker acks after the last packet is out
+                for (int msgId: log.acks) {
+                    esp_mqtt_event_t subscribed{};
+                    subscribed.event_id = MQTT_EVENT_SUBSCRIBED;
+                    subscribed.msg_id = msgId;
+                    esp_mqtt_fake_dispatch(client, &subscribed);
+                }
+                log.acks.clear();
+                bus.loop();
+            };
+            // the first connect of a persistent session is a fresh one
+            if (resume) {
+                connected.session_present = 0;
+                reconnect();
+                connected.session_present = 1;
+            }
+
+            constexpr size_t iterations = 5000;
+            log = SubscribeLog{};
+            readyCount = 0;
+            Benchmark::run(resume ? "mqtt.resubscribe_resumed" : name, iterations, reconnect);
+            if (!readyCount) {
+                continue;
+            }
+            size_t perTopic = 0;
+            for (int idx = 0; idx < 32; idx++) {
+                char topic[80];
+                snprintf(topic, sizeof(topic), "/bench-product/bench-device/actuator/channel-%02d/set", idx);
+                esp_mqtt_topic_t single{topic, 1};
+                perTopic += subscribeBytes(&single, 1);
+            }
+            printf("  per reconnect: %zu packets, %zu bytes (a packet per topic: 32, %zu bytes), ready %u ms, topics %u, session %s\n",
+                   log.packets / readyCount, log.bytes / readyCount, perTopic,
+                   ready.readyMs, ready.topics, ready.sessionPresent ? "resumed" : "new");
+        }
+    }
+
+    /**
+     * Handoff while the bus task is stuck: more pooled buffers than queue slots, so the queue
+     * fills first. The esp-mqtt task has to keep going and count what it could not hand over.
+     */
+    void benchHandoffStalled() {
+        const char *name = "mqtt.handoff_bus_stalled";
+        if (!Benchmark::enabled(name)) {
+            return;
+        }
+
+        TRegistry<TMessageBus<10>> registry;
+        registry.getPropsLoader().addReader("mqtt", defaultPropertiesReader<MqttProperties>);
+        auto &mqtt = registry.create<MqttService>((size_t) 64, (size_t) 32);
+        mqtt.setup();
+        registry.getPropsLoader().load("/bench-mqtt.json");
+        registry.getMessageBus().sendMessage(WifiConnected{});
+        size_t received = 0;
+        mqtt.subscribe("/data", 0, [&received](std::string_view, std::string_view) {
+            received++;
+        });
+        auto client = esp_mqtt_fake_last_client();
+
+        std::string topic = "/bench-product/bench-device/data";
+        std::string small(64, 's');
+        constexpr size_t Messages = 1000;
+        Benchmark::run(name, Messages, [&]() {
+            injectData(client, topic, small, small.size());
+        });
+        registry.getMessageBus().loop();
+        printf("  delivered %zu, dropped %u of %zu\n", received, mqtt.getDroppedCount(), Messages * 11 / 10);
+        Benchmark::check(received + mqtt.getDroppedCount() == Messages * 11 / 10 && received == 10,
+                         "%s: lost or blocked messages", name);
+    }
+}
+
+void runMqttBenchmarks() {
+    const char *names[] = {
+            "mqtt.data_single", "mqtt.data_4k_in_8_fragments", "mqtt.slow_handler_direct",
+            "mqtt.handoff_single", "mqtt.handoff_4k_in_8_fragments", "mqtt.slow_handler_handoff",
+            "mqtt.publish_4k_fanout", "mqtt.publish_by_topic_string", "mqtt.publish_by_topic_id",
+            "mqtt.resubscribe_32", "mqtt.resubscribe_resumed", "mqtt.handoff_bus_stalled",
+    };
+    if (std::none_of(std::begin(names), std::end(names), Benchmark::enabled)) {
+        return;
+    }
+    writeFile("/bench-mqtt.json", config);
+    writeFile("/certs/ca.pem", std::string(1200, 'c'));
+    writeFile("/certs/client.pem", std::string(1100, 'p'));
+    writeFile("/certs/client.key", std::string(1700, 'k'));
+
+    TRegistry<TMessageBus<10>> registry;
+    registry.getPropsLoader().addReader("mqtt", defaultPropertiesReader<MqttProperties>);
+    auto &mqtt = registry.create<MqttService>((size_t) 4096, (size_t) 4);
+    mqtt.setup();
+    registry.getPropsLoader().load("/bench-mqtt.json");
+    registry.getMessageBus().sendMessage(WifiConnected{});
+
+    std::atomic<size_t> received{0};
+    size_t bytes = 0;
+    mqtt.subscribe("/data", 0, [&](std::string_view, std::string_view data) {
+        bytes += data.size();
+        received.fetch_add(1, std::memory_order_release);
+    });
+    mqtt.subscribe("/slow", 0, [&](std::string_view, std::string_view data) {
+        bytes += data.size();
+        // a handler that parses and validates, 20 us
+        auto until = Benchmark::now() + 20000;
+        while (Benchmark::now() < until) {
+        }
+        received.fetch_add(1, std::memory_order_release);
+    });
+
+    auto client = esp_mqtt_fake_last_client();
+    esp_mqtt_event_t connected{};
+    connected.event_id = MQTT_EVENT_CONNECTED;
+    esp_mqtt_fake_dispatch(client, &connected);
+
+    std::atomic<bool> running{true};
+    std::thread busTask([&]() {
+        while (running.load()) {
+            registry.getMessageBus().loop();
+        }
+    });
+    auto drain = [&](size_t expected) {
+        while (received.load(std::memory_order_acquire) + mqtt.getDroppedCount() < expected) {
+            std::this_thread::yield();
+        }
+        received = 0;
+    };
+    auto reset = [&]() {
+        drain(0);
+        received = 0;
+    };
+
+    std::string topic = "/bench-product/bench-device/data";
+    std::string slowTopic = "/bench-product/bench-device/slow";
+    std::string small(64, 's');
+    std::string large(4096, 'l');
+
+    // callbacks on the esp-mqtt task
+    mqtt.setHandoff(false);
+    Benchmark::run("mqtt.data_single", 200000, [&]() {
+        injectData(client, topic, small, small.size());
+    });
+    Benchmark::run("mqtt.data_4k_in_8_fragments", 50000, [&]() {
+        injectData(client, topic, large, 512);
+    });
+    Benchmark::run("mqtt.slow_handler_direct", 2000, [&]() {
+        injectData(client, slowTopic, small, small.size());
+    });
+    reset();
+
+    // callbacks on the bus task, the numbers are what the esp-mqtt task spends per message
+    mqtt.setHandoff(true);
+    Benchmark::run("mqtt.handoff_single", 200000, [&]() {
+        injectData(client, topic, small, small.size());
+    });
+    if (Benchmark::enabled("mqtt.handoff_single")) {
+        drain(220000);
+    }
+    Benchmark::run("mqtt.handoff_4k_in_8_fragments", 50000, [&]() {
+        injectData(client, topic, large, 512);
+    });
+    if (Benchmark::enabled("mqtt.handoff_4k_in_8_fragments")) {
+        drain(55000);
+    }
+    // same 20 us handler, messages 200 us apart so the bus task keeps up; sleeping leaves the
+    // core to the bus task like the higher priority esp-mqtt task does on the device
+    const char *name = "mqtt.slow_handler_handoff";
+    if (Benchmark::enabled(name)) {
+        constexpr size_t iterations = 2000;
+        auto dropped = mqtt.getDroppedCount();
+        Benchmark bench(name, iterations);
+        bench.begin();
+        for (size_t idx = 0; idx < iterations; idx++) {
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            auto start = Benchmark::now();
+            injectData(client, slowTopic, small, small.size());
+            bench.sample(Benchmark::now() - start);
+        }
+        drain(iterations);
+        bench.end(iterations);
+        bench.report();
+        printf("  dropped: %u, pool high water %zu/%zu\n",
+               mqtt.getDroppedCount() - dropped, mqtt.getInboundPool().getHighWater(), mqtt.getInboundPool().getBlockCount());
+    }
+
+    running = false;
+    busTask.join();
+
+    benchPublishFanout();
+    benchPublishTopic();
+    benchResubscribe();
+    benchHandoffStalled();
+
+    if (Benchmark::enabled("mqtt.data_single")) {
+        Benchmark::check(bytes, "mqtt: no data delivered");
+    }
+}
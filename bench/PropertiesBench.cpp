@@ -0,0 +1,152 @@
+#include "Benchmark.h"
+#include "core/Heap.h"
+#include "core/Properties.h"
+#include "core/service/MqttService.h"
+
+namespace {
+    const char *config = R"({
+    "wifi": {
+        "ssid": "bench-network",
+        "password": "bench-password"
+    },
+    "mqtt": {
+        "uri": "mqtts://broker.local:8883",
+        "username": "device",
+        "password": "secret",
+        "ca-cert-file": "/certs/ca.pem",
+        "client-cert-file": "/certs/client.pem",
+        "client-key-file": "/certs/client.key",
+        "device-name": "bench-device",
+        "product-name": "bench-product"
+    }
+})";
+
+    // sizes of a production device: broker host, access keys and long device names
+    const char *deviceConfig = R"({
+    "wifi": {
+        "ssid": "warehouse-floor-2-iot",
+        "password": "correct-horse-battery-staple",
+        "fast-connect": true
+    },
+    "mqtt": {
+        "uri": "mqtts://a1b2c3d4e5f6g7-ats.iot.eu-central-1.amazonaws.com:8883",
+        "username": "sensor-gateway-000123?SDK=esp32&Version=1.0",
+        "password": "d41d8cd98f00b204e9800998ecf8427e",
+        "ca-cert-file": "/certs/ca.pem",
+        "client-cert-file": "/certs/client.pem",
+        "client-key-file": "/certs/client.key",
+        "device-name": "sensor-gateway-000123",
+        "product-name": "environment-monitor"
+    }
+})";
+
+    // a reload that leaves the wifi section out
+    const char *mqttOnlyConfig = R"({
+    "mqtt": {
+        "uri": "mqtts://broker.local:8883",
+        "device-name": "bench-device-2",
+        "product-name": "bench-product"
+    }
+})";
+
+    class CountingConsumer : public PropertiesConsumer {
+    public:
+        size_t applied{0};
+
+        void applyProperties(const Properties &) override {
+            applied++;
+        }
+    };
+
+    /**
+     * Keeps the wifi section the way WifiService does.
+     */
+    class WifiConsumer : public TPropertiesConsumer<WifiConsumer, WifiProperties> {
+    public:
+        const WifiProperties *props{nullptr};
+
+        void applyProperties(const WifiProperties &wifi) {
+            props = &wifi;
+        }
+    };
+
+    /**
+     * What the config keeps on the heap once it is applied: the consumers, the loaded sections
+     * and what MqttService derives from them. Live bytes are only tracked in the native-heap env.
+     */
+    void benchFootprint() {
+        if (!Benchmark::enabled("properties.footprint")) {
+            return;
+        }
+        // one byte certificates keep the files out of the numbers
+        writeFile("/certs/ca.pem", "c");
+        writeFile("/certs/client.pem", "p");
+        writeFile("/certs/client.key", "k");
+        writeFile("/bench-device.json", deviceConfig);
+
+        TRegistry<NullMessageBus> registry;
+        registry.getPropsLoader().addReader("wifi", defaultPropertiesReader<WifiProperties>);
+        registry.getPropsLoader().addReader("mqtt", defaultPropertiesReader<MqttProperties>);
+
+        auto before = heap::total();
+        auto wifi = std::make_unique<WifiConsumer>();
+        registry.getPropsLoader().addConsumer(wifi.get());
+        // smallest inbound pool, it is not configuration
+        registry.create<MqttService>((size_t) 16, (size_t) 1);
+        registry.getPropsLoader().load("/bench-device.json");
+        auto after = heap::total();
+
+        printf(
+                "%-32s %8u live bytes  %6u live blocks  %6zu arena bytes\n", "properties.footprint",
+                after.liveBytes - before.liveBytes, (after.allocs - after.frees) - (before.allocs - before.frees),
+                registry.getPropsLoader().getArena().size()
+        );
+        Benchmark::check(wifi->props && wifi->props->ssid == "warehouse-floor-2-iot", "properties: wifi section not applied");
+    }
+
+    /**
+     * Reloads that leave a section out: its consumer keeps the previous version, which has to
+     * stay alive, and a full config afterwards lets the old arenas go.
+     */
+    void benchReloadPartial() {
+        const char *name = "properties.reload_partial";
+        if (!Benchmark::enabled(name)) {
+            return;
+        }
+        writeFile("/bench-mqtt-only.json", mqttOnlyConfig);
+
+        PropertiesLoader loader;
+        WifiConsumer wifi;
+        loader.addReader("wifi", defaultPropertiesReader<WifiProperties>);
+        loader.addReader("mqtt", defaultPropertiesReader<MqttProperties>);
+        loader.addConsumer(&wifi);
+        loader.load("/bench-config.json");
+
+        Benchmark::run(name, 5000, [&]() {
+            loader.load("/bench-mqtt-only.json");
+        });
+        auto retained = loader.getRetainedCount();
+        bool kept = wifi.props == loader.get<WifiProperties>() && wifi.props->ssid == "bench-network";
+        loader.load("/bench-config.json");
+        printf("  retained configs: %zu while wifi is left out, %zu after a full reload\n", retained, loader.getRetainedCount());
+        Benchmark::check(kept && retained == 1 && !loader.getRetainedCount() && wifi.props == loader.get<WifiProperties>(),
+                         "%s: a left out section was not kept, or old configs were not freed", name);
+    }
+}
+
+void runPropertiesBenchmarks() {
+    writeFile("/bench-config.json", config);
+
+    PropertiesLoader loader;
+    CountingConsumer consumer;
+    loader.addReader("wifi", defaultPropertiesReader<WifiProperties>);
+    loader.addReader("mqtt", defaultPropertiesReader<MqttProperties>);
+    loader.addConsumer(&consumer);
+
+    Benchmark::run("properties.load", 5000, [&]() {
+        loader.load("/bench-config.json");
+    });
+
+    benchFootprint();
+    benchReloadPartial();
+}
@@ -0,0 +1,150 @@
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+#include "Benchmark.h"
+#include "core/service/RateService.h"
+#include "core/sim/SimBus.h"
+
+namespace {
+    const char *config = R"({
+    "mqtt": {
+        "uri": "mqtts://broker.local:8883",
+        "username": "device",
+        "password": "secret",
+        "ca-cert-file": "/certs/ca.pem",
+        "client-cert-file": "/certs/client.pem",
+        "client-key-file": "/certs/client.key",
+        "device-name": "bench-device",
+        "product-name": "bench-product"
+    },
+    "rate": {
+        "tick-ms": 250,
+        "outbox-target": 4096,
+        "ack-target-ms": 200,
+        "recover-step": 0.05,
+        "classes": {
+            "control": {"rate": 10, "burst": 10, "min-scale": 1},
+            "state": {"rate": 2, "burst": 2, "min-scale": 0.5},
+            "telemetry": {"rate": 5, "burst": 5, "min-scale": 0.1}
+        }
+    }
+})";
+
+    constexpr uint32_t TickMs = 250;
+    constexpr uint32_t PhaseMs = 20000;
+
+    struct Phase {
+        const char *name;
+        uint32_t granted[Rate_Class_Max]{};
+    };
+
+    /**
+     * A device whose producers want 10 telemetry and 10 state publishes a second and two
+     * control ones, through phases of link trouble: what each class got per second and where
+     * the scale ended. Link state comes from the fake client (outbox size, connection events,
+     * a publish left unacked), time from ticks; only the unacked publish ages in real time.
+     */
+    void benchRateControl() {
+        if (!Benchmark::enabled("rate.")) {
+            return;
+        }
+        writeFile("/certs/ca.pem", std::string(1200, 'c'));
+        writeFile("/certs/client.pem", std::string(1100, 'p'));
+        writeFile("/certs/client.key", std::string(1700, 'k'));
+        writeFile("/bench-rate.json", config);
+
+        TRegistry<TSimMessageBus<10>> registry;
+        registry.getPropsLoader().addReader("mqtt", defaultPropertiesReader<MqttProperties>);
+        registry.getPropsLoader().addReader("rate", defaultPropertiesReader<RateProperties>);
+        auto &mqtt = registry.create<MqttService>();
+        auto &rate = registry.create<RateService>(mqtt);
+        for (auto *service: registry.getServices()) {
+            service->setup();
+        }
+        registry.getPropsLoader().load("/bench-rate.json");
+        auto &bus = registry.getMessageBus();
+        bus.sendMessage(WifiConnected{});
+        auto client = esp_mqtt_fake_last_client();
+        auto acked = mqtt.addTopic("/acked", 1);
+
+        auto dispatch = [&](esp_mqtt_event_id_t id, int msgId = 0) {
+            esp_mqtt_event_t event{};
+            event.event_id = id;
+            event.msg_id = msgId;
+            esp_mqtt_fake_dispatch(client, &event);
+            bus.loop();
+        };
+        dispatch(MQTT_EVENT_CONNECTED);
+
+        Benchmark::run("rate.acquire", 1000000, [&]() {
+            rate.tryAcquire(Rate_Telemetry);
+        });
+
+        auto runPhase = [&](Phase &phase) {
+            for (uint32_t ms = 0; ms < PhaseMs; ms += 50) {
+                if (ms % TickMs == 0) {
+                    rate.tick();
+                }
+                if (ms % 100) {
+                    continue;
+                }
+                phase.granted[Rate_Telemetry] += rate.tryAcquire(Rate_Telemetry);
+                phase.granted[Rate_State] += rate.tryAcquire(Rate_State);
+                if (ms % 500 == 0) {
+                    phase.granted[Rate_Control] += rate.tryAcquire(Rate_Control);
+                }
+            }
+            printf("  %-12s per second: telemetry %4.2f  state %4.2f  control %4.2f  scale %4.2f%s\n", phase.name,
+                   phase.granted[Rate_Telemetry] * 1000.0 / PhaseMs, phase.granted[Rate_State] * 1000.0 / PhaseMs,
+                   phase.granted[Rate_Control] * 1000.0 / PhaseMs, rate.getScale(), rate.isCongested() ? ", congested" : "");
+        };
+
+        Phase healthy{"healthy"};
+        runPhase(healthy);
+
+        esp_mqtt_fake_set_outbox_size(client, 16384);
+        Phase congested{"outbox full"};
+        runPhase(congested);
+
+        esp_mqtt_fake_set_outbox_size(client, 0);
+        Phase drained{"drained"};
+        runPhase(drained);
+
+        dispatch(MQTT_EVENT_DISCONNECTED);
+        Phase down{"disconnected"};
+        runPhase(down);
+
+        dispatch(MQTT_EVENT_CONNECTED);
+        Phase reconnected{"reconnected"};
+        runPhase(reconnected);
+
+        // one publish left unacked past the ack target
+        mqtt.publish(acked, "{}");
+        int stalled = esp_mqtt_fake_last_msg_id(client);
+        std::this_thread::sleep_for(std::chrono::milliseconds(250));
+        Phase slowAcks{"ack stalled"};
+        runPhase(slowAcks);
+
+        // acked late, then quick acks pull the average back under the target
+        dispatch(MQTT_EVENT_PUBLISHED, stalled);
+        for (int idx = 0; idx < 8; idx++) {
+            mqtt.publish(acked, "{}");
+            dispatch(MQTT_EVENT_PUBLISHED, esp_mqtt_fake_last_msg_id(client));
+        }
+        Phase fastAcks{"acks back"};
+        runPhase(fastAcks);
+
+        printf("  ack latency %u ms, congested ticks %u, telemetry granted %u denied %u\n", mqtt.getAckLatencyMs(),
+               rate.getCongestedTicks(), rate.getStats(Rate_Telemetry).granted, rate.getStats(Rate_Telemetry).denied);
+        Benchmark::check(!down.granted[Rate_Control] && congested.granted[Rate_Control] == healthy.granted[Rate_Control] &&
+                         congested.granted[Rate_Telemetry] * 4 <= healthy.granted[Rate_Telemetry] && slowAcks.granted[Rate_Control] &&
+                         slowAcks.granted[Rate_Telemetry] * 4 <= healthy.granted[Rate_Telemetry] &&
+                         fastAcks.granted[Rate_Telemetry] * 2 >= healthy.granted[Rate_Telemetry],
+                         "rate: budgets did not follow the link");
+    }
+}
+
+void runRateBenchmarks() {
+    benchRateControl();
+}
@@ -0,0 +1,94 @@
+#include <cstdio>
+
+#include "Benchmark.h"
+#include "core/sim/SimBus.h"
+
+namespace {
+    enum SimMessageId {
+        Sim_Status,
+        Sim_Reconnect,
+        Sim_Request,
+        Sim_Reply,
+    };
+
+    struct StatusTick : TMessage<Sim_Status> {
+        uint64_t atMs{0};
+    };
+
+    struct ReconnectAttempt : TMessage<Sim_Reconnect> {
+        uint32_t backoffMs{0};
+    };
+
+    struct PingRequest : TRequest<Sim_Request> {
+    };
+
+    struct PingReply : TReply<Sim_Reply> {
+    };
+
+    /**
+     * A day of device scheduling: 1 s status ticks, a reconnect loop with exponential backoff
+     * that gives up every 10 minutes and starts over, and a request every 30 s that always times out.
+     */
+    void benchDayOfScheduling() {
+        const char *name = "sim.day_of_scheduling";
+        if (!Benchmark::enabled(name)) {
+            return;
+        }
+
+        VirtualClock clock;
+        TSimMessageBus<10> queue(clock);
+        MessageBus &bus = queue;
+        sim::attach(clock, bus);
+
+        uint32_t ticks = 0, late = 0, attempts = 0, timeouts = 0;
+        bus.subscribe<StatusTick>([&](const StatusTick &msg) {
+            ticks++;
+            if (clock.nowMs() != msg.atMs) {
+                late++;
+            }
+        });
+        bus.schedule(1000, true, [&]() {
+            StatusTick msg;
+            msg.atMs = clock.nowMs() + 1000;
+            bus.scheduleMessage(1000, msg);
+        });
+
+        bus.subscribe<ReconnectAttempt>([&](const ReconnectAttempt &msg) {
+            attempts++;
+            ReconnectAttempt next;
+            next.backoffMs = msg.backoffMs >= 512000 ? 1000 : msg.backoffMs * 2;
+            bus.scheduleMessage(next.backoffMs, next);
+        });
+        ReconnectAttempt first;
+        first.backoffMs = 1000;
+        bus.scheduleMessage(first.backoffMs, first);
+
+        bus.schedule(30000, true, [&]() {
+            bus.request<PingReply>(PingRequest{}, 5000, [&](const PingReply *reply) {
+                if (!reply) {
+                    timeouts++;
+                }
+            });
+        });
+
+        constexpr size_t minutes = 24 * 60;
+        Benchmark bench(name, minutes);
+        bench.begin();
+        for (size_t idx = 0; idx < minutes; idx++) {
+            auto start = Benchmark::now();
+            clock.advance(60000);
+            bench.sample(Benchmark::now() - start);
+        }
+        bench.end(minutes);
+        bench.report();
+
+        printf(
+                "  24 h simulated: %u status ticks (%u late), %u reconnect attempts, %u timeouts, %llu timers fired, queue high water %zu\n",
+                ticks, late, attempts, timeouts, (unsigned long long) clock.getFiredCount(), queue.getBackend().getHighWater()
+        );
+    }
+}
+
+void runSimBenchmarks() {
+    benchDayOfScheduling();
+}
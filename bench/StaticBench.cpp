@@ -0,0 +1,95 @@
+#include <cstdio>
+
+#include "Benchmark.h"
+#include "core/StaticRegistry.h"
+
+namespace {
+    struct CounterTick : TMessage<0> {
+        uint32_t seq{0};
+    };
+
+    uint32_t ticked = 0;
+
+    void onTick(const CounterTick &msg) {
+        ticked += msg.seq;
+    }
+
+    template<ServiceSubId id>
+    class CounterService : public TService<id>, public TMessageSubscriber<CounterService<id>, CounterTick> {
+    public:
+        uint32_t count{0};
+
+        explicit CounterService(Registry &registry) : TService<id>(registry) {}
+
+        void setup() override {
+            this->getRegistry().getMessageBus().subscribe(this);
+        }
+
+        void onMessage(const CounterTick &msg) {
+            count += msg.seq;
+        }
+    };
+
+    typedef TMessageBus<10, 8, 8, 4, 64, StaticRtosBusBackend<10>> StaticBus;
+    typedef TStaticRegistry<StaticBus, CounterService<1>, CounterService<2>, CounterService<3>, TStaticSubscription<CounterTick, onTick>> StaticRegistry;
+
+    void setupServices(Registry &registry) {
+        for (auto *service: registry.getServices()) {
+            service->setup();
+        }
+    }
+
+    void composeDynamic(TRegistry<TMessageBus<10>> &registry) {
+        registry.create<CounterService<1>>();
+        registry.create<CounterService<2>>();
+        registry.create<CounterService<3>>();
+        registry.getMessageBus().subscribe<CounterTick>(onTick);
+        setupServices(registry);
+    }
+
+    /**
+     * Three services and a function subscription, built and torn down: TRegistry pays for
+     * each service, the queue and the subscriber tables, TStaticRegistry for nothing.
+     */
+    void benchCompose() {
+        Benchmark::run("static.compose_dynamic", 20000, []() {
+            TRegistry<TMessageBus<10>> registry;
+            composeDynamic(registry);
+        });
+        Benchmark::run("static.compose_static", 20000, []() {
+            StaticRegistry registry;
+            setupServices(registry);
+        });
+    }
+
+    void benchDispatch() {
+        CounterTick tick;
+        tick.seq = 1;
+
+        if (Benchmark::enabled("static.dispatch_dynamic")) {
+            TRegistry<TMessageBus<10>> registry;
+            composeDynamic(registry);
+            auto &bus = registry.getMessageBus();
+            Benchmark::run("static.dispatch_dynamic", 2000000, [&]() {
+                bus.onMessage(tick);
+            });
+        }
+
+        if (Benchmark::enabled("static.dispatch_static")) {
+            ticked = 0;
+            StaticRegistry registry;
+            setupServices(registry);
+            auto &bus = registry.getMessageBus();
+            Benchmark::run("static.dispatch_static", 2000000, [&]() {
+                bus.onMessage(tick);
+            });
+            Benchmark::check(registry.get<CounterService<2>>().count == ticked, "static: service saw %u ticks, subscription %u",
+                             registry.get<CounterService<2>>().count, ticked);
+        }
+    }
+}
+
+void runStaticBenchmarks() {
+    benchCompose();
+    benchDispatch();
+}
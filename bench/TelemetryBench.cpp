@@ -0,0 +1,175 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <thread>
+
+#include "Benchmark.h"
+#include "core/service/MqttService.h"
+#include "core/service/TelemetryService.h"
+#include "core/sim/SimBus.h"
+
+namespace {
+    typedef TSimMessageBus<16> Bus;
+
+    const char *metricNames[] = {"free-heap", "rssi", "temperature", "loop-us"};
+
+    void configure(TelemetryService &service) {
+        TelemetryProperties props;
+        for (auto *metric: metricNames) {
+            props.metrics[props.metricCount++] = metric;
+        }
+        service.applyProperties(props);
+    }
+
+    void benchSample() {
+        TRegistry<Bus> registry;
+        auto &service = registry.create<TelemetryService>();
+        configure(service);
+        registry.getMessageBus().subscribe(&service);
+
+        std::mt19937 random(7);
+        std::normal_distribution<float> rssi(-62, 4);
+        TelemetrySample sample;
+        sample.metric = "rssi";
+        Benchmark::run("telemetry.sample", 1000000, [&]() {
+            sample.value = rssi(random);
+            registry.getMessageBus().sendMessage(sample);
+        });
+    }
+
+    /**
+     * p50/p90/p99 estimates against the exact quantiles of the same samples, an hour of 1 Hz
+     * readings and a long window.
+     */
+    template<typename Dist>
+    void checkAccuracy(const char *name, Dist dist, size_t samples) {
+        std::mt19937 random(11);
+        std::vector<float> values;
+        MetricWindow window;
+        for (size_t idx = 0; idx < samples; idx++) {
+            float value = dist(random);
+            values.push_back(value);
+            window.add(value);
+        }
+        std::sort(values.begin(), values.end());
+        auto exact = [&values](float p) {
+            return values[(size_t) std::lround(p * (float) (values.size() - 1))];
+        };
+        auto error = [&values](float estimate, float truth) {
+            // in units of the value range, a relative error is meaningless around zero
+            return 100.0f * std::fabs(estimate - truth) / (values.back() - values.front());
+        };
+        printf("  %-12s %7zu samples: p50 %8.2f/%8.2f (%.2f%%), p90 %8.2f/%8.2f (%.2f%%), p99 %8.2f/%8.2f (%.2f%%) of range\n",
+               name, samples,
+               window.p50.value(), exact(0.5f), error(window.p50.value(), exact(0.5f)),
+               window.p90.value(), exact(0.9f), error(window.p90.value(), exact(0.9f)),
+               window.p99.value(), exact(0.99f), error(window.p99.value(), exact(0.99f)));
+    }
+
+    void benchAccuracy() {
+        if (!Benchmark::enabled("telemetry.accuracy")) {
+            return;
+        }
+        printf("telemetry.accuracy               estimate/exact, %zu bytes per metric window\n", sizeof(MetricWindow));
+        for (size_t samples: {60, 3600, 100000}) {
+            checkAccuracy("normal", std::normal_distribution<float>(-62, 4), samples);
+            checkAccuracy("exponential", std::exponential_distribution<float>(0.01f), samples);
+            checkAccuracy("uniform", std::uniform_real_distribution<float>(150000, 180000), samples);
+        }
+    }
+
+    /**
+     * Four metrics at 1 Hz for ten one minute windows: JSON bytes handed to MQTT when every
+     * sample is published against one summary per metric and window.
+     */
+    void benchUplink() {
+        const char *name = "telemetry.uplink_1hz_60s";
+        if (!Benchmark::enabled(name)) {
+            return;
+        }
+        TRegistry<Bus> registry;
+        auto &bus = registry.getMessageBus();
+        auto &service = registry.create<TelemetryService>();
+        configure(service);
+        bus.subscribe(&service);
+
+        size_t rawMessages = 0, rawBytes = 0, summaryMessages = 0, summaryBytes = 0;
+        bus.subscribe<TelemetrySummary>([&](const TelemetrySummary &msg) {
+            auto mqtt = makeJsonMqttMsg("/telemetry", msg);
+            summaryMessages++;
+            summaryBytes += static_cast<MqttMessage &>(*mqtt).payload.size();
+        });
+
+        std::mt19937 random(3);
+        std::normal_distribution<float> noise(0, 1);
+        TelemetrySample sample;
+        for (int window = 0; window < 10; window++) {
+            for (int second = 0; second < 60; second++) {
+                for (auto *metric: metricNames) {
+                    sample.metric = metric;
+                    sample.value = 100 + 10 * noise(random);
+                    auto mqtt = makeJsonMqttMsg("/telemetry", sample);
+                    rawMessages++;
+                    rawBytes += static_cast<MqttMessage &>(*mqtt).payload.size();
+                    bus.sendMessage(sample);
+                }
+            }
+            // what the window timer posts, the windows close on the bus task
+            bus.tryPostMessage(TelemetryFlush{});
+            bus.loop();
+        }
+        printf("%-32s per sample: %zu publishes, %zu B; summarised: %zu publishes, %zu B (%.1fx fewer bytes)\n", name,
+               rawMessages, rawBytes, summaryMessages, summaryBytes, summaryBytes ? (double) rawBytes / summaryBytes : 0.0);
+        Benchmark::check(summaryMessages == 10 * 4, "%s: %zu summaries for 10 windows of 4 metrics", name, summaryMessages);
+    }
+
+    /**
+     * Counts the flushes the window timer posts, from the timer daemon.
+     */
+    class FlushCountingBus : public NullMessageBus {
+    public:
+        std::atomic<size_t> flushes{0};
+
+        PostStatus tryPostMessage(Message::Ptr &msg) override {
+            if (msg->getMsgId() == TelemetryFlush::ID) {
+                flushes++;
+            }
+            return NullMessageBus::tryPostMessage(msg);
+        }
+    };
+
+    /**
+     * A reload that changes window-ms once the timer runs: the windows follow the new period
+     * alone, the old timer must not keep cutting them short.
+     */
+    void benchWindowReload() {
+        const char *name = "telemetry.window_reload";
+        if (!Benchmark::enabled(name)) {
+            return;
+        }
+        TRegistry<FlushCountingBus> registry;
+        auto &service = registry.create<TelemetryService>();
+        TelemetryProperties props;
+        props.windowMs = 20;
+        service.applyProperties(props);
+        service.setup();
+        props.windowMs = 25;
+        service.applyProperties(props);
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        size_t flushes = static_cast<FlushCountingBus &>(registry.getMessageBus()).flushes;
+        printf("%-32s %zu flushes in 500 ms at a 25 ms window\n", name, flushes);
+        // 20 expected, both timers together would post 45
+        Benchmark::check(flushes >= 10 && flushes <= 30, "%s: %zu flushes in 500 ms", name, flushes);
+    }
+}
+
+void runTelemetryBenchmarks() {
+    benchSample();
+    benchAccuracy();
+    benchUplink();
+    benchWindowReload();
+}
@@ -0,0 +1,106 @@
+#include <cstdio>
+
+#include "Benchmark.h"
+#include "core/Trace.h"
+#include "core/service/SysService.h"
+
+namespace {
+    constexpr size_t Messages = 50000;
+
+    /**
+     * Replay target that keeps the topics it was given, to check the round trip.
+     */
+    class CollectingBus : public NullMessageBus {
+    public:
+        std::vector<uint32_t> keys;
+
+        PostStatus postMessage(Message::Ptr &msg) override {
+            keys.push_back(msg->getKey());
+            return NullMessageBus::postMessage(msg);
+        }
+    };
+
+    MqttMessage makeMessage(size_t idx) {
+        MqttMessage msg;
+        msg.topic = "/device/bench/sensor-" + std::to_string(idx % 8);
+        msg.payload = R"({"value":)" + std::to_string(idx) + R"(,"unit":"C"})";
+        msg.qos = 1;
+        return msg;
+    }
+
+    void benchCapture(const char *name, TraceSink &sink, const CodecRegistry &codecs) {
+        if (!Benchmark::enabled(name)) {
+            return;
+        }
+        TMessageBus<10> queue;
+        MessageBus &bus = queue;
+        BusRecorder recorder(codecs, sink);
+        bus.subscribe(&recorder);
+
+        std::vector<MqttMessage> traffic;
+        for (size_t idx = 0; idx < 1024; idx++) {
+            traffic.push_back(makeMessage(idx));
+        }
+
+        size_t idx = 0;
+        Benchmark::run(name, Messages, [&]() {
+            bus.sendMessage(traffic[idx++ % traffic.size()]);
+        });
+    }
+}
+
+void runTraceBenchmarks() {
+    CodecRegistry codecs;
+    addSystemCodecs(codecs);
+
+    TraceRing ring(64 * 1024);
+    benchCapture("trace.capture_ring", ring, codecs);
+    if (Benchmark::enabled("trace.capture_ring")) {
+        printf("  ring: %zu records in %zu bytes, %u evicted\n", ring.size(), ring.bytes(), ring.getEvictedCount());
+    }
+
+    TraceFile file("/bench-trace.bin");
+    file.create();
+    benchCapture("trace.capture_file", file, codecs);
+    file.close();
+
+    const char *name = "trace.replay_max_speed";
+    if (Benchmark::enabled(name)) {
+        TraceFile source("/bench-trace.bin");
+        source.create();
+        std::vector<uint32_t> expected;
+        for (size_t idx = 0; idx < Messages; idx++) {
+            auto msg = makeMessage(idx);
+            uint8_t payload[256];
+            ByteWriter out(payload, sizeof(payload));
+            codecs.encode(msg, out);
+            source.write(idx * 100, msg.getMsgId(), out.data(), out.size());
+            expected.push_back(msg.getKey());
+        }
+        source.close();
+        source.open();
+
+        CollectingBus bus;
+        BusReplay replay(codecs, bus);
+        Benchmark bench(name, Messages);
+        bench.begin();
+        size_t count = replay.run(source, 0);
+        bench.end(count);
+        bench.report();
+        printf("  round trip: %s, %u posted, %u skipped\n", bus.keys == expected ? "ok" : "MISMATCH", replay.getPostedCount(), replay.getSkippedCount());
+        Benchmark::check(bus.keys == expected, "%s: replay does not match the recording", name);
+
+        // 200 records 500 us apart: 100 ms of traffic, expect ~10 ms at 10x
+        source.rewind();
+        CollectingBus paced;
+        BusReplay accelerated(codecs, paced);
+        TraceRing window(16 * 1024);
+        TraceRecord record;
+        for (size_t idx = 0; idx < 200 && source.next(record); idx++) {
+            window.write(idx * 500, record.id, record.payload, record.size);
+        }
+        auto start = Benchmark::now();
+        accelerated.run(window, 10.0f);
+        printf("  100 ms of traffic replayed at 10x in %.1f ms\n", (Benchmark::now() - start) / 1e6);
+    }
+}
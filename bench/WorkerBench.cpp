@@ -0,0 +1,122 @@
+#include <cstdio>
+#include <thread>
+
+#include "Benchmark.h"
+#include "core/service/MqttService.h"
+#include "core/service/WorkerService.h"
+
+namespace {
+    enum BenchWorkerId {
+        Bench_Worker_Report = 0x30,
+    };
+
+    struct SensorReport : TMessage<Bench_Worker_Report> {
+        uint32_t seq{0};
+        std::vector<float> readings;
+    };
+
+    typedef TMessageBus<10> Bus;
+
+    SensorReport makeReport() {
+        SensorReport report;
+        for (int idx = 0; idx < 64; idx++) {
+            report.readings.push_back((float) idx * 1.5f);
+        }
+        return report;
+    }
+
+    void waitIdle(WorkerService &workers) {
+        while (workers.getInFlight()) {
+            std::this_thread::yield();
+        }
+    }
+
+    /**
+     * Time the bus task spends in a SensorReport handler that prints a 64 reading JSON payload,
+     * inline and handed to a WorkerService. Each message is sent once the previous job is done,
+     * the bus results queue drops its oldest entry when nobody drains it.
+     */
+    void benchOffload(const char *name, bool offload) {
+        constexpr size_t messages = 20000;
+        if (!Benchmark::enabled(name)) {
+            return;
+        }
+        TRegistry<Bus> registry;
+        auto &bus = static_cast<Bus &>(registry.getMessageBus());
+        bus.setOverflowPolicy(Overflow_DropOldest);
+        auto &workers = registry.create<WorkerService>(1, 4);
+        workers.setup();
+
+        if (offload) {
+            workers.offload<SensorReport>([](const SensorReport &msg) {
+                return makeJsonMqttMsg("/report", msg);
+            });
+        } else {
+            registry.getMessageBus().subscribe<SensorReport>([&registry](const SensorReport &msg) {
+                sendJsonMqttMsg(registry.getMessageBus(), "/report", msg);
+            });
+        }
+
+        auto report = makeReport();
+        Benchmark bench(name);
+        bench.begin();
+        for (size_t idx = 0; idx < messages; idx++) {
+            report.seq = idx;
+            auto start = Benchmark::now();
+            bus.sendMessage(report);
+            bench.sample(Benchmark::now() - start);
+            waitIdle(workers);
+        }
+        bench.end(messages);
+        bench.report();
+
+        if (offload) {
+            auto stats = workers.getStats(0);
+            printf("  worker0: %u jobs, busy %llu us, longest %u us, utilisation %u%%\n", stats.jobs,
+                   (unsigned long long) stats.busyUs, stats.maxJobUs, stats.utilisation);
+        }
+    }
+
+    /**
+     * 1000 reports back to back into 4 slots: the surplus is refused, in flight work stays at 4.
+     */
+    void benchFlood() {
+        const char *name = "worker.flood_4_slots";
+        if (!Benchmark::enabled(name)) {
+            return;
+        }
+        TRegistry<Bus> registry;
+        auto &bus = static_cast<Bus &>(registry.getMessageBus());
+        bus.setOverflowPolicy(Overflow_DropOldest);
+        auto &workers = registry.create<WorkerService>(2, 4);
+        workers.setup();
+        workers.offload<SensorReport>([](const SensorReport &msg) {
+            return makeJsonMqttMsg("/report", msg);
+        });
+
+        auto report = makeReport();
+        size_t highWater = 0;
+        for (size_t idx = 0; idx < 1000; idx++) {
+            bus.sendMessage(report);
+            highWater = std::max(highWater, workers.getInFlight());
+        }
+        waitIdle(workers);
+        auto first = workers.getStats(0), second = workers.getStats(1);
+        printf("%-32s submitted %u, rejected %u, in flight high water %zu, jobs per worker %u/%u\n", name,
+               workers.getSubmittedCount(), workers.getRejectedCount(), highWater, first.jobs, second.jobs);
+    }
+}
+
+void toJson(const SensorReport &msg, cJSON *json) {
+    cJSON_AddNumberToObject(json, "seq", msg.seq);
+    cJSON *readings = cJSON_AddArrayToObject(json, "readings");
+    for (auto value: msg.readings) {
+        cJSON_AddItemToArray(readings, cJSON_CreateNumber(value));
+    }
+}
+
+void runWorkerBenchmarks() {
+    benchOffload("worker.handler_inline", false);
+    benchOffload("worker.handler_offloaded", true);
+    benchFlood();
+}
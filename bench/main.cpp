@@ -0,0 +1,34 @@
+#include <cstdio>
+#include <LittleFS.h>
+
+#include "Benchmark.h"
+
+int main(int argc, char **argv) {
+    if (argc > 1) {
+        Benchmark::setFilter(argv[1]);
+    }
+    alloc::hookJson();
+    LittleFS.begin(false);
+    printf("littlefs root: %s\n", LittleFS.root().c_str());
+
+    runBusBenchmarks();
+    runPropertiesBenchmarks();
+    runJsonBenchmarks();
+    runMqttBenchmarks();
+    runSimBenchmarks();
+    runTraceBenchmarks();
+    runStaticBenchmarks();
+    runWorkerBenchmarks();
+    runTelemetryBenchmarks();
+    runBridgeBenchmarks();
+    runRateBenchmarks();
+    runFileBenchmarks();
+
+    alloc::report();
+
+    if (auto failed = Benchmark::getFailedCount()) {
+        fprintf(stderr, "%zu checks failed\n", failed);
+        return 1;
+    }
+    return 0;
+}
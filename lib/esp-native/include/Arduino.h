@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include <freertos/FreeRTOS.h>
+#include <esp_log.h>
+#include <esp_err.h>
+
+unsigned long millis();
+
+unsigned long micros();
+
+void delay(uint32_t ms);
+
+class String {
+    std::string _str;
+public:
+    String() = default;
+
+    String(const char *str) : _str(str ? str : "") {}
+
+    String(const std::string &str) : _str(str) {}
+
+    String &operator+=(const String &other) {
+        _str += other._str;
+        return *this;
+    }
+
+    String &operator+=(const char *other) {
+        _str += other;
+        return *this;
+    }
+
+    [[nodiscard]] const char *c_str() const {
+        return _str.c_str();
+    }
+
+    [[nodiscard]] unsigned int length() const {
+        return _str.length();
+    }
+
+    [[nodiscard]] bool isEmpty() const {
+        return _str.empty();
+    }
+};
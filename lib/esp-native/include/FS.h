@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdio>
+#include <memory>
+#include <string>
+
+#include "Arduino.h"
+
+#define FILE_READ       "r"
+#define FILE_WRITE      "w"
+#define FILE_APPEND     "a"
+
+namespace fs {
+
+    enum SeekMode {
+        SeekSet = 0,
+        SeekCur = 1,
+        SeekEnd = 2
+    };
+
+    class File {
+        std::shared_ptr<FILE> _file;
+        std::string _path;
+    public:
+        File() = default;
+
+        File(FILE *file, std::string_view path);
+
+        size_t write(const uint8_t *buf, size_t size);
+
+        size_t write(uint8_t ch) {
+            return write(&ch, 1);
+        }
+
+        size_t print(const char *str) {
+            return write(reinterpret_cast<const uint8_t *>(str), strlen(str));
+        }
+
+        size_t read(uint8_t *buf, size_t size);
+
+        int read();
+
+        int available();
+
+        String readString();
+
+        bool seek(uint32_t pos, SeekMode mode = SeekSet);
+
+        [[nodiscard]] size_t position() const;
+
+        [[nodiscard]] size_t size() const;
+
+        void flush();
+
+        void close();
+
+        [[nodiscard]] const char *path() const {
+            return _path.c_str();
+        }
+
+        explicit operator bool() const {
+            return (bool) _file;
+        }
+    };
+
+    class FS {
+        std::string _root;
+    public:
+        [[nodiscard]] std::string realPath(const char *path) const;
+
+        void setRoot(std::string_view root) {
+            _root = root;
+        }
+
+        [[nodiscard]] const std::string &root() const {
+            return _root;
+        }
+
+        File open(const char *path, const char *mode = FILE_READ, bool create = false);
+
+        bool exists(const char *path);
+
+        bool remove(const char *path);
+
+        bool mkdir(const char *path);
+    };
+}
+
+#ifndef FS_NO_GLOBALS
+using fs::FS;
+using fs::File;
+using fs::SeekMode;
+using fs::SeekSet;
+using fs::SeekCur;
+using fs::SeekEnd;
+#endif
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "FS.h"
+
+namespace fs {
+
+    /**
+     * LittleFS stand-in backed by a host directory: $LITTLEFS_ROOT when set,
+     * otherwise a fresh temporary directory created by begin().
+     */
+    class LittleFSFS : public FS {
+    public:
+        bool begin(bool formatOnFail = false, const char *basePath = "/littlefs", uint8_t maxOpenFiles = 10, const char *partitionLabel = "spiffs");
+
+        void end();
+    };
+}
+
+extern fs::LittleFSFS LittleFS;
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct tskTaskControlBlock *TaskHandle_t;
+
+typedef void (*TaskFunction_t)(void *param);
+
+void vTaskDelay(TickType_t ticks);
+
+// a detached host thread, stack size and priority are ignored
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stackDepth, void *param, UBaseType_t priority, TaskHandle_t *handle);
+
+// only NULL (the calling task) is supported, the task function has to return right after
+void vTaskDelete(TaskHandle_t task);
+
+#ifdef __cplusplus
+}
+#endif
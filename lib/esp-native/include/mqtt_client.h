@@ -0,0 +1,197 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "esp_err.h"
+#include "esp_event.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct esp_mqtt_client *esp_mqtt_client_handle_t;
+
+typedef enum esp_mqtt_event_id_t {
+    MQTT_EVENT_ANY = -1,
+    MQTT_EVENT_ERROR = 0,
+    MQTT_EVENT_CONNECTED,
+    MQTT_EVENT_DISCONNECTED,
+    MQTT_EVENT_SUBSCRIBED,
+    MQTT_EVENT_UNSUBSCRIBED,
+    MQTT_EVENT_PUBLISHED,
+    MQTT_EVENT_DATA,
+    MQTT_EVENT_BEFORE_CONNECT,
+    MQTT_EVENT_DELETED,
+} esp_mqtt_event_id_t;
+
+typedef enum esp_mqtt_error_type_t {
+    MQTT_ERROR_TYPE_NONE = 0,
+    MQTT_ERROR_TYPE_TCP_TRANSPORT,
+    MQTT_ERROR_TYPE_CONNECTION_REFUSED,
+} esp_mqtt_error_type_t;
+
+typedef enum esp_mqtt_connect_return_code_t {
+    MQTT_CONNECTION_ACCEPTED = 0,
+    MQTT_CONNECTION_REFUSE_PROTOCOL,
+    MQTT_CONNECTION_REFUSE_ID_REJECTED,
+    MQTT_CONNECTION_REFUSE_SERVER_UNAVAILABLE,
+    MQTT_CONNECTION_REFUSE_BAD_USERNAME,
+    MQTT_CONNECTION_REFUSE_NOT_AUTHORIZED
+} esp_mqtt_connect_return_code_t;
+
+typedef enum esp_mqtt_transport_t {
+    MQTT_TRANSPORT_UNKNOWN = 0x0,
+    MQTT_TRANSPORT_OVER_TCP,
+    MQTT_TRANSPORT_OVER_SSL,
+    MQTT_TRANSPORT_OVER_WS,
+    MQTT_TRANSPORT_OVER_WSS
+} esp_mqtt_transport_t;
+
+typedef enum esp_mqtt_protocol_ver_t {
+    MQTT_PROTOCOL_UNDEFINED = 0,
+    MQTT_PROTOCOL_V_3_1,
+    MQTT_PROTOCOL_V_3_1_1
+} esp_mqtt_protocol_ver_t;
+
+typedef struct esp_mqtt_error_codes {
+    esp_err_t esp_tls_last_esp_err;
+    int esp_tls_stack_err;
+    int esp_tls_cert_verify_flags;
+    esp_mqtt_error_type_t error_type;
+    esp_mqtt_connect_return_code_t connect_return_code;
+    int esp_transport_sock_errno;
+} esp_mqtt_error_codes_t;
+
+typedef struct esp_mqtt_event_t {
+    esp_mqtt_event_id_t event_id;
+    esp_mqtt_client_handle_t client;
+    void *user_context;
+    char *data;
+    int data_len;
+    int total_data_len;
+    int current_data_offset;
+    char *topic;
+    int topic_len;
+    int msg_id;
+    int session_present;
+    esp_mqtt_error_codes_t *error_handle;
+    bool retain;
+    int qos;
+    bool dup;
+} esp_mqtt_event_t;
+
+typedef esp_mqtt_event_t *esp_mqtt_event_handle_t;
+
+typedef esp_err_t (*mqtt_event_callback_t)(esp_mqtt_event_handle_t event);
+
+/**
+ * Same field order as the ESP-IDF 4.4 esp-mqtt config, so designated initializers written
+ * against the device headers compile unchanged.
+ */
+typedef struct {
+    mqtt_event_callback_t event_handle;
+    void *event_loop_handle;
+    const char *host;
+    const char *uri;
+    uint32_t port;
+    bool set_null_client_id;
+    const char *client_id;
+    const char *username;
+    const char *password;
+    const char *lwt_topic;
+    const char *lwt_msg;
+    int lwt_qos;
+    int lwt_retain;
+    int lwt_msg_len;
+    int disable_clean_session;
+    int keepalive;
+    bool disable_auto_reconnect;
+    void *user_context;
+    int task_prio;
+    int task_stack;
+    int buffer_size;
+    const char *cert_pem;
+    size_t cert_len;
+    const char *client_cert_pem;
+    size_t client_cert_len;
+    const char *client_key_pem;
+    size_t client_key_len;
+    esp_mqtt_transport_t transport;
+    int refresh_connection_after_ms;
+    const void *psk_hint_key;
+    bool use_global_ca_store;
+    esp_err_t (*crt_bundle_attach)(void *conf);
+    int reconnect_timeout_ms;
+    const char **alpn_protos;
+    const char *clientkey_password;
+    int clientkey_password_len;
+    esp_mqtt_protocol_ver_t protocol_ver;
+    int out_buffer_size;
+    bool skip_cert_common_name_check;
+    bool use_secure_element;
+    void *ds_data;
+    int network_timeout_ms;
+    bool disable_keepalive;
+    const char *path;
+    int message_retransmit_timeout;
+} esp_mqtt_client_config_t;
+
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t *config);
+
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t client);
+
+esp_err_t esp_mqtt_client_stop(esp_mqtt_client_handle_t client);
+
+esp_err_t esp_mqtt_client_destroy(esp_mqtt_client_handle_t client);
+
+esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t event, esp_event_handler_t handler, void *arg);
+
+int esp_mqtt_client_subscribe(esp_mqtt_client_handle_t client, const char *topic, int qos);
+
+// IDF 5.1 multi-topic SUBSCRIBE
+typedef struct topic_t {
+    const char *filter;
+    int qos;
+} esp_mqtt_topic_t;
+
+int esp_mqtt_client_subscribe_multiple(esp_mqtt_client_handle_t client, const esp_mqtt_topic_t *topic_list, int size);
+
+int esp_mqtt_client_unsubscribe(esp_mqtt_client_handle_t client, const char *topic);
+
+int esp_mqtt_client_publish(esp_mqtt_client_handle_t client, const char *topic, const char *data, int len, int qos, int retain);
+
+int esp_mqtt_client_enqueue(esp_mqtt_client_handle_t client, const char *topic, const char *data, int len, int qos, int retain, bool store);
+
+int esp_mqtt_client_get_outbox_size(esp_mqtt_client_handle_t client);
+
+/*
+ * Host-only hooks of the fake client: there is no broker, the test/bench side drives
+ * the client by injecting events and inspects what was published.
+ */
+
+#define ESP_MQTT_FAKE_CLIENT 1
+
+esp_mqtt_client_handle_t esp_mqtt_fake_last_client();
+
+void esp_mqtt_fake_dispatch(esp_mqtt_client_handle_t client, esp_mqtt_event_handle_t event);
+
+typedef void (*esp_mqtt_fake_publish_hook_t)(void *arg, const char *topic, const char *data, int len, int qos, int retain);
+
+void esp_mqtt_fake_set_publish_hook(esp_mqtt_client_handle_t client, esp_mqtt_fake_publish_hook_t hook, void *arg);
+
+// one call per SUBSCRIBE packet
+typedef void (*esp_mqtt_fake_subscribe_hook_t)(void *arg, int msgId, const esp_mqtt_topic_t *topics, int size);
+
+void esp_mqtt_fake_set_subscribe_hook(esp_mqtt_client_handle_t client, esp_mqtt_fake_subscribe_hook_t hook, void *arg);
+
+// what esp_mqtt_client_get_outbox_size reports from now on
+void esp_mqtt_fake_set_outbox_size(esp_mqtt_client_handle_t client, int size);
+
+// id of the last publish, subscribe or unsubscribe, to ack it with MQTT_EVENT_PUBLISHED and the like
+int esp_mqtt_fake_last_msg_id(esp_mqtt_client_handle_t client);
+
+#ifdef __cplusplus
+}
+#endif
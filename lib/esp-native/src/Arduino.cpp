@@ -0,0 +1,18 @@
+#include <Arduino.h>
+
+#include <chrono>
+#include <thread>
+
+#include "TimerDaemon.h"
+
+unsigned long millis() {
+    return (unsigned long) (native::TimerDaemon::nowUs() / 1000);
+}
+
+unsigned long micros() {
+    return (unsigned long) native::TimerDaemon::nowUs();
+}
+
+void delay(uint32_t ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
@@ -0,0 +1,16 @@
+#include <esp_heap_caps.h>
+
+#include <malloc.h>
+
+// glibc has no notion of a device heap: report the arena's free space as one block
+size_t heap_caps_get_free_size(uint32_t) {
+    return mallinfo2().fordblks;
+}
+
+size_t heap_caps_get_minimum_free_size(uint32_t caps) {
+    return heap_caps_get_free_size(caps);
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps) {
+    return heap_caps_get_free_size(caps);
+}
@@ -0,0 +1,26 @@
+#include <esp_log.h>
+
+#include <cstdarg>
+#include <cstdio>
+
+#include "TimerDaemon.h"
+
+static esp_log_level_t logLevel = ESP_LOG_INFO;
+
+void esp_log_level_set(const char *, esp_log_level_t level) {
+    logLevel = level;
+}
+
+uint32_t esp_log_timestamp() {
+    return (uint32_t) (native::TimerDaemon::nowUs() / 1000);
+}
+
+void esp_log_write(esp_log_level_t level, const char *, const char *format, ...) {
+    if (level > logLevel) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+}
@@ -0,0 +1,53 @@
+#include <esp_timer.h>
+
+#include "TimerDaemon.h"
+
+struct esp_timer {
+    std::shared_ptr<native::TimerTask> task;
+};
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *handle) {
+    if (!args || !handle || !args->callback) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    auto callback = args->callback;
+    auto arg = args->arg;
+    *handle = new esp_timer{native::TimerDaemon::instance().create([callback, arg]() {
+        callback(arg);
+    })};
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeoutUs) {
+    if (native::TimerDaemon::instance().isActive(timer->task)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    native::TimerDaemon::instance().start(timer->task, timeoutUs, false);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t periodUs) {
+    if (native::TimerDaemon::instance().isActive(timer->task)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    native::TimerDaemon::instance().start(timer->task, periodUs, true);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+    if (!native::TimerDaemon::instance().isActive(timer->task)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    native::TimerDaemon::instance().stop(timer->task);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer) {
+    native::TimerDaemon::instance().stop(timer->task);
+    delete timer;
+    return ESP_OK;
+}
+
+int64_t esp_timer_get_time() {
+    return (int64_t) native::TimerDaemon::nowUs();
+}
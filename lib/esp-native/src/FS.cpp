@@ -0,0 +1,121 @@
+#include <LittleFS.h>
+
+#include <cstdlib>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+fs::LittleFSFS LittleFS;
+
+namespace fs {
+
+    static void makeParents(const std::string &path) {
+        for (size_t pos = path.find('/', 1); pos != std::string::npos; pos = path.find('/', pos + 1)) {
+            ::mkdir(path.substr(0, pos).c_str(), 0755);
+        }
+    }
+
+    File::File(FILE *file, std::string_view path) : _file(file, fclose), _path(path) {}
+
+    size_t File::write(const uint8_t *buf, size_t size) {
+        return _file ? fwrite(buf, 1, size, _file.get()) : 0;
+    }
+
+    size_t File::read(uint8_t *buf, size_t size) {
+        return _file ? fread(buf, 1, size, _file.get()) : 0;
+    }
+
+    int File::read() {
+        return _file ? fgetc(_file.get()) : -1;
+    }
+
+    int File::available() {
+        return _file ? (int) (size() - position()) : 0;
+    }
+
+    String File::readString() {
+        std::string result(available(), '\0');
+        result.resize(read(reinterpret_cast<uint8_t *>(result.data()), result.size()));
+        return String(result);
+    }
+
+    bool File::seek(uint32_t pos, SeekMode mode) {
+        return _file && fseek(_file.get(), pos, mode) == 0;
+    }
+
+    size_t File::position() const {
+        return _file ? ftell(_file.get()) : 0;
+    }
+
+    size_t File::size() const {
+        if (!_file) {
+            return 0;
+        }
+        struct stat st{};
+        fflush(_file.get());
+        return fstat(fileno(_file.get()), &st) == 0 ? st.st_size : 0;
+    }
+
+    void File::flush() {
+        if (_file) {
+            fflush(_file.get());
+        }
+    }
+
+    void File::close() {
+        _file.reset();
+    }
+
+    std::string FS::realPath(const char *path) const {
+        std::string result = _root;
+        if (*path != '/') {
+            result += '/';
+        }
+        return result.append(path);
+    }
+
+    File FS::open(const char *path, const char *mode, bool create) {
+        auto real = realPath(path);
+        std::string fmode = mode;
+        if (fmode != FILE_READ || create) {
+            makeParents(real);
+        }
+        fmode += 'b';
+        FILE *file = fopen(real.c_str(), fmode.c_str());
+        return file ? File(file, path) : File();
+    }
+
+    bool FS::exists(const char *path) {
+        struct stat st{};
+        return ::stat(realPath(path).c_str(), &st) == 0;
+    }
+
+    bool FS::remove(const char *path) {
+        return ::unlink(realPath(path).c_str()) == 0;
+    }
+
+    bool FS::mkdir(const char *path) {
+        auto real = realPath(path);
+        makeParents(real);
+        return ::mkdir(real.c_str(), 0755) == 0;
+    }
+
+    bool LittleFSFS::begin(bool, const char *, uint8_t, const char *) {
+        if (!root().empty()) {
+            return true;
+        }
+        if (const char *env = getenv("LITTLEFS_ROOT"); env && *env) {
+            setRoot(env);
+            ::mkdir(env, 0755);
+            return true;
+        }
+        char tmpl[] = "/tmp/littlefs-XXXXXX";
+        if (!mkdtemp(tmpl)) {
+            return false;
+        }
+        setRoot(tmpl);
+        return true;
+    }
+
+    void LittleFSFS::end() {}
+}
@@ -0,0 +1,238 @@
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/timers.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include "TimerDaemon.h"
+
+struct QueueDefinition {
+    std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+
+    std::vector<uint8_t> owned;
+    uint8_t *storage;
+    UBaseType_t length;
+    UBaseType_t itemSize;
+    UBaseType_t head{0};
+    UBaseType_t count{0};
+    // built in a StaticQueue_t, vQueueDelete only destroys it
+    bool isStatic{false};
+
+    QueueDefinition(UBaseType_t length, UBaseType_t itemSize)
+            : owned(length * itemSize + 1), storage(owned.data()), length(length), itemSize(itemSize) {}
+
+    QueueDefinition(UBaseType_t length, UBaseType_t itemSize, uint8_t *storage)
+            : storage(storage), length(length), itemSize(itemSize), isStatic(true) {}
+
+    template<typename Pred>
+    bool wait(std::unique_lock<std::mutex> &lock, std::condition_variable &cond, TickType_t ticks, Pred pred) {
+        if (ticks == portMAX_DELAY) {
+            cond.wait(lock, pred);
+            return true;
+        }
+        // a zero wait only checks, as FreeRTOS does, instead of a timed wait in the kernel
+        if (!ticks) {
+            return pred();
+        }
+        return cond.wait_for(lock, std::chrono::milliseconds(ticks * portTICK_PERIOD_MS), pred);
+    }
+
+    BaseType_t send(const void *item, TickType_t ticks, bool front) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!wait(lock, notFull, ticks, [this]() { return count < length; })) {
+            return errQUEUE_FULL;
+        }
+        UBaseType_t slot;
+        if (front) {
+            head = (head + length - 1) % length;
+            slot = head;
+        } else {
+            slot = (head + count) % length;
+        }
+        memcpy(&storage[slot * itemSize], item, itemSize);
+        count++;
+        notEmpty.notify_one();
+        return pdPASS;
+    }
+
+    BaseType_t receive(void *buffer, TickType_t ticks) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!wait(lock, notEmpty, ticks, [this]() { return count > 0; })) {
+            return pdFAIL;
+        }
+        memcpy(buffer, &storage[head * itemSize], itemSize);
+        head = (head + 1) % length;
+        count--;
+        notFull.notify_one();
+        return pdPASS;
+    }
+};
+
+struct tmrTimerControl {
+    std::shared_ptr<native::TimerTask> task;
+    TickType_t period;
+    UBaseType_t autoReload;
+    void *timerId;
+};
+
+void vPortEnterCritical(portMUX_TYPE *mux) {
+    while (__atomic_exchange_n(&mux->owner, 1, __ATOMIC_ACQUIRE)) {
+        std::this_thread::yield();
+    }
+}
+
+void vPortExitCritical(portMUX_TYPE *mux) {
+    __atomic_store_n(&mux->owner, 0, __ATOMIC_RELEASE);
+}
+
+TickType_t xTaskGetTickCount() {
+    return (TickType_t) (native::TimerDaemon::nowUs() / 1000 / portTICK_PERIOD_MS);
+}
+
+void vTaskDelay(TickType_t ticks) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ticks * portTICK_PERIOD_MS));
+}
+
+struct tskTaskControlBlock {
+    std::string name;
+};
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t, void *param, UBaseType_t, TaskHandle_t *handle) {
+    auto *task = new tskTaskControlBlock{name ? name : ""};
+    if (handle) {
+        *handle = task;
+    }
+    std::thread([fn, param, task]() {
+        fn(param);
+        delete task;
+    }).detach();
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t) {}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+    return new QueueDefinition(length, itemSize);
+}
+
+static_assert(sizeof(QueueDefinition) <= sizeof(StaticQueue_t) && alignof(QueueDefinition) <= alignof(StaticQueue_t), "StaticQueue_t is too small");
+
+QueueHandle_t xQueueCreateStatic(UBaseType_t length, UBaseType_t itemSize, uint8_t *storage, StaticQueue_t *buffer) {
+    return new(buffer->impl) QueueDefinition(length, itemSize, storage);
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+    if (queue->isStatic) {
+        queue->~QueueDefinition();
+    } else {
+        delete queue;
+    }
+}
+
+BaseType_t xQueueSendToBack(QueueHandle_t queue, const void *item, TickType_t ticksToWait) {
+    return queue->send(item, ticksToWait, false);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t queue, const void *item, TickType_t ticksToWait) {
+    return queue->send(item, ticksToWait, true);
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void *item, BaseType_t *higherPriorityTaskWoken) {
+    if (higherPriorityTaskWoken) {
+        *higherPriorityTaskWoken = pdFALSE;
+    }
+    return queue->send(item, 0, false);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *buffer, TickType_t ticksToWait) {
+    return queue->receive(buffer, ticksToWait);
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    return queue->count;
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue) {
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    return queue->length - queue->count;
+}
+
+TimerHandle_t xTimerCreate(const char *, TickType_t period, UBaseType_t autoReload, void *timerId, TimerCallbackFunction_t callback) {
+    auto *timer = new tmrTimerControl{nullptr, period, autoReload, timerId};
+    timer->task = native::TimerDaemon::instance().create([timer, callback]() {
+        callback(timer);
+    });
+    return timer;
+}
+
+BaseType_t xTimerStart(TimerHandle_t timer, TickType_t) {
+    if (!timer) {
+        return pdFAIL;
+    }
+    native::TimerDaemon::instance().start(timer->task, (uint64_t) timer->period * portTICK_PERIOD_MS * 1000, timer->autoReload);
+    return pdPASS;
+}
+
+BaseType_t xTimerStop(TimerHandle_t timer, TickType_t) {
+    if (!timer) {
+        return pdFAIL;
+    }
+    native::TimerDaemon::instance().stop(timer->task);
+    return pdPASS;
+}
+
+BaseType_t xTimerDelete(TimerHandle_t timer, TickType_t) {
+    if (!timer) {
+        return pdFAIL;
+    }
+    native::TimerDaemon::instance().stop(timer->task);
+    delete timer;
+    return pdPASS;
+}
+
+void *pvTimerGetTimerID(TimerHandle_t timer) {
+    return timer->timerId;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary() {
+    return new QueueDefinition(1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t *buffer) {
+    auto *semaphore = new QueueDefinition(1, 0);
+    buffer->impl = semaphore;
+    return semaphore;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticksToWait) {
+    uint8_t dummy;
+    return semaphore->receive(&dummy, ticksToWait);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+    uint8_t dummy = 0;
+    return semaphore->send(&dummy, 0, false);
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t semaphore, BaseType_t *higherPriorityTaskWoken) {
+    if (higherPriorityTaskWoken) {
+        *higherPriorityTaskWoken = pdFALSE;
+    }
+    return xSemaphoreGive(semaphore);
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore) {
+    delete semaphore;
+}
@@ -0,0 +1,113 @@
+#include <mqtt_client.h>
+
+#include <map>
+#include <utility>
+
+struct esp_mqtt_client {
+    esp_mqtt_client_config_t config;
+    std::map<int32_t, std::pair<esp_event_handler_t, void *>> handlers;
+    esp_mqtt_fake_publish_hook_t publishHook{nullptr};
+    void *publishArg{nullptr};
+    esp_mqtt_fake_subscribe_hook_t subscribeHook{nullptr};
+    void *subscribeArg{nullptr};
+    int msgId{0};
+    int outboxSize{0};
+    bool started{false};
+};
+
+static esp_mqtt_client_handle_t lastClient = nullptr;
+
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t *config) {
+    auto *client = new esp_mqtt_client{*config, {}};
+    lastClient = client;
+    return client;
+}
+
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t client) {
+    if (client->started) {
+        return ESP_FAIL;
+    }
+    client->started = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_stop(esp_mqtt_client_handle_t client) {
+    client->started = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_destroy(esp_mqtt_client_handle_t client) {
+    if (lastClient == client) {
+        lastClient = nullptr;
+    }
+    delete client;
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t event, esp_event_handler_t handler, void *arg) {
+    client->handlers[event] = {handler, arg};
+    return ESP_OK;
+}
+
+int esp_mqtt_client_subscribe(esp_mqtt_client_handle_t client, const char *topic, int qos) {
+    esp_mqtt_topic_t single{topic, qos};
+    return esp_mqtt_client_subscribe_multiple(client, &single, 1);
+}
+
+int esp_mqtt_client_subscribe_multiple(esp_mqtt_client_handle_t client, const esp_mqtt_topic_t *topic_list, int size) {
+    int msgId = ++client->msgId;
+    if (client->subscribeHook) {
+        client->subscribeHook(client->subscribeArg, msgId, topic_list, size);
+    }
+    return msgId;
+}
+
+int esp_mqtt_client_unsubscribe(esp_mqtt_client_handle_t client, const char *) {
+    return ++client->msgId;
+}
+
+int esp_mqtt_client_publish(esp_mqtt_client_handle_t client, const char *topic, const char *data, int len, int qos, int retain) {
+    if (client->publishHook) {
+        client->publishHook(client->publishArg, topic, data, len, qos, retain);
+    }
+    return qos ? ++client->msgId : 0;
+}
+
+int esp_mqtt_client_enqueue(esp_mqtt_client_handle_t client, const char *topic, const char *data, int len, int qos, int retain, bool) {
+    return esp_mqtt_client_publish(client, topic, data, len, qos, retain);
+}
+
+int esp_mqtt_client_get_outbox_size(esp_mqtt_client_handle_t client) {
+    return client->outboxSize;
+}
+
+esp_mqtt_client_handle_t esp_mqtt_fake_last_client() {
+    return lastClient;
+}
+
+void esp_mqtt_fake_dispatch(esp_mqtt_client_handle_t client, esp_mqtt_event_handle_t event) {
+    event->client = client;
+    for (auto id: {(int32_t) event->event_id, (int32_t) MQTT_EVENT_ANY}) {
+        if (auto it = client->handlers.find(id); it != client->handlers.end()) {
+            it->second.first(it->second.second, "MQTT_EVENTS", event->event_id, event);
+        }
+    }
+}
+
+void esp_mqtt_fake_set_publish_hook(esp_mqtt_client_handle_t client, esp_mqtt_fake_publish_hook_t hook, void *arg) {
+    client->publishHook = hook;
+    client->publishArg = arg;
+}
+
+void esp_mqtt_fake_set_subscribe_hook(esp_mqtt_client_handle_t client, esp_mqtt_fake_subscribe_hook_t hook, void *arg) {
+    client->subscribeHook = hook;
+    client->subscribeArg = arg;
+}
+
+void esp_mqtt_fake_set_outbox_size(esp_mqtt_client_handle_t client, int size) {
+    client->outboxSize = size;
+}
+
+int esp_mqtt_fake_last_msg_id(esp_mqtt_client_handle_t client) {
+    return client->msgId;
+}
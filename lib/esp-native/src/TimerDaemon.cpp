@@ -0,0 +1,122 @@
+#include "TimerDaemon.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace native {
+
+    struct TimerTask {
+        std::function<void()> callback;
+        uint64_t periodUs{0};
+        bool repeat{false};
+        bool armed{false};
+        uint64_t generation{0};
+    };
+
+    namespace {
+        struct Deadline {
+            uint64_t at;
+            uint64_t generation;
+            std::shared_ptr<TimerTask> task;
+
+            bool operator>(const Deadline &other) const {
+                return at > other.at;
+            }
+        };
+
+        struct DaemonState {
+            std::mutex mutex;
+            std::condition_variable wakeup;
+            std::priority_queue<Deadline, std::vector<Deadline>, std::greater<>> deadlines;
+            std::thread thread;
+
+            DaemonState() {
+                thread = std::thread([this]() { run(); });
+                thread.detach();
+            }
+
+            void run() {
+                std::unique_lock<std::mutex> lock(mutex);
+                while (true) {
+                    if (deadlines.empty()) {
+                        wakeup.wait(lock);
+                        continue;
+                    }
+
+                    auto now = TimerDaemon::nowUs();
+                    if (deadlines.top().at > now) {
+                        wakeup.wait_for(lock, std::chrono::microseconds(deadlines.top().at - now));
+                        continue;
+                    }
+
+                    Deadline next = deadlines.top();
+                    deadlines.pop();
+                    if (!next.task->armed || next.task->generation != next.generation) {
+                        continue;
+                    }
+
+                    if (next.task->repeat) {
+                        deadlines.push({next.at + next.task->periodUs, next.generation, next.task});
+                    } else {
+                        next.task->armed = false;
+                    }
+
+                    // the task may be stopped or deleted from inside its own callback
+                    auto callback = next.task->callback;
+                    lock.unlock();
+                    callback();
+                    lock.lock();
+                }
+            }
+        };
+
+        DaemonState &state() {
+            static auto *daemon = new DaemonState();
+            return *daemon;
+        }
+    }
+
+    TimerDaemon &TimerDaemon::instance() {
+        static TimerDaemon daemon;
+        return daemon;
+    }
+
+    uint64_t TimerDaemon::nowUs() {
+        static const auto epoch = std::chrono::steady_clock::now();
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - epoch).count();
+    }
+
+    std::shared_ptr<TimerTask> TimerDaemon::create(const std::function<void()> &callback) {
+        auto task = std::make_shared<TimerTask>();
+        task->callback = callback;
+        return task;
+    }
+
+    void TimerDaemon::start(const std::shared_ptr<TimerTask> &task, uint64_t periodUs, bool repeat) {
+        auto &daemon = state();
+        std::lock_guard<std::mutex> lock(daemon.mutex);
+        task->periodUs = periodUs ? periodUs : 1;
+        task->repeat = repeat;
+        task->armed = true;
+        task->generation++;
+        daemon.deadlines.push({nowUs() + task->periodUs, task->generation, task});
+        daemon.wakeup.notify_one();
+    }
+
+    void TimerDaemon::stop(const std::shared_ptr<TimerTask> &task) {
+        auto &daemon = state();
+        std::lock_guard<std::mutex> lock(daemon.mutex);
+        task->armed = false;
+        task->generation++;
+    }
+
+    bool TimerDaemon::isActive(const std::shared_ptr<TimerTask> &task) const {
+        auto &daemon = state();
+        std::lock_guard<std::mutex> lock(daemon.mutex);
+        return task->armed;
+    }
+}
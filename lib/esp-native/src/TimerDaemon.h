@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+namespace native {
+
+    struct TimerTask;
+
+    /**
+     * Single host thread standing in for both the FreeRTOS timer daemon task and the
+     * esp_timer task: callbacks are serialised on it, like on the device.
+     */
+    class TimerDaemon {
+    public:
+        static TimerDaemon &instance();
+
+        static uint64_t nowUs();
+
+        std::shared_ptr<TimerTask> create(const std::function<void()> &callback);
+
+        void start(const std::shared_ptr<TimerTask> &task, uint64_t periodUs, bool repeat);
+
+        void stop(const std::shared_ptr<TimerTask> &task);
+
+        [[nodiscard]] bool isActive(const std::shared_ptr<TimerTask> &task) const;
+    };
+}
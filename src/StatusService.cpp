@@ -4,6 +4,9 @@
 
 #include "StatusService.h"
 #include <Arduino.h>
+#include <esp_heap_caps.h>
+
+#include "core/service/SysService.h"
 
 void toJson(const StatusMessage& msg, cJSON* json) {
     cJSON_AddStringToObject(json, "status", msg.status.c_str());
@@ -13,11 +16,17 @@ void toJson(const StatusMessage& msg, cJSON* json) {
 StatusService::StatusService(Registry &registry) : TService(registry) {}
 
 void StatusService::setup() {
+    // runs on the timer daemon, a full bus drops this second's status instead of stalling it
     _timer.attach(1000, true, [this]() {
         StatusMessage msg;
         msg.timestamp = millis();
         msg.status = "active";
 
-        getRegistry().getMessageBus().postMessage(msg);
+        getRegistry().getMessageBus().tryPostMessage(msg);
+
+        TelemetrySample sample;
+        sample.metric = "free-heap";
+        sample.value = (float) heap_caps_get_free_size(MALLOC_CAP_8BIT);
+        getRegistry().getMessageBus().tryPostMessage(sample);
     });
 }
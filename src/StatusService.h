@@ -5,13 +5,19 @@
 #pragma once
 
 #include "core/Registry.h"
+#include "core/FixedString.h"
 #include "UserService.h"
 #include "cJSON.h"
 
 
 struct StatusMessage : public TMessage<Usr_Status> {
-    std::string status;
+    FixedString<15> status;
     uint32_t timestamp;
+
+    // only the latest status is worth delivering
+    [[nodiscard]] bool isConflated() const override {
+        return true;
+    }
 };
 
 void toJson(const StatusMessage& msg, cJSON* json);
@@ -10,4 +10,5 @@ enum UserServiceId {
 
 enum UserMessage {
     Usr_Status,
+    Usr_Magic_Action,
 };
\ No newline at end of file
@@ -0,0 +1,47 @@
+#include <algorithm>
+#include "BufferPool.h"
+
+BufferPool::BufferPool(size_t blockSize, size_t blocks, HeapTag tag) : _blockSize(blockSize), _blocks(std::min<size_t>(blocks, 32)) {
+    HeapScope scope(tag);
+    _storage = new uint8_t[_blockSize * _blocks];
+    _free = _blocks == 32 ? 0xffffffffu : (1u << _blocks) - 1;
+}
+
+uint8_t *BufferPool::acquire(size_t size) {
+    if (size > _blockSize) {
+        _oversize++;
+        return new uint8_t[size];
+    }
+
+    uint8_t *data = nullptr;
+    portENTER_CRITICAL(&_lock);
+    if (_free) {
+        auto idx = __builtin_ctz(_free);
+        _free &= ~(1u << idx);
+        data = _storage + idx * _blockSize;
+        _highWater = std::max(_highWater, ++_inUse);
+    } else {
+        _exhausted++;
+    }
+    portEXIT_CRITICAL(&_lock);
+    return data;
+}
+
+void BufferPool::release(uint8_t *data) {
+    if (!data) {
+        return;
+    }
+    if (!owns(data)) {
+        delete[] data;
+        return;
+    }
+    auto idx = (data - _storage) / _blockSize;
+    portENTER_CRITICAL(&_lock);
+    _free |= 1u << idx;
+    _inUse--;
+    portEXIT_CRITICAL(&_lock);
+}
+
+BufferPool::~BufferPool() {
+    delete[] _storage;
+}
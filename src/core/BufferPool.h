@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <freertos/FreeRTOS.h>
+
+#include "Heap.h"
+
+/**
+ * Fixed number of equally sized blocks carved out of one allocation, safe to use from any task.
+ * Requests larger than a block fall back to the heap and are counted, a full pool returns nullptr
+ * so the caller decides whether to drop or wait.
+ */
+class BufferPool {
+    uint8_t *_storage;
+    size_t _blockSize;
+    size_t _blocks;
+    uint32_t _free;
+    portMUX_TYPE _lock = portMUX_INITIALIZER_UNLOCKED;
+
+    uint32_t _exhausted{0};
+    uint32_t _oversize{0};
+    size_t _inUse{0};
+    size_t _highWater{0};
+public:
+    BufferPool(size_t blockSize, size_t blocks, HeapTag tag = Heap_Other);
+
+    BufferPool(const BufferPool &) = delete;
+
+    BufferPool &operator=(const BufferPool &) = delete;
+
+    uint8_t *acquire(size_t size);
+
+    void release(uint8_t *data);
+
+    [[nodiscard]] bool owns(const uint8_t *data) const {
+        return data >= _storage && data < _storage + _blockSize * _blocks;
+    }
+
+    [[nodiscard]] size_t getBlockSize() const {
+        return _blockSize;
+    }
+
+    [[nodiscard]] size_t getBlockCount() const {
+        return _blocks;
+    }
+
+    [[nodiscard]] size_t getInUse() const {
+        return _inUse;
+    }
+
+    [[nodiscard]] size_t getHighWater() const {
+        return _highWater;
+    }
+
+    /**
+     * acquire() calls that found every block taken.
+     */
+    [[nodiscard]] uint32_t getExhaustedCount() const {
+        return _exhausted;
+    }
+
+    /**
+     * acquire() calls served from the heap because they did not fit a block.
+     */
+    [[nodiscard]] uint32_t getOversizeCount() const {
+        return _oversize;
+    }
+
+    ~BufferPool();
+};
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+
+#include "MessageBus.h"
+
+/**
+ * Appends to a caller provided buffer, overflow() is set instead of writing past the end.
+ * Integers are stored in host (little endian) order, lengths and ids as varints.
+ */
+class ByteWriter {
+    uint8_t *_data;
+    size_t _capacity;
+    size_t _size{0};
+    bool _overflow{false};
+public:
+    ByteWriter(uint8_t *data, size_t capacity) : _data(data), _capacity(capacity) {}
+
+    void put(const void *data, size_t size) {
+        if (_overflow || _capacity - _size < size) {
+            _overflow = true;
+            return;
+        }
+        memcpy(_data + _size, data, size);
+        _size += size;
+    }
+
+    template<typename T>
+    void put(T value) {
+        static_assert(std::is_arithmetic_v<T> || std::is_enum_v<T>, "plain values only");
+        put(&value, sizeof(value));
+    }
+
+    void putVarint(uint64_t value) {
+        while (value >= 0x80) {
+            put<uint8_t>((uint8_t) (value | 0x80));
+            value >>= 7;
+        }
+        put<uint8_t>((uint8_t) value);
+    }
+
+    void putString(std::string_view value) {
+        putVarint(value.size());
+        put(value.data(), value.size());
+    }
+
+    [[nodiscard]] const uint8_t *data() const {
+        return _data;
+    }
+
+    [[nodiscard]] size_t size() const {
+        return _size;
+    }
+
+    [[nodiscard]] bool overflow() const {
+        return _overflow;
+    }
+};
+
+class ByteReader {
+    const uint8_t *_data;
+    size_t _size;
+    size_t _pos{0};
+    bool _error{false};
+public:
+    ByteReader(const uint8_t *data, size_t size) : _data(data), _size(size) {}
+
+    bool get(void *data, size_t size) {
+        if (_error || _size - _pos < size) {
+            _error = true;
+            return false;
+        }
+        memcpy(data, _data + _pos, size);
+        _pos += size;
+        return true;
+    }
+
+    template<typename T>
+    T get() {
+        static_assert(std::is_arithmetic_v<T> || std::is_enum_v<T>, "plain values only");
+        T value{};
+        get(&value, sizeof(value));
+        return value;
+    }
+
+    uint64_t getVarint() {
+        uint64_t value = 0;
+        for (uint8_t shift = 0; shift < 64; shift += 7) {
+            auto byte = get<uint8_t>();
+            value |= (uint64_t) (byte & 0x7f) << shift;
+            if (!(byte & 0x80)) {
+                return value;
+            }
+        }
+        _error = true;
+        return 0;
+    }
+
+    /**
+     * Points into the reader's buffer.
+     */
+    std::string_view getView() {
+        auto size = getVarint();
+        if (_error || _size - _pos < size) {
+            _error = true;
+            return {};
+        }
+        std::string_view value((const char *) _data + _pos, size);
+        _pos += size;
+        return value;
+    }
+
+    std::string getString() {
+        return std::string(getView());
+    }
+
+    [[nodiscard]] size_t remaining() const {
+        return _size - _pos;
+    }
+
+    [[nodiscard]] bool error() const {
+        return _error;
+    }
+};
+
+struct MessageCodec {
+    std::function<void(const Message &msg, ByteWriter &out)> encode;
+    std::function<Message *(ByteReader &in)> decode;
+};
+
+/**
+ * Binary payload codecs by MsgId, shared by the bus trace and anything else that has to move
+ * messages as bytes.
+ */
+class CodecRegistry {
+    std::unordered_map<MsgId, MessageCodec> _codecs;
+public:
+    template<typename T>
+    void add(const std::function<void(const T &msg, ByteWriter &out)> &encode, const std::function<void(ByteReader &in, T &msg)> &decode) {
+        HeapScope scope(Heap_Bus);
+        auto &codec = _codecs[T::ID];
+        codec.encode = [encode](const Message &msg, ByteWriter &out) {
+            encode(static_cast<const T &>(msg), out);
+        };
+        codec.decode = [decode](ByteReader &in) -> Message * {
+            auto *msg = new T();
+            decode(in, *msg);
+            return msg;
+        };
+    }
+
+    [[nodiscard]] bool contains(MsgId id) const {
+        return _codecs.find(id) != _codecs.end();
+    }
+
+    /**
+     * False when id has no codec or the payload did not fit.
+     */
+    bool encode(const Message &msg, ByteWriter &out) const {
+        auto it = _codecs.find(msg.getMsgId());
+        if (it == _codecs.end()) {
+            return false;
+        }
+        it->second.encode(msg, out);
+        return !out.overflow();
+    }
+
+    /**
+     * Empty when id has no codec or the payload is malformed.
+     */
+    Message::Ptr decode(MsgId id, ByteReader &in) const {
+        auto it = _codecs.find(id);
+        if (it == _codecs.end()) {
+            return {};
+        }
+        Message::Ptr msg(it->second.decode(in));
+        if (in.error()) {
+            msg.reset();
+        }
+        return msg;
+    }
+};
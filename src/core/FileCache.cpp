@@ -0,0 +1,364 @@
+#include "FileCache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <esp_timer.h>
+
+#include "Heap.h"
+#include "MessageBus.h"
+
+// blocks filled per flash read, the rest of a longer run takes another round
+static constexpr size_t MaxRun = 16;
+
+FileCache::FileCache(size_t blocks, size_t readAhead) : _blockCount(blocks ? blocks : 1), _readAhead(readAhead) {
+    HeapScope scope(Heap_File);
+    _data.reset(new uint8_t[_blockCount * BlockSize]);
+    _blocks.reset(new Block[_blockCount]);
+}
+
+FileCache::Ref FileCache::entry(std::string_view path) {
+    auto key = messageKey(path);
+    uint8_t victim = MaxFiles;
+    for (uint8_t idx = 0; idx < MaxFiles; idx++) {
+        auto &file = _files[idx];
+        // a path longer than stats.path keeps matching on its truncated prefix and the key
+        if (file.used && file.key == key && path.substr(0, file.stats.path.size()) == file.stats.path) {
+            file.lastUse = ++_clock;
+            return {idx, file.generation};
+        }
+        if (victim == MaxFiles || (_files[victim].used && (!file.used || file.lastUse < _files[victim].lastUse))) {
+            victim = idx;
+        }
+    }
+    auto &file = _files[victim];
+    auto generation = file.generation + 1;
+    file = FileEntry{};
+    file.stats.path = path;
+    file.key = key;
+    file.generation = generation;
+    file.lastUse = ++_clock;
+    file.used = true;
+    return {victim, generation};
+}
+
+FileCache::Block *FileCache::find(Ref ref, uint32_t index) {
+    for (size_t idx = 0; idx < _blockCount; idx++) {
+        auto &block = _blocks[idx];
+        if (block.valid && block.file == ref.file && block.generation == ref.generation && block.index == index && current(ref)) {
+            return &block;
+        }
+    }
+    return nullptr;
+}
+
+FileCache::Block *FileCache::reserve(Ref ref, uint32_t index) {
+    Block *victim = nullptr;
+    for (size_t idx = 0; idx < _blockCount; idx++) {
+        auto &block = _blocks[idx];
+        if (block.loading) {
+            continue;
+        }
+        if (!block.valid || !current({block.file, block.generation})) {
+            victim = &block;
+            break;
+        }
+        if (!victim || block.lastUse < victim->lastUse) {
+            victim = &block;
+        }
+    }
+    if (victim) {
+        *victim = Block{index, ref.generation, 0, 0, ref.file, false, true};
+    }
+    return victim;
+}
+
+FileCache::Ref FileCache::lookup(std::string_view path) {
+    portENTER_CRITICAL(&_lock);
+    auto ref = entry(path);
+    portEXIT_CRITICAL(&_lock);
+    return ref;
+}
+
+bool FileCache::open(std::string_view path, Ref ref, File &handle) {
+    if (handle) {
+        return true;
+    }
+    auto start = esp_timer_get_time();
+    // the view need not be NUL terminated, a path too long to copy whole is never opened
+    FixedString<63> name;
+    if (name.assign(path)) {
+        handle = LittleFS.open(name.c_str());
+    }
+    auto us = (uint32_t) (esp_timer_get_time() - start);
+    portENTER_CRITICAL(&_lock);
+    if (current(ref)) {
+        _files[ref.file].stats.opens++;
+        _files[ref.file].stats.ioUs += us;
+    }
+    portEXIT_CRITICAL(&_lock);
+    return (bool) handle;
+}
+
+int32_t FileCache::fileSize(std::string_view path, Ref ref, File &handle) {
+    portENTER_CRITICAL(&_lock);
+    int32_t size = current(ref) ? _files[ref.file].size : -1;
+    portEXIT_CRITICAL(&_lock);
+    if (size >= 0) {
+        return size;
+    }
+    // not remembered while missing, the file may show up later
+    if (!open(path, ref, handle)) {
+        return -1;
+    }
+    size = (int32_t) handle.size();
+    portENTER_CRITICAL(&_lock);
+    if (current(ref)) {
+        _files[ref.file].size = size;
+    }
+    portEXIT_CRITICAL(&_lock);
+    return size;
+}
+
+void FileCache::account(Ref ref, size_t bytes) {
+    portENTER_CRITICAL(&_lock);
+    if (current(ref)) {
+        _files[ref.file].stats.reads++;
+        _files[ref.file].stats.bytes += bytes;
+    }
+    portEXIT_CRITICAL(&_lock);
+}
+
+size_t FileCache::readDirect(std::string_view path, Ref ref, File &handle, size_t offset, uint8_t *buf, size_t size) {
+    if (!open(path, ref, handle)) {
+        return 0;
+    }
+    auto start = esp_timer_get_time();
+    handle.seek(offset);
+    auto done = handle.read(buf, size);
+    auto us = (uint32_t) (esp_timer_get_time() - start);
+    portENTER_CRITICAL(&_lock);
+    if (current(ref)) {
+        _files[ref.file].stats.misses += (done + BlockSize - 1) / BlockSize;
+        _files[ref.file].stats.ioUs += us;
+    }
+    portEXIT_CRITICAL(&_lock);
+    return done;
+}
+
+size_t FileCache::readCached(std::string_view path, Ref ref, File &handle, size_t offset, uint8_t *buf, size_t size) {
+    auto fileSize = offset + size;
+    auto copy = [offset, size, buf](uint32_t index, const uint8_t *data, size_t length) -> size_t {
+        size_t start = index * BlockSize;
+        size_t from = std::max(offset, start);
+        size_t to = std::min(offset + size, start + length);
+        if (from >= to) {
+            return 0;
+        }
+        memcpy(buf + (from - offset), data + (from - start), to - from);
+        return to - from;
+    };
+
+    auto first = (uint32_t) (offset / BlockSize);
+    auto last = (uint32_t) ((offset + size - 1) / BlockSize);
+    portENTER_CRITICAL(&_lock);
+    bool sequential = false;
+    uint32_t lastFileBlock = last;
+    if (current(ref)) {
+        auto &file = _files[ref.file];
+        sequential = file.nextBlock == first;
+        file.nextBlock = last + 1;
+        if (file.size > 0) {
+            fileSize = std::max<size_t>(fileSize, file.size);
+        }
+        lastFileBlock = (uint32_t) ((fileSize - 1) / BlockSize);
+    }
+    portEXIT_CRITICAL(&_lock);
+
+    size_t done = 0;
+    for (uint32_t index = first; index <= last;) {
+        Block *run[MaxRun];
+        size_t count = 0;
+        portENTER_CRITICAL(&_lock);
+        if (auto *block = find(ref, index)) {
+            block->lastUse = ++_clock;
+            done += copy(index, blockData(block), block->size);
+            _files[ref.file].stats.hits++;
+            portEXIT_CRITICAL(&_lock);
+            index++;
+            continue;
+        }
+        // the misses in a row, and when a scan reaches the end of the request the blocks after it
+        uint32_t end = index;
+        while (end < last && !find(ref, end + 1)) {
+            end++;
+        }
+        if (end == last && sequential) {
+            end = std::min<uint32_t>(last + _readAhead, lastFileBlock);
+        }
+        for (uint32_t next = index; next <= end && count < MaxRun; next++) {
+            if (next > last && find(ref, next)) {
+                break;
+            }
+            auto *block = reserve(ref, next);
+            if (!block) {
+                break;
+            }
+            run[count++] = block;
+        }
+        portEXIT_CRITICAL(&_lock);
+
+        if (!count) {
+            // every block is being filled by other readers, this one goes around the cache
+            size_t start = std::max<size_t>(offset, (size_t) index * BlockSize);
+            size_t length = std::min<size_t>(offset + size, (size_t) (index + 1) * BlockSize) - start;
+            done += readDirect(path, ref, handle, start, buf + (start - offset), length);
+            index++;
+            continue;
+        }
+
+        size_t demanded = 0;
+        if (open(path, ref, handle)) {
+            auto start = esp_timer_get_time();
+            handle.seek(index * BlockSize);
+            for (size_t idx = 0; idx < count; idx++) {
+                run[idx]->size = (uint16_t) handle.read(blockData(run[idx]), BlockSize);
+            }
+            auto us = (uint32_t) (esp_timer_get_time() - start);
+            // still pinned by loading, nobody else writes them
+            for (size_t idx = 0; idx < count && run[idx]->index <= last; idx++) {
+                done += copy(run[idx]->index, blockData(run[idx]), run[idx]->size);
+                demanded++;
+            }
+            portENTER_CRITICAL(&_lock);
+            if (current(ref)) {
+                auto &stats = _files[ref.file].stats;
+                stats.misses += demanded;
+                stats.prefetched += count - demanded;
+                stats.ioUs += us;
+            }
+            portEXIT_CRITICAL(&_lock);
+        }
+
+        portENTER_CRITICAL(&_lock);
+        for (size_t idx = 0; idx < count; idx++) {
+            auto *block = run[idx];
+            block->loading = false;
+            block->valid = block->size && current(ref);
+            // read ahead goes in cold, the first hit warms it up
+            block->lastUse = block->index <= last ? ++_clock : 0;
+        }
+        portEXIT_CRITICAL(&_lock);
+        if (!demanded) {
+            // the file is gone or shorter than it was
+            break;
+        }
+        index += demanded;
+    }
+    return done;
+}
+
+size_t FileCache::read(std::string_view path, size_t offset, uint8_t *buf, size_t size) {
+    auto ref = lookup(path);
+    File handle;
+    auto fileSize = this->fileSize(path, ref, handle);
+    if (fileSize < 0 || offset >= (size_t) fileSize || !size) {
+        account(ref, 0);
+        return 0;
+    }
+    size = std::min(size, fileSize - offset);
+    auto done = readCached(path, ref, handle, offset, buf, size);
+    account(ref, done);
+    return done;
+}
+
+size_t FileCache::readAll(std::string_view path, Ref ref, File &handle, uint8_t *buf, size_t size) {
+    if (!size) {
+        return 0;
+    }
+    if (size > _blockCount * BlockSize / 2) {
+        return readDirect(path, ref, handle, 0, buf, size);
+    }
+    return readCached(path, ref, handle, 0, buf, size);
+}
+
+esp_err_t FileCache::read(std::string_view path, std::string &out) {
+    auto ref = lookup(path);
+    File handle;
+    auto fileSize = this->fileSize(path, ref, handle);
+    if (fileSize < 0) {
+        account(ref, 0);
+        return ESP_ERR_NOT_FOUND;
+    }
+    out.clear();
+    out.resize(fileSize);
+    auto done = readAll(path, ref, handle, (uint8_t *) out.data(), fileSize);
+    out.resize(done);
+    account(ref, done);
+    return ESP_OK;
+}
+
+esp_err_t FileCache::read(std::string_view path, SharedBuffer &out) {
+    auto ref = lookup(path);
+    File handle;
+    auto fileSize = this->fileSize(path, ref, handle);
+    if (fileSize < 0) {
+        account(ref, 0);
+        return ESP_ERR_NOT_FOUND;
+    }
+    out = SharedBuffer::allocate(fileSize);
+    auto done = fileSize ? readAll(path, ref, handle, out.mutableData(), fileSize) : 0;
+    out.resize(done);
+    account(ref, done);
+    return ESP_OK;
+}
+
+int32_t FileCache::size(std::string_view path) {
+    auto ref = lookup(path);
+    File handle;
+    return fileSize(path, ref, handle);
+}
+
+bool FileCache::write(std::string_view path, std::string_view data) {
+    bool written = false;
+    FixedString<63> name;
+    if (name.assign(path)) {
+        if (File file = LittleFS.open(name.c_str(), FILE_WRITE); file) {
+            written = file.write((const uint8_t *) data.data(), data.size()) == data.size();
+        }
+    }
+    invalidate(path);
+    return written;
+}
+
+void FileCache::invalidate(std::string_view path) {
+    auto key = messageKey(path);
+    portENTER_CRITICAL(&_lock);
+    for (auto &file: _files) {
+        if (file.used && file.key == key && path.substr(0, file.stats.path.size()) == file.stats.path) {
+            file.generation++;
+            file.size = -1;
+            file.nextBlock = NoBlock;
+        }
+    }
+    portEXIT_CRITICAL(&_lock);
+}
+
+void FileCache::forEachStats(const std::function<void(const FileStats &)> &callback) const {
+    FileStats snapshot[MaxFiles];
+    size_t count = 0;
+    portENTER_CRITICAL(&_lock);
+    for (auto &file: _files) {
+        if (file.used) {
+            snapshot[count++] = file.stats;
+        }
+    }
+    portEXIT_CRITICAL(&_lock);
+    for (size_t idx = 0; idx < count; idx++) {
+        callback(snapshot[idx]);
+    }
+}
+
+FileCache &files::cache() {
+    static FileCache cache;
+    return cache;
+}
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include <esp_err.h>
+#include <freertos/FreeRTOS.h>
+#include <LittleFS.h>
+
+#include "FixedString.h"
+#include "SharedBuffer.h"
+
+struct FileStats {
+    FixedString<63> path;
+    uint32_t reads{0};
+    uint32_t bytes{0};
+    // blocks a read found in the cache, and the ones it had to wait for flash
+    uint32_t hits{0};
+    uint32_t misses{0};
+    // blocks read ahead of a sequential scan
+    uint32_t prefetched{0};
+    uint32_t opens{0};
+    // opening and reading, cache hits cost nothing here
+    uint32_t ioUs{0};
+};
+
+/**
+ * Reads LittleFS files through a small LRU cache of BlockSize blocks carved out of one
+ * allocation. Whole-file reads size their buffer once from the file size instead of growing
+ * it, a read that continues where the previous one on the same file stopped also reads the
+ * next readAhead blocks. Those go in at the cold end of the LRU, so a long scan does not push
+ * out the config and certificates. Whole files larger than half the cache bypass it.
+ *
+ * Cached blocks are not checked against the file: write through write(), or invalidate() a
+ * file changed behind the cache's back. Every file read keeps its FileStats, up to MaxFiles
+ * files at a time. Safe to use from any task, flash I/O runs outside the lock.
+ */
+class FileCache {
+public:
+    static constexpr size_t BlockSize = 512;
+    static constexpr size_t MaxFiles = 12;
+private:
+    static constexpr uint32_t NoBlock = UINT32_MAX;
+
+    struct FileEntry {
+        FileStats stats;
+        uint32_t key{0};
+        // bumped on invalidate and reuse, blocks of an older generation are gone
+        uint32_t generation{0};
+        int32_t size{-1};
+        uint32_t nextBlock{NoBlock};
+        uint32_t lastUse{0};
+        bool used{false};
+    };
+
+    struct Block {
+        uint32_t index{0};
+        uint32_t generation{0};
+        uint32_t lastUse{0};
+        uint16_t size{0};
+        uint8_t file{0};
+        bool valid{false};
+        // being filled outside the lock, not a victim and not a hit yet
+        bool loading{false};
+    };
+
+    // an entry as it was when looked up, it may be reused for another file meanwhile
+    struct Ref {
+        uint8_t file;
+        uint32_t generation;
+    };
+
+    std::unique_ptr<uint8_t[]> _data;
+    std::unique_ptr<Block[]> _blocks;
+    size_t _blockCount;
+    size_t _readAhead;
+    FileEntry _files[MaxFiles];
+    uint32_t _clock{0};
+    mutable portMUX_TYPE _lock = portMUX_INITIALIZER_UNLOCKED;
+private:
+    // with _lock held
+    Ref entry(std::string_view path);
+
+    [[nodiscard]] bool current(Ref ref) const {
+        return _files[ref.file].generation == ref.generation;
+    }
+
+    Block *find(Ref ref, uint32_t index);
+
+    Block *reserve(Ref ref, uint32_t index);
+
+    [[nodiscard]] uint8_t *blockData(const Block *block) const {
+        return _data.get() + (block - _blocks.get()) * BlockSize;
+    }
+
+    // _lock not held
+    Ref lookup(std::string_view path);
+
+    bool open(std::string_view path, Ref ref, File &handle);
+
+    int32_t fileSize(std::string_view path, Ref ref, File &handle);
+
+    size_t readDirect(std::string_view path, Ref ref, File &handle, size_t offset, uint8_t *buf, size_t size);
+
+    size_t readCached(std::string_view path, Ref ref, File &handle, size_t offset, uint8_t *buf, size_t size);
+
+    // the whole file, around the cache when it would take more than half of it
+    size_t readAll(std::string_view path, Ref ref, File &handle, uint8_t *buf, size_t size);
+
+    void account(Ref ref, size_t bytes);
+
+public:
+    explicit FileCache(size_t blocks = 16, size_t readAhead = 2);
+
+    FileCache(const FileCache &) = delete;
+
+    FileCache &operator=(const FileCache &) = delete;
+
+    /**
+     * Up to size bytes from offset, fewer at the end of the file, zero when it does not exist.
+     */
+    size_t read(std::string_view path, size_t offset, uint8_t *buf, size_t size);
+
+    /**
+     * The whole file in one allocation of its exact size.
+     */
+    esp_err_t read(std::string_view path, std::string &out);
+
+    /**
+     * The whole file in one SharedBuffer, pooled when it fits a pool block.
+     */
+    esp_err_t read(std::string_view path, SharedBuffer &out);
+
+    /**
+     * Size of the file, -1 when it does not exist.
+     */
+    int32_t size(std::string_view path);
+
+    /**
+     * Replaces the file, its cached blocks go.
+     */
+    bool write(std::string_view path, std::string_view data);
+
+    void invalidate(std::string_view path);
+
+    /**
+     * A snapshot per file read so far, the least recently read go first once MaxFiles are tracked.
+     */
+    void forEachStats(const std::function<void(const FileStats &)> &callback) const;
+
+    [[nodiscard]] size_t getBlockCount() const {
+        return _blockCount;
+    }
+};
+
+namespace files {
+    /**
+     * Process wide cache, PropertiesLoader and the MQTT credentials read through it.
+     */
+    FileCache &cache();
+}
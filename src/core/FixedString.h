@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+
+/**
+ * Up to N bytes stored inline and always NUL terminated, so a message field copies with the
+ * message and never touches the heap. Longer input is cut at the last whole UTF-8 character
+ * that fits, assign() returns false when it had to.
+ */
+template<size_t N>
+class FixedString {
+    static_assert(N > 0 && N < 256, "the size is kept in a byte");
+
+    uint8_t _size{0};
+    char _data[N + 1]{};
+public:
+    static constexpr size_t Capacity = N;
+
+    FixedString() = default;
+
+    FixedString(std::string_view value) {
+        assign(value);
+    }
+
+    FixedString(const char *value) : FixedString(std::string_view(value)) {}
+
+    FixedString &operator=(std::string_view value) {
+        assign(value);
+        return *this;
+    }
+
+    FixedString &operator=(const char *value) {
+        assign(std::string_view(value));
+        return *this;
+    }
+
+    bool assign(std::string_view value) {
+        size_t size = value.size();
+        bool fits = size <= N;
+        if (!fits) {
+            size = N;
+            // value[size] continuing a character means the one before it does not fit whole
+            while (size && ((uint8_t) value[size] & 0xc0) == 0x80) {
+                size--;
+            }
+        }
+        memcpy(_data, value.data(), size);
+        _data[size] = 0;
+        _size = (uint8_t) size;
+        return fits;
+    }
+
+    void clear() {
+        _size = 0;
+        _data[0] = 0;
+    }
+
+    [[nodiscard]] const char *c_str() const {
+        return _data;
+    }
+
+    [[nodiscard]] const char *data() const {
+        return _data;
+    }
+
+    [[nodiscard]] size_t size() const {
+        return _size;
+    }
+
+    [[nodiscard]] bool empty() const {
+        return !_size;
+    }
+
+    [[nodiscard]] std::string_view view() const {
+        return {_data, _size};
+    }
+
+    operator std::string_view() const {
+        return view();
+    }
+
+    bool operator==(std::string_view other) const {
+        return view() == other;
+    }
+
+    bool operator!=(std::string_view other) const {
+        return view() != other;
+    }
+};
+
+static_assert(std::is_trivially_copyable_v<FixedString<15>>, "copies must stay a memcpy");
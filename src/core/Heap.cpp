@@ -0,0 +1,158 @@
+#include "Heap.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include <esp_heap_caps.h>
+#include <cJSON.h>
+
+const char *heap::tagName(HeapTag tag) {
+    switch (tag) {
+        case Heap_Bus:
+            return "bus";
+        case Heap_Timer:
+            return "timer";
+        case Heap_Props:
+            return "props";
+        case Heap_Mqtt:
+            return "mqtt";
+        case Heap_User:
+            return "user";
+        case Heap_File:
+            return "file";
+        default:
+            return "other";
+    }
+}
+
+HeapInfo heap::info() {
+    HeapInfo info;
+    info.freeBytes = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    info.minFreeBytes = heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+    info.largestFreeBlock = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+    if (info.freeBytes) {
+        info.fragmentation = 100 - (uint8_t) ((uint64_t) info.largestFreeBlock * 100 / info.freeBytes);
+    }
+    return info;
+}
+
+#ifdef CORE_HEAP_TRACE
+
+namespace {
+    struct TagCounters {
+        std::atomic<uint32_t> liveBytes{0};
+        std::atomic<uint32_t> peakBytes{0};
+        std::atomic<uint32_t> allocs{0};
+        std::atomic<uint32_t> frees{0};
+        std::atomic<uint32_t> allocBytes{0};
+    };
+
+    TagCounters counters[Heap_Tag_Max];
+
+    thread_local HeapTag currentTag = Heap_Other;
+
+    struct Header {
+        uint32_t size;
+        uint32_t tag;
+    };
+
+    // keep the payload aligned the way operator new promises
+    constexpr size_t HeaderSize = sizeof(Header) > __STDCPP_DEFAULT_NEW_ALIGNMENT__ ? sizeof(Header) : __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+
+    void *tracedAlloc(size_t size) {
+        auto *header = static_cast<Header *>(malloc(size + HeaderSize));
+        if (!header) {
+            return nullptr;
+        }
+        header->size = size;
+        header->tag = currentTag;
+
+        auto &tag = counters[currentTag];
+        tag.allocs.fetch_add(1, std::memory_order_relaxed);
+        tag.allocBytes.fetch_add(size, std::memory_order_relaxed);
+        uint32_t live = tag.liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+        uint32_t peak = tag.peakBytes.load(std::memory_order_relaxed);
+        while (live > peak && !tag.peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+        }
+
+        return reinterpret_cast<uint8_t *>(header) + HeaderSize;
+    }
+
+    void tracedFree(void *ptr) {
+        if (!ptr) {
+            return;
+        }
+        auto *header = reinterpret_cast<Header *>(static_cast<uint8_t *>(ptr) - HeaderSize);
+        auto &tag = counters[header->tag < Heap_Tag_Max ? header->tag : Heap_Other];
+        tag.frees.fetch_add(1, std::memory_order_relaxed);
+        tag.liveBytes.fetch_sub(header->size, std::memory_order_relaxed);
+        free(header);
+    }
+}
+
+HeapScope::HeapScope(HeapTag tag) : _prev(currentTag) {
+    currentTag = tag;
+}
+
+HeapScope::~HeapScope() {
+    currentTag = _prev;
+}
+
+HeapTagStats heap::stats(HeapTag tag) {
+    auto &counter = counters[tag < Heap_Tag_Max ? tag : Heap_Other];
+    return HeapTagStats{
+            counter.liveBytes.load(std::memory_order_relaxed),
+            counter.peakBytes.load(std::memory_order_relaxed),
+            counter.allocs.load(std::memory_order_relaxed),
+            counter.frees.load(std::memory_order_relaxed),
+            counter.allocBytes.load(std::memory_order_relaxed),
+    };
+}
+
+HeapTagStats heap::total() {
+    HeapTagStats result;
+    for (uint8_t tag = 0; tag < Heap_Tag_Max; tag++) {
+        auto stats = heap::stats((HeapTag) tag);
+        result.liveBytes += stats.liveBytes;
+        result.peakBytes += stats.peakBytes;
+        result.allocs += stats.allocs;
+        result.frees += stats.frees;
+        result.allocBytes += stats.allocBytes;
+    }
+    return result;
+}
+
+void heap::begin() {
+    cJSON_Hooks hooks{tracedAlloc, tracedFree};
+    cJSON_InitHooks(&hooks);
+}
+
+void *operator new(size_t size) {
+    if (void *ptr = tracedAlloc(size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept {
+    tracedFree(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+    tracedFree(ptr);
+}
+
+#else
+
+HeapTagStats heap::stats(HeapTag) {
+    return {};
+}
+
+HeapTagStats heap::total() {
+    return {};
+}
+
+void heap::begin() {}
+
+#endif
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * Allocation accounting per subsystem. Build with -DCORE_HEAP_TRACE to replace the global
+ * operator new/delete (and cJSON hooks) with tagged versions; without it HeapScope is an empty
+ * object and nothing is counted.
+ */
+enum HeapTag : uint8_t {
+    Heap_Other,
+    Heap_Bus,
+    Heap_Timer,
+    Heap_Props,
+    Heap_Mqtt,
+    Heap_User,
+    Heap_File,
+    Heap_Tag_Max,
+};
+
+struct HeapTagStats {
+    uint32_t liveBytes{0};
+    uint32_t peakBytes{0};
+    uint32_t allocs{0};
+    uint32_t frees{0};
+    // cumulative, live bytes only ever go down by frees
+    uint32_t allocBytes{0};
+};
+
+struct HeapInfo {
+    uint32_t freeBytes{0};
+    uint32_t minFreeBytes{0};
+    uint32_t largestFreeBlock{0};
+    // 0 - one contiguous free block, 100 - free memory is all crumbs
+    uint8_t fragmentation{0};
+};
+
+namespace heap {
+    const char *tagName(HeapTag tag);
+
+    [[nodiscard]] HeapTagStats stats(HeapTag tag);
+
+    [[nodiscard]] HeapTagStats total();
+
+    [[nodiscard]] HeapInfo info();
+
+    /**
+     * Route cJSON allocations through the tagged allocator, call before the first cJSON use.
+     */
+    void begin();
+}
+
+#ifdef CORE_HEAP_TRACE
+
+class HeapScope {
+    HeapTag _prev;
+public:
+    explicit HeapScope(HeapTag tag);
+
+    HeapScope(const HeapScope &) = delete;
+
+    HeapScope &operator=(const HeapScope &) = delete;
+
+    ~HeapScope();
+};
+
+#else
+
+class HeapScope {
+public:
+    explicit HeapScope(HeapTag) {}
+};
+
+#endif
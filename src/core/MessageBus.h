@@ -4,22 +4,35 @@
 
 #pragma once
 
+#include <esp_attr.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/queue.h>
+#include <freertos/semphr.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
 #include <set>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 #include <string>
 #include <memory>
+#include <new>
+#include <type_traits>
 
 #include "Logger.h"
+#include "Heap.h"
+#include "Rcu.h"
 #include "Timer.h"
 
 typedef uint16_t MsgId;
 
 typedef uint8_t SubMsgId;
 
+typedef uint16_t CorrelationId;
+
 enum class System {
     Sys_Bus,
     Sys_Core,
@@ -34,6 +47,22 @@ public:
 
     [[nodiscard]] virtual MsgId getMsgId() const = 0;
 
+    /**
+     * Conflated messages are latest-value: while one is still queued, posting another one
+     * with the same id and key replaces it in place instead of taking a new queue slot.
+     */
+    [[nodiscard]] virtual bool isConflated() const {
+        return false;
+    }
+
+    [[nodiscard]] virtual uint32_t getKey() const {
+        return 0;
+    }
+
+    [[nodiscard]] virtual CorrelationId getCorrelationId() const {
+        return 0;
+    }
+
     virtual ~Message() = default;
 };
 
@@ -49,25 +78,221 @@ public:
     }
 };
 
+/**
+ * Request and reply messages: MessageBus::request() stamps the request with a correlation id,
+ * the responder hands it back with MessageBus::reply() and the reply goes straight to the
+ * waiting caller instead of being broadcast.
+ */
+template<SubMsgId subMsgId, System systemId = System::Sys_User>
+struct TCorrelatedMessage : TMessage<subMsgId, systemId> {
+    CorrelationId correlationId{0};
+
+    [[nodiscard]] CorrelationId getCorrelationId() const override {
+        return correlationId;
+    }
+};
+
+template<SubMsgId subMsgId, System systemId = System::Sys_User>
+using TRequest = TCorrelatedMessage<subMsgId, systemId>;
+
+template<SubMsgId subMsgId, System systemId = System::Sys_User>
+using TReply = TCorrelatedMessage<subMsgId, systemId>;
+
+/**
+ * Callable stored inline in a pending-request slot, called with the reply or nullptr on timeout.
+ * Captures are limited to Capacity bytes so waiting for a reply never touches the heap.
+ */
+class ReplyHandler {
+public:
+    static constexpr size_t Capacity = 4 * sizeof(void *);
+private:
+    alignas(std::max_align_t) uint8_t _storage[Capacity]{};
+
+    void (*_invoke)(void *storage, const Message *reply){nullptr};
+
+    void (*_relocate)(void *from, void *to){nullptr};
+public:
+    ReplyHandler() = default;
+
+    ReplyHandler(const ReplyHandler &) = delete;
+
+    ReplyHandler &operator=(const ReplyHandler &) = delete;
+
+    template<typename F>
+    void assign(F &&callback) {
+        typedef std::decay_t<F> Fn;
+        static_assert(sizeof(Fn) <= Capacity, "reply callback captures too much, capture a pointer instead");
+        static_assert(alignof(Fn) <= alignof(std::max_align_t), "over-aligned reply callback");
+
+        reset();
+        new(_storage) Fn(std::forward<F>(callback));
+        _invoke = [](void *storage, const Message *reply) {
+            (*static_cast<Fn *>(storage))(reply);
+        };
+        _relocate = [](void *from, void *to) {
+            auto *fn = static_cast<Fn *>(from);
+            if (to) {
+                new(to) Fn(std::move(*fn));
+            }
+            fn->~Fn();
+        };
+    }
+
+    void moveTo(ReplyHandler &other) {
+        other.reset();
+        if (_relocate) {
+            _relocate(_storage, other._storage);
+            other._invoke = _invoke;
+            other._relocate = _relocate;
+            _invoke = nullptr;
+            _relocate = nullptr;
+        }
+    }
+
+    void operator()(const Message *reply) {
+        if (_invoke) {
+            _invoke(_storage, reply);
+        }
+    }
+
+    void reset() {
+        if (_relocate) {
+            _relocate(_storage, nullptr);
+        }
+        _invoke = nullptr;
+        _relocate = nullptr;
+    }
+
+    ~ReplyHandler() {
+        reset();
+    }
+};
+
+/**
+ * Blocking side of MessageBus::request(): wait() returns once the reply arrived (true) or the
+ * request expired (false). Never wait on the bus task itself, it is the one delivering.
+ */
+template<typename Rep>
+class ReplyFuture {
+    StaticSemaphore_t _buffer{};
+    SemaphoreHandle_t _done;
+
+    Rep _reply{};
+    bool _replied{false};
+public:
+    ReplyFuture() : _done(xSemaphoreCreateBinaryStatic(&_buffer)) {}
+
+    ReplyFuture(const ReplyFuture &) = delete;
+
+    void complete(const Rep *reply) {
+        if (reply) {
+            _reply = *reply;
+            _replied = true;
+        }
+        xSemaphoreGive(_done);
+    }
+
+    bool wait() {
+        xSemaphoreTake(_done, portMAX_DELAY);
+        return _replied;
+    }
+
+    [[nodiscard]] const Rep &get() const {
+        return _reply;
+    }
+
+    ~ReplyFuture() {
+        vSemaphoreDelete(_done);
+    }
+};
+
+/**
+ * FNV-1a, used as Message::getKey() for string keyed messages (e.g. MQTT topics).
+ */
+constexpr uint32_t messageKey(std::string_view value) {
+    uint32_t hash = 2166136261u;
+    for (char ch: value) {
+        hash = (hash ^ (uint8_t) ch) * 16777619u;
+    }
+    return hash;
+}
+
 template<typename C, typename... T>
 std::unique_ptr<Message> makeMsg(T &&... all) {
     auto *ptr = new C{std::forward<T>(all)...};
     return std::unique_ptr<C>(ptr);
 }
 
+/**
+ * What a post does when the bus queue is full.
+ */
+enum OverflowPolicy : uint8_t {
+    // wait up to the block timeout, then drop the new message
+    Overflow_Block,
+    Overflow_DropNewest,
+    // make room by dropping the oldest queued message
+    Overflow_DropOldest,
+    // park the message in the bus spill buffer, it is queued as the bus drains
+    Overflow_Spill,
+};
+
+enum PostStatus : uint8_t {
+    Post_Queued,
+    // queued after dropping the oldest message
+    Post_Evicted,
+    Post_Spilled,
+    Post_Dropped,
+};
+
 class MessageProducer {
 public:
     virtual void sendMessage(const Message &msg) = 0;
-    virtual void postMessage(Message::Ptr &msg) = 0;
+    virtual PostStatus postMessage(Message::Ptr &msg) = 0;
+    template<typename T>
+    PostStatus postMessage(const T& msg) {
+        HeapScope scope(Heap_Bus);
+        std::unique_ptr<Message> ptr(new T(msg));
+        return postMessage(ptr);
+    }
+
+    /**
+     * postMessage() that never waits for room: a full queue applies the type's policy at once,
+     * Overflow_Block drops. For the timer daemon, network tasks and the bus task itself, which
+     * must not stall behind a slow consumer.
+     */
+    virtual PostStatus tryPostMessage(Message::Ptr &msg) = 0;
     template<typename T>
-    void postMessage(const T& msg) {
+    PostStatus tryPostMessage(const T& msg) {
+        HeapScope scope(Heap_Bus);
         std::unique_ptr<Message> ptr(new T(msg));
-        postMessage(ptr);
+        return tryPostMessage(ptr);
     }
 
-    virtual void postMessageISR(Message::Ptr &msg) = 0;
+    /**
+     * Queues an already allocated message from an ISR, msg keeps it when it is dropped: it can
+     * not be freed in an interrupt.
+     */
+    virtual PostStatus postMessageISR(Message::Ptr &msg) = 0;
+
+    /**
+     * Constructs T in a preallocated ISR slot and queues it without touching the heap, safe to
+     * call from an interrupt handler as long as the T constructor does not allocate either.
+     * Returns false when no slot is free, T does not fit or the queue is full.
+     */
+    template<typename T, typename... Args>
+    bool postFromISR(Args&&... args) {
+        void *slot = acquireISRSlot(sizeof(T), alignof(T));
+        if (!slot) {
+            return false;
+        }
+        return postISRSlot(new(slot) T{std::forward<Args>(args)...});
+    }
+
+    virtual void *acquireISRSlot(size_t size, size_t align) = 0;
+    virtual bool postISRSlot(Message *msg) = 0;
     template<typename T>
     void scheduleMessage(uint32_t delay, T& msg) {
+        HeapScope scope(Heap_Bus);
         std::unique_ptr<Message> ptr(new T(msg));
         scheduleMessage(delay, ptr);
     }
@@ -78,12 +303,27 @@ public:
 class MessageSubscriber {
 public:
     virtual void onMessage(const Message &msg) = 0;
+
+    virtual ~MessageSubscriber() = default;
 };
 
+/**
+ * Copies a retained message of the type it was registered for.
+ */
+typedef Message *(*RetainedCopy)(const Message &msg);
+
+/**
+ * dispatch() is the non-virtual entry, TStaticRegistry calls it directly so the handlers can be
+ * inlined into the bus loop.
+ */
 template<typename T, typename Msg1 = void, typename Msg2 = void, typename Msg3 = void, typename Msg4 = void>
 class TMessageSubscriber : public MessageSubscriber {
 public:
     void onMessage(const Message &msg) override {
+        dispatch(msg);
+    }
+
+    void dispatch(const Message &msg) {
         switch (msg.getMsgId()) {
             case Msg1::ID:
                 static_cast<T *>(this)->onMessage(static_cast<const Msg1 &>(msg));
@@ -107,6 +347,10 @@ template<typename T, typename Msg1, typename Msg2, typename Msg3>
 class TMessageSubscriber<T, Msg1, Msg2, Msg3, void> : public MessageSubscriber {
 public:
     void onMessage(const Message &msg) override {
+        dispatch(msg);
+    }
+
+    void dispatch(const Message &msg) {
         switch (msg.getMsgId()) {
             case Msg1::ID:
                 static_cast<T *>(this)->onMessage(static_cast<const Msg1 &>(msg));
@@ -127,6 +371,10 @@ template<typename T, typename Msg1, typename Msg2>
 class TMessageSubscriber<T, Msg1, Msg2, void, void> : public MessageSubscriber {
 public:
     void onMessage(const Message &msg) override {
+        dispatch(msg);
+    }
+
+    void dispatch(const Message &msg) {
         switch (msg.getMsgId()) {
             case Msg1::ID:
                 static_cast<T *>(this)->onMessage(static_cast<const Msg1 &>(msg));
@@ -144,6 +392,10 @@ template<typename T, typename Msg1>
 class TMessageSubscriber<T, Msg1, void, void, void> : public MessageSubscriber {
 public:
     void onMessage(const Message &msg) override {
+        dispatch(msg);
+    }
+
+    void dispatch(const Message &msg) {
         switch (msg.getMsgId()) {
             case Msg1::ID:
                 static_cast<T *>(this)->onMessage(static_cast<const Msg1 &>(msg));
@@ -167,81 +419,1118 @@ public:
     }
 };
 
+/**
+ * Handler behind a predicate, registered in the bus type index so the predicate only runs for
+ * messages of type Msg.
+ */
+template<typename Msg>
+class TMessageFilterSubscriber : public MessageSubscriber {
+    std::function<bool(const Msg& msg)> _filter;
+    std::function<void(const Msg& msg)> _callback;
+public:
+    TMessageFilterSubscriber(const std::function<bool(const Msg& msg)>& filter, const std::function<void(const Msg& msg)>& callback)
+            : _filter(filter), _callback(callback) {}
+
+    void onMessage(const Message &msg) override {
+        auto &typed = static_cast<const Msg &>(msg);
+        if (_filter(typed)) {
+            _callback(typed);
+        }
+    }
+};
+
 class MessageBus : public MessageSubscriber, public MessageProducer {
 public:
+    static constexpr uint32_t BlockForever = UINT32_MAX;
+
     virtual void subscribe(MessageSubscriber *subscriber) = 0;
 
+    /**
+     * Subscriber only sees messages of type id, looked up by id before dispatch.
+     */
+    virtual void subscribe(MsgId id, MessageSubscriber *subscriber) = 0;
+
+    /**
+     * Subscriber only sees messages of type id whose getKey() equals key, found with a single
+     * hash lookup per message. Keys are hashes for string fields, so collisions are possible.
+     */
+    virtual void subscribe(MsgId id, uint32_t key, MessageSubscriber *subscriber) = 0;
+
+    /**
+     * Removes subscriber from every table, from any task or from inside a handler. A dispatch
+     * already running may still deliver to it once; a subscriber created by the callback
+     * overloads below is freed by the bus after that.
+     */
+    virtual void unsubscribe(MessageSubscriber *subscriber) = 0;
+
+    /**
+     * The callback overloads return the subscriber they created, it is the unsubscribe() handle.
+     */
+    template<typename T>
+    MessageSubscriber *subscribe(const std::function<void(const T& msg)> callback) {
+        HeapScope scope(Heap_Bus);
+        auto *subscriber = new TMessageFuncSubscriber<T>(callback);
+        adopt(subscriber);
+        subscribe(subscriber);
+        return subscriber;
+    }
+
+    template<typename T>
+    MessageSubscriber *subscribe(uint32_t key, const std::function<void(const T& msg)> callback) {
+        HeapScope scope(Heap_Bus);
+        auto *subscriber = new TMessageFuncSubscriber<T>(callback);
+        adopt(subscriber);
+        subscribe(T::ID, key, subscriber);
+        return subscriber;
+    }
+
+    template<typename T>
+    MessageSubscriber *subscribe(const std::function<bool(const T& msg)> filter, const std::function<void(const T& msg)> callback) {
+        HeapScope scope(Heap_Bus);
+        auto *subscriber = new TMessageFilterSubscriber<T>(filter, callback);
+        adopt(subscriber);
+        subscribe(T::ID, subscriber);
+        return subscriber;
+    }
+
+    /**
+     * Keeps the newest dispatched T (last-value state such as WifiConnected) until the next one
+     * replaces it. Subscribers added later get it replayed on the bus task, as if it had just been
+     * dispatched, several retained types in the order they were dispatched; a subscriber racing a
+     * new one from another task may see the same value twice.
+     * False when every retained slot is taken.
+     */
     template<typename T>
-    void subscribe(const std::function<void(const T& msg)> callback) {
-        subscribe(new TMessageFuncSubscriber<T>(callback));
+    bool retain() {
+        return retain(T::ID, [](const Message &msg) -> Message * {
+            return new T(static_cast<const T &>(msg));
+        });
     }
 
+    virtual bool retain(MsgId id, RetainedCopy copy) = 0;
+
+    /**
+     * The newest retained T, empty before the first one. Safe from any task, the snapshot stays
+     * valid after a newer one replaces it.
+     */
+    template<typename T>
+    std::shared_ptr<const T> getRetained(uint32_t *version = nullptr) {
+        return std::static_pointer_cast<const T>(getRetained(T::ID, version));
+    }
+
+    virtual std::shared_ptr<const Message> getRetained(MsgId id, uint32_t *version) = 0;
+
+    /**
+     * 0 before the first retained T. Versions count every retained update on the bus, so the
+     * higher of two (MqttConnected, MqttDisconnected) is the later one.
+     */
+    template<typename T>
+    uint32_t getRetainedVersion() {
+        return getRetainedVersion(T::ID);
+    }
+
+    virtual uint32_t getRetainedVersion(MsgId id) = 0;
+
+    /**
+     * Reserves a pending-request slot for a reply of type replyId, the handler is moved into it.
+     * Returns 0 when all slots are busy.
+     */
+    virtual CorrelationId expectReply(MsgId replyId, uint32_t timeout, ReplyHandler &handler) = 0;
+
+    /**
+     * Frees the slot of a request that never went out, its handler is not called. Does nothing
+     * once the reply or the timeout got to it first.
+     */
+    virtual void cancelReply(CorrelationId id) = 0;
+
+    /**
+     * Posts a copy of req and calls callback(const Rep*) on the bus task with the reply, or with
+     * nullptr once timeout ms passed. Returns false when no slot is free or the bus dropped the
+     * request, the callback is not called then.
+     */
+    template<typename Rep, typename Req, typename F>
+    bool request(const Req &req, uint32_t timeout, F &&callback) {
+        ReplyHandler handler;
+        handler.assign([callback = std::forward<F>(callback)](const Message *reply) {
+            callback(static_cast<const Rep *>(reply));
+        });
+
+        auto id = expectReply(Rep::ID, timeout, handler);
+        if (!id) {
+            return false;
+        }
+
+        HeapScope scope(Heap_Bus);
+        auto *ptr = new Req(req);
+        ptr->correlationId = id;
+        Message::Ptr msg(ptr);
+        if (postMessage(msg) == Post_Dropped) {
+            cancelReply(id);
+            return false;
+        }
+        return true;
+    }
+
+    template<typename Rep, typename Req>
+    bool request(const Req &req, uint32_t timeout, ReplyFuture<Rep> &future) {
+        return request<Rep>(req, timeout, [&future](const Rep *reply) {
+            future.complete(reply);
+        });
+    }
+
+    template<typename Rep>
+    void reply(const Message &req, const Rep &rep) {
+        HeapScope scope(Heap_Bus);
+        auto *ptr = new Rep(rep);
+        ptr->correlationId = req.getCorrelationId();
+        Message::Ptr msg(ptr);
+        postMessage(msg);
+    }
+
+    /**
+     * What a post of type id does when the queue is full, overriding the bus default. False when
+     * the table of per type rules is full.
+     */
+    virtual bool setOverflowPolicy(MsgId id, OverflowPolicy policy, uint32_t blockMs = BlockForever) = 0;
+
     virtual void loop() = 0;
+
+protected:
+    /**
+     * The bus owns subscriber from now on, it is deleted on unsubscribe() or with the bus.
+     */
+    virtual void adopt(MessageSubscriber *subscriber) = 0;
 };
 
-template<size_t queueSize = 10>
+/**
+ * Queue, clock and timers of a TMessageBus on FreeRTOS. core/sim/SimBus.h has the virtual time
+ * counterpart, a backend only has to provide the same members.
+ */
+class RtosBusBackend {
+protected:
+    QueueHandle_t _queue{};
+public:
+    // loop() returns after a full idle wait on the queue
+    static constexpr bool Simulated = false;
+
+    void create(size_t length) {
+        _queue = xQueueCreate(length, sizeof(void *));
+    }
+
+    explicit operator bool() const {
+        return _queue != nullptr;
+    }
+
+    bool send(void *item, TickType_t wait) {
+        return pdPASS == xQueueSendToBack(_queue, &item, wait);
+    }
+
+    IRAM_ATTR bool sendFromISR(void *item, BaseType_t *woken) {
+        return pdPASS == xQueueSendFromISR(_queue, &item, woken);
+    }
+
+    bool receive(void *&item, TickType_t wait) {
+        return pdPASS == xQueueReceive(_queue, &item, wait);
+    }
+
+    static TickType_t now() {
+        return xTaskGetTickCount();
+    }
+
+    static Timer *createTimer() {
+        return new SoftwareTimer();
+    }
+
+    ~RtosBusBackend() {
+        if (_queue) {
+            vQueueDelete(_queue);
+        }
+    }
+};
+
+/**
+ * RtosBusBackend with the queue storage inside the bus object, creating it does not touch the
+ * heap. length caps the queue, a bigger queueSize is clamped to it.
+ */
+template<size_t length>
+class StaticRtosBusBackend : public RtosBusBackend {
+    StaticQueue_t _control{};
+    uint8_t _storage[length * sizeof(void *)]{};
+public:
+    void create(size_t size) {
+        _queue = xQueueCreateStatic(std::min(size, length), sizeof(void *), _storage, &_control);
+    }
+};
+
+template<size_t queueSize = 10, size_t conflateSize = 8, size_t pendingSize = 8, size_t isrSlots = 4, size_t isrSlotSize = 64, typename Backend = RtosBusBackend, size_t spillSize = 8>
 class TMessageBus : public MessageBus {
-    QueueHandle_t _queue;
+    static_assert(isrSlots <= 32, "ISR slots are tracked in a 32 bit mask");
+    static_assert(spillSize > 0, "the spill buffer needs at least one slot");
+    Backend _backend;
 
-    std::vector<MessageSubscriber *> _subscribers;
+    // slot is claimed while id != 0, the bus only looks at armed ones
+    struct PendingRequest {
+        CorrelationId id{0};
+        MsgId replyId{0};
+        bool armed{false};
+        TickType_t deadline{0};
+        ReplyHandler handler;
+    };
+
+    PendingRequest _pending[pendingSize];
+    portMUX_TYPE _pendingLock = portMUX_INITIALIZER_UNLOCKED;
+    CorrelationId _lastCorrelationId{0};
+    TickType_t _nextDeadline{0};
+    // read without the lock on the dispatch path, nothing to check while no request is pending
+    std::atomic<bool> _hasDeadline{false};
+
+    // the queue carries a pointer to the slot, the slot holds the newest pending message
+    struct ConflationSlot {
+        MsgId id{0};
+        uint32_t key{0};
+        Message *pending{nullptr};
+    };
+
+    static constexpr TickType_t IdleTicks = 100;
+
+    static TickType_t blockTicks(uint32_t ms) {
+        return ms == BlockForever ? portMAX_DELAY : pdMS_TO_TICKS(ms);
+    }
+
+    ConflationSlot _conflated[conflateSize]{};
+    portMUX_TYPE _conflatedLock = portMUX_INITIALIZER_UNLOCKED;
+    uint32_t _replaced{0};
+
+    // messages posted with postFromISR live here until dispatched, the queue carries the slot address
+    struct alignas(alignof(std::max_align_t)) ISRSlot {
+        uint8_t data[isrSlotSize];
+    };
+
+    ISRSlot _isrSlots[isrSlots];
+    uint32_t _isrFree{isrSlots == 32 ? 0xffffffffu : (1u << isrSlots) - 1};
+    portMUX_TYPE _isrLock = portMUX_INITIALIZER_UNLOCKED;
+    // bumped from ISRs and tasks alike
+    std::atomic<uint32_t> _isrOverflow{0};
+
+    // per type policy and drop counter, an entry is claimed by setOverflowPolicy() or the first drop
+    static constexpr size_t OverflowTypes = 16;
+
+    struct OverflowRule {
+        MsgId id{0};
+        bool ruled{false};
+        OverflowPolicy policy{Overflow_Block};
+        TickType_t wait{portMAX_DELAY};
+        uint32_t dropped{0};
+    };
+
+    OverflowRule _rules[OverflowTypes]{};
+    size_t _ruleCount{0};
+    OverflowRule _default;
+    uint32_t _dropped{0};
+    portMUX_TYPE _overflowLock = portMUX_INITIALIZER_UNLOCKED;
+
+    // queue items waiting for room, FIFO, filled by producers and drained by the bus task
+    void *_spill[spillSize]{};
+    size_t _spillHead{0};
+    size_t _spillCount{0};
+    portMUX_TYPE _spillLock = portMUX_INITIALIZER_UNLOCKED;
+
+    typedef std::vector<MessageSubscriber *> SubscriberArray;
+
+    // one immutable version per change, dispatch reads it without a lock
+    struct SubscriberTables {
+        SubscriberArray all;
+        std::unordered_map<MsgId, SubscriberArray> typed;
+        std::unordered_map<uint64_t, SubscriberArray> keyed;
+        // created by the callback subscribe() overloads
+        SubscriberArray owned;
+    };
+
+    RcuCell<SubscriberTables> _tables;
+
+    static uint64_t indexKey(MsgId id, uint32_t key) {
+        return ((uint64_t) id << 32) | key;
+    }
+
+    static bool erase(SubscriberArray &array, MessageSubscriber *subscriber) {
+        auto it = std::remove(array.begin(), array.end(), subscriber);
+        bool found = it != array.end();
+        array.erase(it, array.end());
+        return found;
+    }
+
+    template<typename Index>
+    static void eraseFrom(Index &index, MessageSubscriber *subscriber) {
+        for (auto it = index.begin(); it != index.end();) {
+            erase(it->second, subscriber);
+            it = it->second.empty() ? index.erase(it) : std::next(it);
+        }
+    }
 
     struct TimerBusMessage : TMessage<0, System::Sys_Bus> {
         std::function<void()> callback;
     };
 
+    // latest copy of each retained type, a slot is claimed by retain() and kept for good
+    static constexpr size_t RetainedTypes = 8;
+
+    struct RetainedSlot {
+        MsgId id{0};
+        RetainedCopy copy{nullptr};
+        uint32_t version{0};
+        std::shared_ptr<const Message> value;
+    };
+
+    RetainedSlot _retained[RetainedTypes];
+    // slots below it are claimed, their id and copy never change again
+    std::atomic<size_t> _retainedCount{0};
+    uint32_t _retainedVersion{0};
+    portMUX_TYPE _retainedLock = portMUX_INITIALIZER_UNLOCKED;
+
+    enum ReplayMatch : uint8_t {
+        Replay_All,
+        Replay_Type,
+        Replay_Key,
+    };
+
+    // retained values stored up to version upTo, for a subscriber that came after them
+    struct RetainedReplay : TMessage<1, System::Sys_Bus> {
+        MessageSubscriber *subscriber{nullptr};
+        ReplayMatch match{Replay_All};
+        MsgId id{0};
+        uint32_t key{0};
+        uint32_t upTo{0};
+    };
+
 public:
-    TMessageBus() {
-        _queue = xQueueCreate(queueSize, sizeof(void *));
-        _subscribers.emplace_back(new TMessageFuncSubscriber<TimerBusMessage>([this](const TimerBusMessage& msg) {
-            msg.callback();
-        }));
+    template<typename... Args>
+    explicit TMessageBus(Args &&... args) : _backend(std::forward<Args>(args)...) {
+        HeapScope scope(Heap_Bus);
+        _backend.create(queueSize);
     }
 
     void subscribe(MessageSubscriber *subscriber) override {
-        _subscribers.emplace_back(subscriber);
+        HeapScope scope(Heap_Bus);
+        _tables.update([subscriber](SubscriberTables &tables) {
+            tables.all.emplace_back(subscriber);
+        });
+        scheduleReplay(subscriber, Replay_All, 0, 0);
+    }
+
+    void subscribe(MsgId id, MessageSubscriber *subscriber) override {
+        HeapScope scope(Heap_Bus);
+        _tables.update([id, subscriber](SubscriberTables &tables) {
+            tables.typed[id].emplace_back(subscriber);
+        });
+        scheduleReplay(subscriber, Replay_Type, id, 0);
+    }
+
+    void subscribe(MsgId id, uint32_t key, MessageSubscriber *subscriber) override {
+        HeapScope scope(Heap_Bus);
+        _tables.update([id, key, subscriber](SubscriberTables &tables) {
+            tables.keyed[indexKey(id, key)].emplace_back(subscriber);
+        });
+        scheduleReplay(subscriber, Replay_Key, id, key);
+    }
+
+    void unsubscribe(MessageSubscriber *subscriber) override {
+        HeapScope scope(Heap_Bus);
+        bool owned = false;
+        _tables.update([subscriber, &owned](SubscriberTables &tables) {
+            erase(tables.all, subscriber);
+            eraseFrom(tables.typed, subscriber);
+            eraseFrom(tables.keyed, subscriber);
+            owned = erase(tables.owned, subscriber);
+        });
+        if (owned) {
+            _tables.retire(subscriber);
+        }
     }
 
     void onMessage(const Message &msg) override {
-        for (const auto sub: _subscribers) {
-            sub->onMessage(msg);
+        // bus timers, handled here so an idle bus owns no subscribers
+        if (msg.getMsgId() == TimerBusMessage::ID) {
+            static_cast<const TimerBusMessage &>(msg).callback();
+        } else if (msg.getMsgId() == RetainedReplay::ID) {
+            replay(static_cast<const RetainedReplay &>(msg));
+            _tables.reclaim();
+            return;
+        }
+        if (_retainedCount.load(std::memory_order_acquire)) {
+            store(msg);
+        }
+        {
+            typename RcuCell<SubscriberTables>::ReadGuard tables(_tables);
+            for (const auto sub: tables->all) {
+                sub->onMessage(msg);
+            }
+            if (!tables->typed.empty()) {
+                if (auto it = tables->typed.find(msg.getMsgId()); it != tables->typed.end()) {
+                    for (const auto sub: it->second) {
+                        sub->onMessage(msg);
+                    }
+                }
+            }
+            if (!tables->keyed.empty()) {
+                if (auto it = tables->keyed.find(indexKey(msg.getMsgId(), msg.getKey())); it != tables->keyed.end()) {
+                    for (const auto sub: it->second) {
+                        sub->onMessage(msg);
+                    }
+                }
+            }
         }
+        // versions replaced while the handlers ran
+        _tables.reclaim();
     }
 
-    void loop() override {
-        if (_queue) {
-            Message *msg = nullptr;
-            while (pdPASS == xQueueReceive(_queue, &msg, 100)) {
-                sendMessage(*msg);
+    bool retain(MsgId id, RetainedCopy copy) override {
+        bool claimed = true;
+        portENTER_CRITICAL(&_retainedLock);
+        auto count = _retainedCount.load(std::memory_order_relaxed);
+        if (!findRetained(id)) {
+            if (count < RetainedTypes) {
+                _retained[count].id = id;
+                _retained[count].copy = copy;
+                _retainedCount.store(count + 1, std::memory_order_release);
+            } else {
+                claimed = false;
+            }
+        }
+        portEXIT_CRITICAL(&_retainedLock);
+        return claimed;
+    }
+
+    std::shared_ptr<const Message> getRetained(MsgId id, uint32_t *version) override {
+        std::shared_ptr<const Message> value;
+        uint32_t stored = 0;
+        if (auto *slot = findRetained(id)) {
+            portENTER_CRITICAL(&_retainedLock);
+            value = slot->value;
+            stored = slot->version;
+            portEXIT_CRITICAL(&_retainedLock);
+        }
+        if (version) {
+            *version = stored;
+        }
+        return value;
+    }
+
+    uint32_t getRetainedVersion(MsgId id) override {
+        uint32_t version = 0;
+        if (auto *slot = findRetained(id)) {
+            portENTER_CRITICAL(&_retainedLock);
+            version = slot->version;
+            portEXIT_CRITICAL(&_retainedLock);
+        }
+        return version;
+    }
+
+protected:
+    void adopt(MessageSubscriber *subscriber) override {
+        HeapScope scope(Heap_Bus);
+        _tables.update([subscriber](SubscriberTables &tables) {
+            tables.owned.emplace_back(subscriber);
+        });
+    }
+
+private:
+    RetainedSlot *findRetained(MsgId id) {
+        auto count = _retainedCount.load(std::memory_order_acquire);
+        for (size_t idx = 0; idx < count; idx++) {
+            if (_retained[idx].id == id) {
+                return &_retained[idx];
+            }
+        }
+        return nullptr;
+    }
+
+    void store(const Message &msg) {
+        auto *slot = findRetained(msg.getMsgId());
+        if (!slot) {
+            return;
+        }
+        HeapScope scope(Heap_Bus);
+        std::shared_ptr<const Message> value(slot->copy(msg));
+        portENTER_CRITICAL(&_retainedLock);
+        slot->value.swap(value);
+        slot->version = ++_retainedVersion;
+        portEXIT_CRITICAL(&_retainedLock);
+        // value is the replaced copy now, freed outside the lock
+    }
+
+    void scheduleReplay(MessageSubscriber *subscriber, ReplayMatch match, MsgId id, uint32_t key) {
+        if (!_retainedCount.load(std::memory_order_acquire)) {
+            return;
+        }
+        bool stored = false;
+        uint32_t upTo;
+        portENTER_CRITICAL(&_retainedLock);
+        upTo = _retainedVersion;
+        auto count = _retainedCount.load(std::memory_order_relaxed);
+        for (size_t idx = 0; idx < count; idx++) {
+            if (_retained[idx].version && (match == Replay_All || _retained[idx].id == id)) {
+                stored = true;
+            }
+        }
+        portEXIT_CRITICAL(&_retainedLock);
+        if (!stored) {
+            return;
+        }
+
+        HeapScope scope(Heap_Bus);
+        auto *msg = new RetainedReplay();
+        msg->subscriber = subscriber;
+        msg->match = match;
+        msg->id = id;
+        msg->key = key;
+        msg->upTo = upTo;
+        // subscribe() may run inside a handler on the bus task, never wait for room
+        if (post(msg, false) == Post_Dropped) {
+            esp_logw(bus, "retained replay dropped, queue full");
+        }
+    }
+
+    void replay(const RetainedReplay &msg) {
+        typename RcuCell<SubscriberTables>::ReadGuard tables(_tables);
+        // gone, or unsubscribed before its turn came
+        auto listed = [&msg](const SubscriberArray &array) {
+            return std::find(array.begin(), array.end(), msg.subscriber) != array.end();
+        };
+        bool subscribed = false;
+        if (msg.match == Replay_All) {
+            subscribed = listed(tables->all);
+        } else if (msg.match == Replay_Type) {
+            auto it = tables->typed.find(msg.id);
+            subscribed = it != tables->typed.end() && listed(it->second);
+        } else {
+            auto it = tables->keyed.find(indexKey(msg.id, msg.key));
+            subscribed = it != tables->keyed.end() && listed(it->second);
+        }
+        if (!subscribed) {
+            return;
+        }
+
+        // in the order they were stored, not retained: of MqttConnected and MqttDisconnected the
+        // later one has to arrive last
+        struct Stored {
+            uint32_t version;
+            std::shared_ptr<const Message> value;
+        };
+        Stored stored[RetainedTypes];
+        size_t found = 0;
+        auto count = _retainedCount.load(std::memory_order_acquire);
+        for (size_t idx = 0; idx < count; idx++) {
+            auto &slot = _retained[idx];
+            if (msg.match != Replay_All && slot.id != msg.id) {
+                continue;
+            }
+            std::shared_ptr<const Message> value;
+            uint32_t version;
+            portENTER_CRITICAL(&_retainedLock);
+            value = slot.value;
+            version = slot.version;
+            portEXIT_CRITICAL(&_retainedLock);
+            // a newer value went through dispatch after the subscriber was in
+            if (!value || version > msg.upTo) {
+                continue;
+            }
+            if (msg.match == Replay_Key && value->getKey() != msg.key) {
+                continue;
+            }
+            size_t pos = found++;
+            for (; pos && stored[pos - 1].version > version; pos--) {
+                stored[pos] = std::move(stored[pos - 1]);
+            }
+            stored[pos] = {version, std::move(value)};
+        }
+        for (size_t idx = 0; idx < found; idx++) {
+            msg.subscriber->onMessage(*stored[idx].value);
+        }
+    }
+
+    bool isISRSlot(const void *item) const {
+        return item >= (const void *) _isrSlots && item < (const void *) (_isrSlots + isrSlots);
+    }
+
+    IRAM_ATTR void releaseISRSlot(const void *slot) {
+        auto bit = 1u << ((const ISRSlot *) slot - _isrSlots);
+        portENTER_CRITICAL_ISR(&_isrLock);
+        _isrFree |= bit;
+        portEXIT_CRITICAL_ISR(&_isrLock);
+    }
+
+    void dispose(Message *msg) {
+        if (!msg) {
+            return;
+        }
+        if (isISRSlot(msg)) {
+            msg->~Message();
+            releaseISRSlot(msg);
+        } else {
+            delete msg;
+        }
+    }
+
+    bool isSlot(void *item) const {
+        return item >= (void *) _conflated && item < (void *) (_conflated + conflateSize);
+    }
+
+    Message *take(void *item) {
+        if (!isSlot(item)) {
+            return static_cast<Message *>(item);
+        }
+
+        auto *slot = static_cast<ConflationSlot *>(item);
+        portENTER_CRITICAL(&_conflatedLock);
+        Message *msg = slot->pending;
+        slot->pending = nullptr;
+        portEXIT_CRITICAL(&_conflatedLock);
+        return msg;
+    }
+
+    /**
+     * True when msg replaced a queued instance. Otherwise item is the slot claimed for msg, or
+     * msg itself when the slot table is full, still to be queued.
+     */
+    bool conflate(Message *msg, void *&item) {
+        auto id = msg->getMsgId();
+        auto key = msg->getKey();
+        ConflationSlot *free = nullptr;
+
+        portENTER_CRITICAL(&_conflatedLock);
+        for (auto &slot: _conflated) {
+            if (slot.pending && slot.id == id && slot.key == key) {
+                std::swap(slot.pending, msg);
+                _replaced++;
+                portEXIT_CRITICAL(&_conflatedLock);
+                // msg is the stale instance now
                 delete msg;
+                return true;
+            }
+            if (!slot.pending && !free) {
+                free = &slot;
+            }
+        }
+        if (free) {
+            free->id = id;
+            free->key = key;
+            free->pending = msg;
+        }
+        portEXIT_CRITICAL(&_conflatedLock);
+
+        item = free ? (void *) free : (void *) msg;
+        return false;
+    }
+
+    IRAM_ATTR OverflowRule ruleFor(MsgId id) {
+        OverflowRule rule = _default;
+        if (!_ruleCount) {
+            return rule;
+        }
+        portENTER_CRITICAL_SAFE(&_overflowLock);
+        for (size_t idx = 0; idx < _ruleCount; idx++) {
+            if (_rules[idx].id == id) {
+                if (_rules[idx].ruled) {
+                    rule = _rules[idx];
+                }
+                break;
             }
         }
+        portEXIT_CRITICAL_SAFE(&_overflowLock);
+        return rule;
+    }
+
+    // call with _overflowLock held, nullptr when the table is full
+    IRAM_ATTR OverflowRule *claimRule(MsgId id) {
+        for (size_t idx = 0; idx < _ruleCount; idx++) {
+            if (_rules[idx].id == id) {
+                return &_rules[idx];
+            }
+        }
+        if (_ruleCount == OverflowTypes) {
+            return nullptr;
+        }
+        auto *rule = &_rules[_ruleCount++];
+        rule->id = id;
+        return rule;
+    }
+
+    IRAM_ATTR void countDrop(MsgId id) {
+        portENTER_CRITICAL_SAFE(&_overflowLock);
+        _dropped++;
+        if (auto *rule = claimRule(id)) {
+            rule->dropped++;
+        }
+        portEXIT_CRITICAL_SAFE(&_overflowLock);
+    }
+
+    IRAM_ATTR bool hasSpill() {
+        portENTER_CRITICAL_SAFE(&_spillLock);
+        bool spilled = _spillCount != 0;
+        portEXIT_CRITICAL_SAFE(&_spillLock);
+        return spilled;
+    }
+
+    IRAM_ATTR bool spill(void *item) {
+        portENTER_CRITICAL_SAFE(&_spillLock);
+        bool room = _spillCount < spillSize;
+        if (room) {
+            _spill[(_spillHead + _spillCount++) % spillSize] = item;
+        }
+        portEXIT_CRITICAL_SAFE(&_spillLock);
+        return room;
+    }
+
+    /**
+     * Moves spilled items into the queue while it has room, only the bus task pops.
+     */
+    void drainSpill() {
+        while (true) {
+            portENTER_CRITICAL(&_spillLock);
+            void *item = _spillCount ? _spill[_spillHead] : nullptr;
+            portEXIT_CRITICAL(&_spillLock);
+            if (!item || !_backend.send(item, 0)) {
+                return;
+            }
+            portENTER_CRITICAL(&_spillLock);
+            _spillHead = (_spillHead + 1) % spillSize;
+            _spillCount--;
+            portEXIT_CRITICAL(&_spillLock);
+        }
+    }
+
+    void evictOldest() {
+        void *item = nullptr;
+        if (_backend.receive(item, 0)) {
+            if (Message *msg = take(item)) {
+                countDrop(msg->getMsgId());
+                dispose(msg);
+            }
+        }
+    }
+
+    /**
+     * Queues item (a message or its conflation slot) under the policy of its type. Posts from
+     * the timer daemon never block, a blocked daemon would stop every timer.
+     */
+    PostStatus enqueue(void *item, MsgId id, bool mayBlock) {
+        auto rule = ruleFor(id);
+        // a non-empty spill buffer keeps the order, new messages queue up behind it
+        if (rule.policy != Overflow_Spill || !hasSpill()) {
+            TickType_t wait = rule.policy == Overflow_Block && mayBlock ? rule.wait : 0;
+            if (_backend.send(item, wait)) {
+                return Post_Queued;
+            }
+        }
+        if (rule.policy == Overflow_DropOldest) {
+            for (size_t tries = 0; tries < queueSize; tries++) {
+                evictOldest();
+                if (_backend.send(item, 0)) {
+                    return Post_Evicted;
+                }
+            }
+        } else if (rule.policy == Overflow_Spill && spill(item)) {
+            return Post_Spilled;
+        }
+
+        countDrop(id);
+        dispose(take(item));
+        return Post_Dropped;
+    }
+
+    PostStatus post(Message *msg, bool mayBlock) {
+        void *item = msg;
+        if (msg->isConflated() && conflate(msg, item)) {
+            return Post_Queued;
+        }
+        return enqueue(item, msg->getMsgId(), mayBlock);
+    }
+
+    /**
+     * No blocking and no evicting from an interrupt, Overflow_Spill is the only policy that
+     * keeps the message once the queue is full.
+     */
+    IRAM_ATTR PostStatus enqueueFromISR(Message *msg) {
+        auto id = msg->getMsgId();
+        auto policy = ruleFor(id).policy;
+        BaseType_t woken = pdFALSE;
+        PostStatus status = Post_Queued;
+        if ((policy == Overflow_Spill && hasSpill()) || !_backend.sendFromISR(msg, &woken)) {
+            if (policy == Overflow_Spill && spill(msg)) {
+                status = Post_Spilled;
+            } else {
+                countDrop(id);
+                _isrOverflow.fetch_add(1, std::memory_order_relaxed);
+                status = Post_Dropped;
+            }
+        }
+        if (woken) {
+            portYIELD_FROM_ISR();
+        }
+        return status;
+    }
+
+    static bool isDue(TickType_t deadline, TickType_t now) {
+        return (int32_t) (deadline - now) <= 0;
+    }
+
+    bool deliverReply(const Message &msg) {
+        auto id = msg.getCorrelationId();
+        if (!id) {
+            return false;
+        }
+
+        PendingRequest *found = nullptr;
+        portENTER_CRITICAL(&_pendingLock);
+        for (auto &slot: _pending) {
+            if (slot.armed && slot.id == id && slot.replyId == msg.getMsgId()) {
+                slot.armed = false;
+                found = &slot;
+                break;
+            }
+        }
+        portEXIT_CRITICAL(&_pendingLock);
+
+        if (!found) {
+            // a request, or a reply nobody waits for anymore
+            return false;
+        }
+
+        found->handler(&msg);
+        release(*found);
+        return true;
+    }
+
+    void release(PendingRequest &slot) {
+        slot.handler.reset();
+        portENTER_CRITICAL(&_pendingLock);
+        slot.id = 0;
+        portEXIT_CRITICAL(&_pendingLock);
+    }
+
+    void expire() {
+        if (!_hasDeadline) {
+            return;
+        }
+        auto now = _backend.now();
+        portENTER_CRITICAL(&_pendingLock);
+        if (!_hasDeadline || !isDue(_nextDeadline, now)) {
+            portEXIT_CRITICAL(&_pendingLock);
+            return;
+        }
+        _hasDeadline = false;
+        for (auto &slot: _pending) {
+            if (!slot.armed) {
+                continue;
+            }
+            if (isDue(slot.deadline, now)) {
+                slot.armed = false;
+                portEXIT_CRITICAL(&_pendingLock);
+                slot.handler(nullptr);
+                release(slot);
+                portENTER_CRITICAL(&_pendingLock);
+            } else if (!_hasDeadline || isDue(slot.deadline, _nextDeadline)) {
+                _nextDeadline = slot.deadline;
+                _hasDeadline = true;
+            }
+        }
+        portEXIT_CRITICAL(&_pendingLock);
+    }
+
+    TickType_t waitTicks() {
+        TickType_t wait = IdleTicks;
+        if (!_hasDeadline) {
+            return wait;
+        }
+        portENTER_CRITICAL(&_pendingLock);
+        if (_hasDeadline) {
+            auto left = (int32_t) (_nextDeadline - _backend.now());
+            wait = left <= 0 ? 0 : std::min<TickType_t>(wait, left);
+        }
+        portEXIT_CRITICAL(&_pendingLock);
+        return wait;
+    }
+
+public:
+    /**
+     * Makes the calling task the one that reads the subscriber tables without atomics and frees
+     * replaced ones. loop() binds the task it runs on; a bus only dispatched through sendMessage()
+     * binds its dispatching task here. Other tasks dispatch as guests either way.
+     */
+    void bindDispatchTask() {
+        _tables.bindOwner();
+    }
+
+    void loop() override {
+        bindDispatchTask();
+        if (_backend) {
+            void *item = nullptr;
+            // handlers allocate on behalf of the services they belong to
+            HeapScope scope(Heap_User);
+            while (true) {
+                // wake up early for the nearest request deadline, return after a full idle wait
+                TickType_t wait = waitTicks();
+                drainSpill();
+                bool received = _backend.receive(item, wait);
+                if (received) {
+                    if (Message *msg = take(item)) {
+                        sendMessage(*msg);
+                        dispose(msg);
+                    }
+                }
+                expire();
+                // a simulated queue never waits, time only moves when the test advances it
+                if (!received && (wait == IdleTicks || Backend::Simulated)) {
+                    break;
+                }
+            }
+        }
+    }
+
+    CorrelationId expectReply(MsgId replyId, uint32_t timeout, ReplyHandler &handler) override {
+        PendingRequest *found = nullptr;
+        CorrelationId id = 0;
+
+        portENTER_CRITICAL(&_pendingLock);
+        for (auto &slot: _pending) {
+            if (!slot.id) {
+                found = &slot;
+                break;
+            }
+        }
+        if (found) {
+            if (!++_lastCorrelationId) {
+                ++_lastCorrelationId;
+            }
+            id = _lastCorrelationId;
+            found->id = id;
+        }
+        portEXIT_CRITICAL(&_pendingLock);
+
+        if (!found) {
+            esp_logw(bus, "no slot for request, reply: 0x%04x", replyId);
+            return 0;
+        }
+
+        // the slot is ours but not armed yet, fill it outside the critical section
+        handler.moveTo(found->handler);
+        found->replyId = replyId;
+        found->deadline = _backend.now() + pdMS_TO_TICKS(timeout);
+
+        portENTER_CRITICAL(&_pendingLock);
+        found->armed = true;
+        if (!_hasDeadline || isDue(found->deadline, _nextDeadline)) {
+            _nextDeadline = found->deadline;
+            _hasDeadline = true;
+        }
+        portEXIT_CRITICAL(&_pendingLock);
+
+        return id;
+    }
+
+    void cancelReply(CorrelationId id) override {
+        PendingRequest *found = nullptr;
+        portENTER_CRITICAL(&_pendingLock);
+        for (auto &slot: _pending) {
+            if (slot.armed && slot.id == id) {
+                slot.armed = false;
+                found = &slot;
+                break;
+            }
+        }
+        portEXIT_CRITICAL(&_pendingLock);
+
+        if (found) {
+            release(*found);
+        }
+    }
+
+    /**
+     * Number of conflated messages dropped because a newer one replaced them.
+     */
+    [[nodiscard]] uint32_t getReplacedCount() const {
+        return _replaced;
     }
 
     void sendMessage(const Message &msg) override {
-        onMessage(msg);
+        if (!deliverReply(msg)) {
+            onMessage(msg);
+        }
     }
 
-    void postMessage(Message::Ptr &msg) override {
-        if (_queue) {
-            auto *ptr = msg.release();
-            xQueueSendToBack(_queue, &ptr, portMAX_DELAY);
+    PostStatus postMessage(Message::Ptr &msg) override {
+        if (!_backend) {
+            return Post_Dropped;
         }
+        return post(msg.release(), true);
     }
 
-    void postMessageISR(Message::Ptr &msg) override {
-        if (_queue) {
-            auto *ptr = msg.release();
-            xQueueSendFromISR(_queue, &ptr, nullptr);
+    PostStatus tryPostMessage(Message::Ptr &msg) override {
+        if (!_backend) {
+            return Post_Dropped;
+        }
+        return post(msg.release(), false);
+    }
+
+    IRAM_ATTR PostStatus postMessageISR(Message::Ptr &msg) override {
+        if (!_backend) {
+            return Post_Dropped;
+        }
+        auto status = enqueueFromISR(msg.get());
+        if (status != Post_Dropped) {
+            msg.release();
         }
+        return status;
+    }
+
+    IRAM_ATTR void *acquireISRSlot(size_t size, size_t align) override {
+        if (size > isrSlotSize || align > alignof(ISRSlot)) {
+            _isrOverflow.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        void *slot = nullptr;
+        portENTER_CRITICAL_ISR(&_isrLock);
+        if (_isrFree) {
+            auto idx = __builtin_ctz(_isrFree);
+            _isrFree &= ~(1u << idx);
+            slot = &_isrSlots[idx];
+        } else {
+            _isrOverflow.fetch_add(1, std::memory_order_relaxed);
+        }
+        portEXIT_CRITICAL_ISR(&_isrLock);
+        return slot;
+    }
+
+    /**
+     * ISR messages are never conflated, a full queue drops the event and counts it as an overflow.
+     */
+    IRAM_ATTR bool postISRSlot(Message *msg) override {
+        if (_backend && enqueueFromISR(msg) != Post_Dropped) {
+            return true;
+        }
+        msg->~Message();
+        releaseISRSlot(msg);
+        if (!_backend) {
+            _isrOverflow.fetch_add(1, std::memory_order_relaxed);
+        }
+        return false;
+    }
+
+    /**
+     * Number of ISR events dropped for lack of a slot or queue space.
+     */
+    [[nodiscard]] uint32_t getISROverflowCount() const {
+        return _isrOverflow.load(std::memory_order_relaxed);
     }
 
     bool schedule(uint32_t delay, bool repeat, const std::function<void()> &callback) override {
-        Timer *timer = new SoftwareTimer();
+        HeapScope scope(Heap_Timer);
+        Timer *timer = _backend.createTimer();
         timer->attach(delay, repeat, [this, repeat, callback, timer]() {
+            HeapScope scope(Heap_Bus);
             auto timerMsg = new TimerBusMessage();
             timerMsg->callback = callback;
-            std::unique_ptr<Message> ptr(timerMsg);
-            postMessage(ptr);
+            post(timerMsg, false);
             if (!repeat) {
                 delete timer;
             }
@@ -250,17 +1539,111 @@ public:
     }
 
     void scheduleMessage(uint32_t delay, Message::Ptr &msg) override {
-        Timer *timer = new SoftwareTimer();
+        HeapScope scope(Heap_Timer);
+        Timer *timer = _backend.createTimer();
         Message *ptr = msg.release();
         timer->attach(delay, false, [this, ptr, timer]() {
-            std::unique_ptr<Message> holder(ptr);
-            postMessage(holder);
+            if (_backend) {
+                post(ptr, false);
+            } else {
+                delete ptr;
+            }
             delete timer;
         });
     }
 
+    /**
+     * Policy of every type without its own. Overflow_Block waits blockMs, BlockForever keeps
+     * the producer waiting as long as it takes.
+     */
+    void setOverflowPolicy(OverflowPolicy policy, uint32_t blockMs = BlockForever) {
+        portENTER_CRITICAL(&_overflowLock);
+        _default.policy = policy;
+        _default.wait = blockTicks(blockMs);
+        portEXIT_CRITICAL(&_overflowLock);
+    }
+
+    bool setOverflowPolicy(MsgId id, OverflowPolicy policy, uint32_t blockMs = BlockForever) override {
+        portENTER_CRITICAL(&_overflowLock);
+        auto *rule = claimRule(id);
+        if (rule) {
+            rule->ruled = true;
+            rule->policy = policy;
+            rule->wait = blockTicks(blockMs);
+        }
+        portEXIT_CRITICAL(&_overflowLock);
+        return rule != nullptr;
+    }
+
+    /**
+     * Messages dropped by an overflow policy, all types.
+     */
+    [[nodiscard]] uint32_t getDroppedCount() const {
+        return _dropped;
+    }
+
+    [[nodiscard]] uint32_t getDroppedCount(MsgId id) {
+        uint32_t dropped = 0;
+        portENTER_CRITICAL(&_overflowLock);
+        for (size_t idx = 0; idx < _ruleCount; idx++) {
+            if (_rules[idx].id == id) {
+                dropped = _rules[idx].dropped;
+                break;
+            }
+        }
+        portEXIT_CRITICAL(&_overflowLock);
+        return dropped;
+    }
+
+    /**
+     * Messages parked in the spill buffer right now.
+     */
+    [[nodiscard]] size_t getSpillCount() {
+        portENTER_CRITICAL(&_spillLock);
+        size_t count = _spillCount;
+        portEXIT_CRITICAL(&_spillLock);
+        return count;
+    }
+
+    Backend &getBackend() {
+        return _backend;
+    }
+
+    /**
+     * Table entries in the current version, a subscriber listed for several ids counts once per id.
+     */
+    [[nodiscard]] size_t getSubscriberCount() {
+        typename RcuCell<SubscriberTables>::ReadGuard tables(_tables);
+        size_t count = tables->all.size();
+        for (auto &entry: tables->typed) {
+            count += entry.second.size();
+        }
+        for (auto &entry: tables->keyed) {
+            count += entry.second.size();
+        }
+        return count;
+    }
+
+    /**
+     * Replaced table versions and unsubscribed callbacks still waiting for their readers to leave.
+     */
+    [[nodiscard]] size_t getRetiredCount() {
+        return _tables.getRetiredCount();
+    }
+
     virtual ~TMessageBus() {
-        vQueueDelete(_queue);
+        for (auto *subscriber: _tables.peek().owned) {
+            delete subscriber;
+        }
+        for (size_t idx = 0; idx < _spillCount; idx++) {
+            void *item = _spill[(_spillHead + idx) % spillSize];
+            if (!isSlot(item)) {
+                dispose(static_cast<Message *>(item));
+            }
+        }
+        for (auto &slot: _conflated) {
+            delete slot.pending;
+        }
     }
 };
 
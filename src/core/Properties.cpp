@@ -3,69 +3,261 @@
 //
 
 #include "Logger.h"
-#include <LittleFS.h>
+#include "FileCache.h"
 #include "Properties.h"
 
-[[maybe_unused]] void fromJson(cJSON *json, WifiProperties &props) {
+[[maybe_unused]] void fromJson(cJSON *json, WifiProperties &props, PropertiesArena &arena) {
     cJSON *item = json->child;
     while (item) {
         if (!strcmp(item->string, "ssid") && item->type == cJSON_String) {
-            props.ssid = item->valuestring;
+            props.ssid = arena.copy(item->valuestring);
         } else if (!strcmp(item->string, "password") && item->type == cJSON_String) {
-            props.password = item->valuestring;
+            props.password = arena.copy(item->valuestring);
+        } else if (!strcmp(item->string, "ip") && item->type == cJSON_String) {
+            props.ip = arena.copy(item->valuestring);
+        } else if (!strcmp(item->string, "gateway") && item->type == cJSON_String) {
+            props.gateway = arena.copy(item->valuestring);
+        } else if (!strcmp(item->string, "mask") && item->type == cJSON_String) {
+            props.mask = arena.copy(item->valuestring);
+        } else if (!strcmp(item->string, "dns") && item->type == cJSON_String) {
+            props.dns = arena.copy(item->valuestring);
+        } else if (!strcmp(item->string, "fast-connect") && cJSON_IsBool(item)) {
+            props.fastConnect = cJSON_IsTrue(item);
+        } else if (!strcmp(item->string, "fast-connect-timeout") && item->type == cJSON_Number) {
+            props.fastConnectTimeout = item->valueint;
+        } else if (!strcmp(item->string, "reuse-lease") && cJSON_IsBool(item)) {
+            props.reuseLease = cJSON_IsTrue(item);
         }
         item = item->next;
     }
 }
 
-void fromJson(cJSON *json, MqttProperties &props) {
+void fromJson(cJSON *json, MqttProperties &props, PropertiesArena &arena) {
     cJSON *item = json->child;
     while (item) {
         if (!strcmp(item->string, "uri") && item->type == cJSON_String) {
-            props.uri = item->valuestring;
+            props.uri = arena.copy(item->valuestring);
         } else if (!strcmp(item->string, "username") && item->type == cJSON_String) {
-            props.username = item->valuestring;
+            props.username = arena.copy(item->valuestring);
         } else if (!strcmp(item->string, "password") && item->type == cJSON_String) {
-            props.password = item->valuestring;
+            props.password = arena.copy(item->valuestring);
         } else if (!strcmp(item->string, "ca-cert-file") && item->type == cJSON_String) {
-            props.caCertFile = item->valuestring;
+            props.caCertFile = arena.copy(item->valuestring);
         } else if (!strcmp(item->string, "client-cert-file") && item->type == cJSON_String) {
-            props.clientCertFile = item->valuestring;
+            props.clientCertFile = arena.copy(item->valuestring);
         } else if (!strcmp(item->string, "client-key-file") && item->type == cJSON_String) {
-            props.clientKeyFile = item->valuestring;
+            props.clientKeyFile = arena.copy(item->valuestring);
         } else if (!strcmp(item->string, "device-name") && item->type == cJSON_String) {
-            props.deviceName = item->valuestring;
+            props.deviceName = arena.copy(item->valuestring);
         } else if (!strcmp(item->string, "product-name") && item->type == cJSON_String) {
-            props.productName = item->valuestring;
+            props.productName = arena.copy(item->valuestring);
+        } else if (!strcmp(item->string, "persistent-session") && cJSON_IsBool(item)) {
+            props.persistentSession = cJSON_IsTrue(item);
         }
         item = item->next;
     }
 }
 
-void PropertiesLoader::load(std::string_view filePath) {
-    if (File file = LittleFS.open(filePath.data()); file) {
-        String cfg;
-        while (file.available()) {
-            cfg += file.readString();
+void fromJson(cJSON *json, TelemetryProperties &props, PropertiesArena &arena) {
+    cJSON *item = json->child;
+    while (item) {
+        if (!strcmp(item->string, "window-ms") && item->type == cJSON_Number) {
+            props.windowMs = (uint32_t) item->valuedouble;
+        } else if (!strcmp(item->string, "metrics") && cJSON_IsArray(item)) {
+            props.metricCount = 0;
+            cJSON *metric = item->child;
+            while (metric && props.metricCount < TelemetryMaxMetrics) {
+                if (metric->type == cJSON_String) {
+                    props.metrics[props.metricCount++] = arena.copy(metric->valuestring);
+                }
+                metric = metric->next;
+            }
+        }
+        item = item->next;
+    }
+}
+
+const char *rateClassName(RateClass cls) {
+    switch (cls) {
+        case Rate_Control:
+            return "control";
+        case Rate_State:
+            return "state";
+        case Rate_Telemetry:
+            return "telemetry";
+        default:
+            return "";
+    }
+}
+
+static void fromJson(cJSON *json, RateClassProperties &props) {
+    cJSON *item = json->child;
+    while (item) {
+        if (!strcmp(item->string, "rate") && item->type == cJSON_Number) {
+            props.rate = (float) item->valuedouble;
+        } else if (!strcmp(item->string, "burst") && item->type == cJSON_Number) {
+            props.burst = (float) item->valuedouble;
+        } else if (!strcmp(item->string, "min-scale") && item->type == cJSON_Number) {
+            props.minScale = (float) item->valuedouble;
         }
-        file.close();
-
-        cJSON *json = cJSON_Parse(cfg.c_str());
-        cJSON *item = json->child;
-        while (item) {
-            esp_logi(props, "read props: %s", item->string);
-            if (item->type == cJSON_Object) {
-                if (
-                    auto it = _readers.find(item->string);it != _readers.end()) {
-                    auto props = it->second(item);
-                    for (
-                        auto consumer : _consumers) {
-                        consumer->applyProperties(*props);
-                    }
+        item = item->next;
+    }
+}
+
+void fromJson(cJSON *json, RateProperties &props, PropertiesArena &) {
+    cJSON *item = json->child;
+    while (item) {
+        if (!strcmp(item->string, "tick-ms") && item->type == cJSON_Number) {
+            props.tickMs = (uint32_t) item->valuedouble;
+        } else if (!strcmp(item->string, "outbox-target") && item->type == cJSON_Number) {
+            props.outboxTarget = (uint32_t) item->valuedouble;
+        } else if (!strcmp(item->string, "ack-target-ms") && item->type == cJSON_Number) {
+            props.ackTargetMs = (uint32_t) item->valuedouble;
+        } else if (!strcmp(item->string, "recover-step") && item->type == cJSON_Number) {
+            props.recoverStep = (float) item->valuedouble;
+        } else if (!strcmp(item->string, "classes") && cJSON_IsObject(item)) {
+            for (uint8_t cls = 0; cls < Rate_Class_Max; cls++) {
+                if (auto *section = cJSON_GetObjectItemCaseSensitive(item, rateClassName((RateClass) cls))) {
+                    fromJson(section, props.classes[cls]);
                 }
             }
-            item = item->next;
         }
+        item = item->next;
+    }
+}
+
+PropertiesArena::PropertiesArena(size_t capacity) : _data(new char[capacity ? capacity : 1]), _capacity(capacity) {}
+
+PropertiesArena::~PropertiesArena() {
+    for (auto *slot = _head; slot; slot = slot->next) {
+        slot->props->~Properties();
+    }
+    delete[] _data;
+}
+
+void *PropertiesArena::allocate(size_t size, size_t align) {
+    size_t offset = (_size + align - 1) & ~(align - 1);
+    if (_data && offset + size > _capacity) {
+        esp_loge(props, "arena overflow, %u of %u bytes", (unsigned) (offset + size), (unsigned) _capacity);
+        return nullptr;
+    }
+    _size = offset + size;
+    return _data ? _data + offset : nullptr;
+}
+
+void PropertiesArena::add(Properties *props, void *mem) {
+    auto *slot = new(mem) Slot{props, nullptr};
+    if (_tail) {
+        _tail->next = slot;
+    } else {
+        _head = slot;
+    }
+    _tail = slot;
+}
+
+std::string_view PropertiesArena::copy(const char *str) {
+    size_t len = strlen(str);
+    auto *mem = (char *) allocate(len + 1, 1);
+    if (!_data) {
+        // dry run, the json outlives it
+        return {str, len};
+    }
+    if (!mem) {
+        return {};
+    }
+    memcpy(mem, str, len + 1);
+    return {mem, len};
+}
+
+void PropertiesArena::swap(PropertiesArena &other) {
+    std::swap(_data, other._data);
+    std::swap(_capacity, other._capacity);
+    std::swap(_size, other._size);
+    std::swap(_head, other._head);
+    std::swap(_tail, other._tail);
+    std::swap(_scratch, other._scratch);
+}
+
+const Properties *PropertiesArena::find(uint16_t propId) const {
+    for (auto *slot = _head; slot; slot = slot->next) {
+        if (slot->props->getPropId() == propId) {
+            return slot->props;
+        }
+    }
+    return nullptr;
+}
+
+void PropertiesLoader::read(cJSON *json, PropertiesArena &arena) {
+    cJSON *item = json->child;
+    while (item) {
+        if (item->type == cJSON_Object) {
+            if (auto it = _readers.find(item->string); it != _readers.end()) {
+                it->second(item, arena);
+            }
+        }
+        item = item->next;
+    }
+}
+
+void PropertiesLoader::load(std::string_view filePath) {
+    HeapScope scope(Heap_Props);
+    if (std::string cfg; files::cache().read(filePath, cfg) == ESP_OK) {
+        cJSON *json = cJSON_ParseWithLength(cfg.data(), cfg.size());
+        if (!json) {
+            esp_loge(props, "malformed config: %s", filePath.data());
+            return;
+        }
+
+        PropertiesArena dryRun;
+        read(json, dryRun);
+        PropertiesArena arena(dryRun.size());
+        read(json, arena);
         cJSON_Delete(json);
+
+        arena.forEach([this](const Properties &props) {
+            esp_logi(props, "read props: %04x", props.getPropId());
+            for (auto consumer: _consumers) {
+                consumer->applyProperties(props);
+            }
+        });
+        _arena.swap(arena);
+        // the previous config goes away here unless it holds a section the new one left out
+        retain(arena);
+    }
+}
+
+void PropertiesLoader::retain(PropertiesArena &previous) {
+    // the previous config is still current where the new one left a section out
+    bool keep = false;
+    previous.forEach([this, &keep](const Properties &props) {
+        keep |= !_arena.find(props.getPropId());
+    });
+    if (keep) {
+        _retained.insert(_retained.begin(), std::make_unique<PropertiesArena>());
+        _retained.front()->swap(previous);
     }
-}
\ No newline at end of file
+    // an older config goes once every section in it has a newer version, its consumers moved on to that
+    for (size_t idx = 0; idx < _retained.size();) {
+        bool current = false;
+        _retained[idx]->forEach([this, &current](const Properties &props) {
+            current |= find(props.getPropId()) == &props;
+        });
+        if (current) {
+            idx++;
+        } else {
+            _retained.erase(_retained.begin() + (ptrdiff_t) idx);
+        }
+    }
+}
+
+const Properties *PropertiesLoader::find(uint16_t propId) const {
+    if (auto *props = _arena.find(propId)) {
+        return props;
+    }
+    for (auto &arena: _retained) {
+        if (auto *props = arena->find(propId)) {
+            return props;
+        }
+    }
+    return nullptr;
+}
@@ -5,18 +5,23 @@
 #pragma once
 
 #include <cstring>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <unordered_map>
+#include <vector>
 #include <cJSON.h>
 #include "MessageBus.h"
 
 enum SystemPropId {
     Props_Sys_Wifi,
     Props_Sys_Mqtt,
+    Props_Sys_Telemetry,
+    Props_Sys_Rate,
 };
 
 struct Properties {
-    typedef std::shared_ptr<Properties> Ptr;
     [[nodiscard]] virtual uint16_t getPropId() const = 0;
 
     virtual ~Properties() = default;
@@ -34,25 +39,169 @@ public:
     }
 };
 
+/**
+ * Owns every section of a loaded config and the strings they point to in one block. The loader
+ * sizes it with a dry run over the same json (objects are heap temporaries, strings point into
+ * the json), then reads again into an exact fit, so a config costs a single allocation.
+ *
+ * Strings are NUL terminated, data() can go straight to C APIs.
+ */
+class PropertiesArena {
+    struct Slot {
+        Properties *props;
+        Slot *next;
+    };
+
+    char *_data{nullptr};
+    size_t _capacity{0};
+    size_t _size{0};
+    Slot *_head{nullptr};
+    Slot *_tail{nullptr};
+    // dry run objects, or sections that did not fit (a reader that read differently the second time)
+    std::vector<std::unique_ptr<Properties>> _scratch;
+private:
+    void *allocate(size_t size, size_t align);
+
+    void add(Properties *props, void *slot);
+
+public:
+    /**
+     * Dry run, counts the bytes a load needs.
+     */
+    PropertiesArena() = default;
+
+    explicit PropertiesArena(size_t capacity);
+
+    PropertiesArena(const PropertiesArena &) = delete;
+
+    PropertiesArena &operator=(const PropertiesArena &) = delete;
+
+    ~PropertiesArena();
+
+    template<typename Props>
+    Props *create() {
+        static_assert(std::is_base_of_v<Properties, Props>, "Props must derive from Properties");
+        void *slot = allocate(sizeof(Slot), alignof(Slot));
+        void *mem = allocate(sizeof(Props), alignof(Props));
+        if (!_data || !slot || !mem) {
+            auto *props = new Props();
+            _scratch.emplace_back(props);
+            return props;
+        }
+        auto *props = new(mem) Props();
+        add(props, slot);
+        return props;
+    }
+
+    std::string_view copy(const char *str);
+
+    void swap(PropertiesArena &other);
+
+    /**
+     * nullptr when the section was not loaded.
+     */
+    [[nodiscard]] const Properties *find(uint16_t propId) const;
+
+    /**
+     * Sections in the order they were read.
+     */
+    template<typename Fn>
+    void forEach(Fn fn) const {
+        for (auto *slot = _head; slot; slot = slot->next) {
+            fn(*slot->props);
+        }
+    }
+
+    [[nodiscard]] size_t size() const {
+        return _size;
+    }
+
+    [[nodiscard]] size_t capacity() const {
+        return _capacity;
+    }
+};
+
 struct WifiProperties : TProperties<Props_Sys_Wifi, System::Sys_Core> {
-    std::string ssid;
-    std::string password;
+    std::string_view ssid;
+    std::string_view password;
+    // static address, DHCP when ip is empty
+    std::string_view ip;
+    std::string_view gateway;
+    std::string_view mask;
+    std::string_view dns;
+    // connect straight to the last BSSID/channel, full scan if it does not come up in time
+    bool fastConnect{true};
+    uint32_t fastConnectTimeout{3000};
+    // reuse the last DHCP lease as a static address on a fast connect
+    bool reuseLease{false};
 };
 
-[[maybe_unused]] void fromJson(cJSON *json, WifiProperties &props);
+[[maybe_unused]] void fromJson(cJSON *json, WifiProperties &props, PropertiesArena &arena);
 
 struct MqttProperties : TProperties<Props_Sys_Mqtt, System::Sys_Core> {
-    std::string uri;
-    std::string username;
-    std::string password;
-    std::string caCertFile;
-    std::string clientCertFile;
-    std::string clientKeyFile;
-    std::string deviceName;
-    std::string productName;
+    std::string_view uri;
+    std::string_view username;
+    std::string_view password;
+    std::string_view caCertFile;
+    std::string_view clientCertFile;
+    std::string_view clientKeyFile;
+    std::string_view deviceName;
+    std::string_view productName;
+    // clean session off: the broker keeps subscriptions and queued QoS 1 messages across reconnects
+    bool persistentSession{false};
+};
+
+[[maybe_unused]] void fromJson(cJSON *json, MqttProperties &props, PropertiesArena &arena);
+
+static constexpr uint8_t TelemetryMaxMetrics = 8;
+
+struct TelemetryProperties : TProperties<Props_Sys_Telemetry, System::Sys_Core> {
+    uint32_t windowMs{60000};
+    // metrics to aggregate, the first TelemetryMaxMetrics seen when none are listed
+    std::string_view metrics[TelemetryMaxMetrics];
+    uint8_t metricCount{0};
+};
+
+[[maybe_unused]] void fromJson(cJSON *json, TelemetryProperties &props, PropertiesArena &arena);
+
+/**
+ * Publish classes RateService budgets, highest priority first.
+ */
+enum RateClass : uint8_t {
+    Rate_Control,
+    Rate_State,
+    Rate_Telemetry,
+    Rate_Class_Max,
+};
+
+struct RateClassProperties {
+    // publishes per second at full rate, and how many can be saved up
+    float rate{1};
+    float burst{5};
+    // share of rate congestion can take it down to, 1 is never slowed
+    float minScale{0.1f};
 };
 
-[[maybe_unused]] void fromJson(cJSON *json, MqttProperties &props);
+struct RateProperties : TProperties<Props_Sys_Rate, System::Sys_Core> {
+    uint32_t tickMs{250};
+    // congested above either target
+    uint32_t outboxTarget{4096};
+    uint32_t ackTargetMs{1000};
+    // share of the full rate given back per uncongested tick
+    float recoverStep{0.05f};
+    RateClassProperties classes[Rate_Class_Max]{
+            {10, 20, 1},
+            {1, 5, 0.5f},
+            {1, 10, 0.1f},
+    };
+};
+
+/**
+ * "control", "state" and "telemetry", the key of the class in the "classes" section.
+ */
+const char *rateClassName(RateClass cls);
+
+[[maybe_unused]] void fromJson(cJSON *json, RateProperties &props, PropertiesArena &arena);
 
 class PropertiesConsumer {
 public:
@@ -73,21 +222,43 @@ public:
     }
 };
 
-typedef std::function<Properties::Ptr (cJSON* props)> PropertiesReader;
+/**
+ * Builds a section inside the arena. Called twice per load with the same json, keep it free of
+ * side effects.
+ */
+typedef std::function<Properties *(cJSON *json, PropertiesArena &arena)> PropertiesReader;
 
 template<typename Props>
-Properties::Ptr defaultPropertiesReader(cJSON* json) {
-    auto props = std::make_shared<Props>();
-    fromJson(json, *props);
+Properties *defaultPropertiesReader(cJSON *json, PropertiesArena &arena) {
+    auto *props = arena.create<Props>();
+    fromJson(json, *props, arena);
 
     return props;
 }
 
+/**
+ * Single owner of the loaded config. Consumers keep references into it, they stay valid until
+ * the next load has been applied to every consumer. A section the next config leaves out is not
+ * applied again, so the arena holding it stays until a later config brings the section back.
+ */
 class PropertiesLoader {
     std::unordered_map<std::string, PropertiesReader> _readers;
 
     std::vector<PropertiesConsumer*> _consumers;
+    PropertiesArena _arena;
+    // older configs still holding the current version of a section, newest first
+    std::vector<std::unique_ptr<PropertiesArena>> _retained;
+private:
+    void read(cJSON *json, PropertiesArena &arena);
+
+    // previous is the config the new one replaced
+    void retain(PropertiesArena &previous);
+
 public:
+    /**
+     * Reads through files::cache(), a config rewritten with its write() or invalidate()d is
+     * read afresh.
+     */
     void load(std::string_view filePath);
     void addReader(std::string_view props, const PropertiesReader& callback) {
         _readers[props.data()] = callback;
@@ -95,4 +266,25 @@ public:
     void addConsumer(PropertiesConsumer* consumer) {
         _consumers.push_back(consumer);
     }
+
+    template<typename Props>
+    [[nodiscard]] const Props *get() const {
+        return static_cast<const Props *>(find(Props::ID));
+    }
+
+    /**
+     * The current version of a section, from the newest config that had it.
+     */
+    [[nodiscard]] const Properties *find(uint16_t propId) const;
+
+    /**
+     * The newest config, sections it left out live in the retained ones.
+     */
+    [[nodiscard]] const PropertiesArena &getArena() const {
+        return _arena;
+    }
+
+    [[nodiscard]] size_t getRetainedCount() const {
+        return _retained.size();
+    }
 };
\ No newline at end of file
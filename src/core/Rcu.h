@@ -0,0 +1,193 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+/**
+ * Copy-on-write cell for data read on a hot path and written rarely. Readers pin the current
+ * version with a ReadGuard and never block or lock; writers copy it under a mutex, publish the
+ * copy and retire the old version. Writers may run on any task, including from inside a read.
+ *
+ * The task bound with bindOwner() reads with plain loads and a depth counter of its own, other
+ * tasks count themselves in an atomic. Retired versions are freed by the owner outside its reads
+ * once no other reader is inside, so a write from another task is reclaimed on the owner's next
+ * read or reclaim(). Before an owner is bound every reader counts itself and writers free in
+ * place.
+ *
+ * The first version lives in the cell itself, an unchanged cell never touches the heap.
+ */
+template<typename T>
+class RcuCell {
+    struct Deferred {
+        void *ptr;
+        void (*free)(void *ptr);
+    };
+
+    T _initial;
+    std::atomic<T *> _current{&_initial};
+    std::atomic<const void *> _owner{nullptr};
+    // touched by the owner only
+    uint32_t _ownerDepth{0};
+    std::atomic<uint32_t> _readers{0};
+    std::atomic<bool> _pending{false};
+    std::mutex _writeLock;
+    std::vector<T *> _retired;
+    std::vector<Deferred> _deferred;
+private:
+    static const void *currentTask() {
+        static thread_local char tag;
+        return &tag;
+    }
+
+    bool isOwner(const void *task) const {
+        return _owner.load(std::memory_order_relaxed) == task;
+    }
+
+    // with _writeLock held
+    void reclaimLocked() {
+        auto *owner = _owner.load();
+        if (owner && (owner != currentTask() || _ownerDepth != 0)) {
+            return;
+        }
+        if (_readers.load() != 0) {
+            return;
+        }
+        freeRetired();
+    }
+
+    void freeRetired() {
+        for (auto *version: _retired) {
+            if (version != &_initial) {
+                delete version;
+            }
+        }
+        _retired.clear();
+        for (auto &deferred: _deferred) {
+            deferred.free(deferred.ptr);
+        }
+        _deferred.clear();
+        _pending.store(false, std::memory_order_relaxed);
+    }
+
+public:
+    class ReadGuard {
+        RcuCell &_cell;
+        const T *_value;
+        bool _owned;
+    public:
+        explicit ReadGuard(RcuCell &cell) : _cell(cell) {
+            auto *task = currentTask();
+            _owned = _cell.isOwner(task);
+            if (_owned) {
+                // only the owner frees, and never while it is inside
+                _cell._ownerDepth++;
+                _value = _cell._current.load(std::memory_order_acquire);
+            } else {
+                // counted before the load: a reclaim that sees no readers can not have been seen by one
+                _cell._readers.fetch_add(1);
+                _value = _cell._current.load();
+            }
+        }
+
+        ReadGuard(const ReadGuard &) = delete;
+
+        ReadGuard &operator=(const ReadGuard &) = delete;
+
+        ~ReadGuard() {
+            if (_owned) {
+                _cell._ownerDepth--;
+            } else {
+                _cell._readers.fetch_sub(1);
+            }
+        }
+
+        const T *operator->() const {
+            return _value;
+        }
+
+        const T &operator*() const {
+            return *_value;
+        }
+    };
+
+    RcuCell() = default;
+
+    RcuCell(const RcuCell &) = delete;
+
+    RcuCell &operator=(const RcuCell &) = delete;
+
+    ~RcuCell() {
+        freeRetired();
+        if (auto *current = _current.load(); current != &_initial) {
+            delete current;
+        }
+    }
+
+    /**
+     * Makes the calling task the owner, outside any ReadGuard of its own. The owner may move to
+     * another task only while the previous one is outside its reads.
+     */
+    void bindOwner() {
+        auto *task = currentTask();
+        // seq_cst like the writer's exchange: a writer that still sees the previous owner has
+        // published before the new owner's first load
+        if (!isOwner(task)) {
+            _owner.store(task);
+        }
+    }
+
+    /**
+     * mutate gets a private copy of the current version, readers see it once mutate returns.
+     */
+    template<typename F>
+    void update(F &&mutate) {
+        std::lock_guard<std::mutex> lock(_writeLock);
+        auto *next = new T(*_current.load());
+        mutate(*next);
+        _retired.push_back(_current.exchange(next));
+        _pending.store(true, std::memory_order_relaxed);
+        reclaimLocked();
+    }
+
+    /**
+     * Deletes ptr after the grace period, for objects an update() has just unpublished.
+     */
+    template<typename U>
+    void retire(U *ptr) {
+        std::lock_guard<std::mutex> lock(_writeLock);
+        _deferred.push_back({ptr, [](void *ptr) {
+            delete static_cast<U *>(ptr);
+        }});
+        _pending.store(true, std::memory_order_relaxed);
+        reclaimLocked();
+    }
+
+    /**
+     * Frees what retired versions it can, a single load when there is nothing to free. Only the
+     * owner outside a ReadGuard gets anywhere, call it after each read, e.g. between dispatches.
+     */
+    void reclaim() {
+        if (!_pending.load(std::memory_order_relaxed)) {
+            return;
+        }
+        std::unique_lock<std::mutex> lock(_writeLock, std::try_to_lock);
+        if (lock) {
+            reclaimLocked();
+        }
+    }
+
+    /**
+     * Current version for the writer's own bookkeeping, readers use a ReadGuard.
+     */
+    const T &peek() const {
+        return *_current.load();
+    }
+
+    [[nodiscard]] size_t getRetiredCount() {
+        std::lock_guard<std::mutex> lock(_writeLock);
+        return _retired.size() + _deferred.size();
+    }
+};
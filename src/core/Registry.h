@@ -30,14 +30,31 @@ public:
 
 typedef std::vector<Service *> ServiceArray;
 
+/**
+ * Services of a registry, whatever stores them.
+ */
+struct ServiceRange {
+    Service **first;
+    Service **last;
+
+    [[nodiscard]] Service **begin() const {
+        return first;
+    }
+
+    [[nodiscard]] Service **end() const {
+        return last;
+    }
+};
+
 class Registry {
 public:
     virtual void addService(Service *service) = 0;
 
-    virtual ServiceArray &getServices() = 0;
+    virtual ServiceRange getServices() = 0;
 
     template<typename C, typename... T>
     C &create(T &&... all) {
+        HeapScope scope(Heap_User);
         auto *service = new C(*this, std::forward<T>(all)...);
         addService(service);
         return *service;
@@ -72,8 +89,8 @@ public:
         _services.push_back(service);
     }
 
-    ServiceArray &getServices() override {
-        return _services;
+    ServiceRange getServices() override {
+        return {_services.data(), _services.data() + _services.size()};
     }
 
     MessageBus &getMessageBus() override {
@@ -114,14 +131,20 @@ public:
     void loop() override {}
 };
 
-class Application {
-    TRegistry<TMessageBus<10>> _registry;
+/**
+ * R is TRegistry for services created at runtime, TStaticRegistry (core/StaticRegistry.h) for
+ * a composition fixed at compile time.
+ */
+template<typename R>
+class TApplication {
+    R _registry;
 public:
-    Registry &getRegistry() {
+    R &getRegistry() {
         return _registry;
     }
 
     virtual void setup() {
+        heap::begin();
         LittleFS.begin(false);
 
         onSetup();
@@ -145,3 +168,5 @@ public:
         getRegistry().getMessageBus().loop();
     }
 };
+
+typedef TApplication<TRegistry<TMessageBus<10>>> Application;
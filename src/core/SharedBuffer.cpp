@@ -0,0 +1,66 @@
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+#include "SharedBuffer.h"
+
+BufferPool &SharedBuffer::defaultPool() {
+    static BufferPool pool(PoolBlockSize, PoolBlocks, Heap_Bus);
+    return pool;
+}
+
+SharedBuffer SharedBuffer::allocate(size_t capacity, BufferPool &pool) {
+    SharedBuffer buffer;
+    if (!capacity) {
+        return buffer;
+    }
+    size_t total = sizeof(Header) + capacity;
+    uint8_t *block = pool.acquire(total);
+    if (!block) {
+        // pool exhausted, the heap block still goes back through pool.release()
+        HeapScope scope(Heap_Bus);
+        block = new uint8_t[total];
+    }
+    buffer._header = new(block) Header{{1}, &pool, (uint32_t) capacity};
+    buffer._size = capacity;
+    return buffer;
+}
+
+SharedBuffer::SharedBuffer(const void *data, size_t size, BufferPool &pool) {
+    *this = allocate(size, pool);
+    if (size) {
+        memcpy(storage(), data, size);
+    }
+}
+
+void SharedBuffer::release() {
+    if (_header && _header->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        auto *pool = _header->pool;
+        _header->~Header();
+        pool->release(reinterpret_cast<uint8_t *>(_header));
+    }
+    _header = nullptr;
+}
+
+SharedBuffer SharedBuffer::slice(size_t offset, size_t size) const {
+    SharedBuffer result(*this);
+    offset = std::min<size_t>(offset, _size);
+    result._offset += offset;
+    result._size = std::min(size, _size - offset);
+    return result;
+}
+
+uint8_t *SharedBuffer::mutableData() {
+    if (!_header || useCount() != 1) {
+        return nullptr;
+    }
+    return storage() + _offset;
+}
+
+bool SharedBuffer::resize(size_t size) {
+    if (!_header || useCount() != 1 || size > capacity()) {
+        return false;
+    }
+    _size = size;
+    return true;
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "BufferPool.h"
+
+/**
+ * Immutable, reference counted bytes. Copies and slices share one block taken from a BufferPool
+ * (the heap when the pool is exhausted or the data is larger than a block), so a message field
+ * can be posted, fanned out and published without copying the payload. Not null terminated.
+ */
+class SharedBuffer {
+    struct Header {
+        std::atomic<uint32_t> refs;
+        BufferPool *pool;
+        uint32_t capacity;
+    };
+
+    Header *_header{nullptr};
+    uint32_t _offset{0};
+    uint32_t _size{0};
+private:
+    [[nodiscard]] uint8_t *storage() const {
+        return reinterpret_cast<uint8_t *>(_header + 1);
+    }
+
+    void retain() {
+        if (_header) {
+            _header->refs.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void release();
+
+public:
+    static constexpr size_t PoolBlockSize = 512;
+    static constexpr size_t PoolBlocks = 8;
+    // largest buffer that still comes from a default pool block
+    static constexpr size_t PoolCapacity = PoolBlockSize - sizeof(Header);
+
+    /**
+     * Shared by all buffers allocated without an explicit pool.
+     */
+    static BufferPool &defaultPool();
+
+    /**
+     * Writable buffer of up to capacity bytes, fill it through mutableData() and shrink it with
+     * resize() before handing out copies.
+     */
+    static SharedBuffer allocate(size_t capacity, BufferPool &pool = defaultPool());
+
+    SharedBuffer() = default;
+
+    SharedBuffer(const void *data, size_t size, BufferPool &pool = defaultPool());
+
+    SharedBuffer(std::string_view value) : SharedBuffer(value.data(), value.size()) {}
+
+    SharedBuffer(const char *value) : SharedBuffer(std::string_view(value)) {}
+
+    SharedBuffer(const std::string &value) : SharedBuffer(value.data(), value.size()) {}
+
+    SharedBuffer(const SharedBuffer &other) : _header(other._header), _offset(other._offset), _size(other._size) {
+        retain();
+    }
+
+    SharedBuffer(SharedBuffer &&other) noexcept: _header(other._header), _offset(other._offset), _size(other._size) {
+        other._header = nullptr;
+        other._offset = other._size = 0;
+    }
+
+    SharedBuffer &operator=(const SharedBuffer &other) {
+        if (this != &other) {
+            SharedBuffer copy(other);
+            *this = std::move(copy);
+        }
+        return *this;
+    }
+
+    SharedBuffer &operator=(SharedBuffer &&other) noexcept {
+        if (this != &other) {
+            release();
+            _header = other._header;
+            _offset = other._offset;
+            _size = other._size;
+            other._header = nullptr;
+            other._offset = other._size = 0;
+        }
+        return *this;
+    }
+
+    ~SharedBuffer() {
+        release();
+    }
+
+    [[nodiscard]] const uint8_t *data() const {
+        return _header ? storage() + _offset : nullptr;
+    }
+
+    [[nodiscard]] size_t size() const {
+        return _size;
+    }
+
+    [[nodiscard]] bool empty() const {
+        return !_size;
+    }
+
+    [[nodiscard]] std::string_view view() const {
+        return {(const char *) data(), _size};
+    }
+
+    operator std::string_view() const {
+        return view();
+    }
+
+    bool operator==(std::string_view other) const {
+        return view() == other;
+    }
+
+    bool operator!=(std::string_view other) const {
+        return view() != other;
+    }
+
+    /**
+     * Shares the block, nothing is copied. Clamped to the buffer.
+     */
+    [[nodiscard]] SharedBuffer slice(size_t offset, size_t size = SIZE_MAX) const;
+
+    /**
+     * Only while this is the sole owner of the block, nullptr otherwise.
+     */
+    uint8_t *mutableData();
+
+    [[nodiscard]] size_t capacity() const {
+        return _header ? _header->capacity - _offset : 0;
+    }
+
+    /**
+     * Within capacity() and only while this is the sole owner.
+     */
+    bool resize(size_t size);
+
+    [[nodiscard]] uint32_t useCount() const {
+        return _header ? _header->refs.load(std::memory_order_relaxed) : 0;
+    }
+};
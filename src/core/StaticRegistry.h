@@ -0,0 +1,136 @@
+#pragma once
+
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "Registry.h"
+
+/**
+ * Function subscription for TStaticRegistry, fn runs for every Msg without a std::function or
+ * a subscriber object on the heap.
+ */
+template<typename Msg, void (*fn)(const Msg &msg)>
+class TStaticSubscription {
+public:
+    explicit TStaticSubscription(Registry &) {}
+
+    void dispatch(const Message &msg) {
+        if (msg.getMsgId() == Msg::ID) {
+            fn(static_cast<const Msg &>(msg));
+        }
+    }
+};
+
+/**
+ * Compile time composition: services and subscriptions are listed as template arguments and
+ * live in a tuple inside the registry, each built with the registry reference. The bus is
+ * derived from Bus and hands every message to the listed components that have a dispatch()
+ * (TMessageSubscriber, TStaticSubscription) with a direct call, no subscriber table involved.
+ * A listed service that still calls subscribe(this) is ignored by the bus, it is wired already.
+ *
+ * Nothing here allocates, pick a bus that does not either (StaticRtosBusBackend) and keep the
+ * service constructors heap free. Runtime subscriptions and create<C>() still work as a
+ * fallback, they are the parts that go to the heap.
+ */
+template<typename Bus, typename... Components>
+class TStaticRegistry : public Registry {
+    static constexpr size_t ServiceCount = (0 + ... + (size_t) std::is_base_of_v<Service, Components>);
+
+    template<typename C, typename = void>
+    struct HasDispatch : std::false_type {};
+
+    template<typename C>
+    struct HasDispatch<C, std::void_t<decltype(std::declval<C &>().dispatch(std::declval<const Message &>()))>> : std::true_type {};
+
+    class StaticBus : public Bus {
+        TStaticRegistry &_registry;
+    public:
+        explicit StaticBus(TStaticRegistry &registry) : _registry(registry) {}
+
+        void subscribe(MessageSubscriber *subscriber) override {
+            if (!_registry.isWired(subscriber)) {
+                Bus::subscribe(subscriber);
+            }
+        }
+
+        using MessageBus::subscribe;
+
+        void onMessage(const Message &msg) override {
+            Bus::onMessage(msg);
+            _registry.dispatch(msg);
+        }
+    };
+
+    StaticBus _bus{*this};
+    PropertiesLoader _propsLoader;
+    std::tuple<Components...> _components;
+    Service *_services[ServiceCount ? ServiceCount : 1]{};
+private:
+    template<typename C>
+    Registry &self() {
+        return *this;
+    }
+
+    template<typename C>
+    static void dispatchTo(C &component, const Message &msg) {
+        if constexpr (HasDispatch<C>::value) {
+            component.dispatch(msg);
+        }
+    }
+
+    template<typename C>
+    static bool wires(C &component, const MessageSubscriber *subscriber) {
+        if constexpr (std::is_base_of_v<MessageSubscriber, C> && HasDispatch<C>::value) {
+            return static_cast<const MessageSubscriber *>(&component) == subscriber;
+        } else {
+            return false;
+        }
+    }
+
+    void dispatch(const Message &msg) {
+        std::apply([&msg](auto &... component) {
+            (dispatchTo(component, msg), ...);
+        }, _components);
+    }
+
+    bool isWired(const MessageSubscriber *subscriber) {
+        return std::apply([subscriber](auto &... component) {
+            return (false || ... || wires(component, subscriber));
+        }, _components);
+    }
+
+public:
+    TStaticRegistry() : _components(self<Components>()...) {
+        size_t idx = 0;
+        std::apply([this, &idx](auto &... component) {
+            ([&]() {
+                if constexpr (std::is_base_of_v<Service, std::decay_t<decltype(component)>>) {
+                    _services[idx++] = &component;
+                }
+            }(), ...);
+        }, _components);
+    }
+
+    void addService(Service *service) override {
+        // nowhere to keep it, the composition is closed
+        esp_loge(registry, "static registry, service %d is not managed", service->getServiceId());
+    }
+
+    ServiceRange getServices() override {
+        return {_services, _services + ServiceCount};
+    }
+
+    MessageBus &getMessageBus() override {
+        return _bus;
+    }
+
+    PropertiesLoader &getPropsLoader() override {
+        return _propsLoader;
+    }
+
+    template<typename C>
+    C &get() {
+        return std::get<C>(_components);
+    }
+};
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+/**
+ * P-square estimate of one quantile (Jain and Chlamtac): five markers follow the minimum, the
+ * p/2, p, (1+p)/2 quantiles and the maximum, memory stays constant whatever the sample count.
+ * Exact up to five samples.
+ */
+class QuantileEstimator {
+    float _p;
+    float _q[5]{};
+    int32_t _n[5]{};
+    float _np[5]{};
+    float _dn[5]{};
+    uint32_t _count{0};
+private:
+    [[nodiscard]] float parabolic(int idx, int d) const {
+        return _q[idx] + (float) d / (float) (_n[idx + 1] - _n[idx - 1]) * (
+                (float) (_n[idx] - _n[idx - 1] + d) * (_q[idx + 1] - _q[idx]) / (float) (_n[idx + 1] - _n[idx]) +
+                (float) (_n[idx + 1] - _n[idx] - d) * (_q[idx] - _q[idx - 1]) / (float) (_n[idx] - _n[idx - 1])
+        );
+    }
+
+    [[nodiscard]] float linear(int idx, int d) const {
+        return _q[idx] + (float) d * (_q[idx + d] - _q[idx]) / (float) (_n[idx + d] - _n[idx]);
+    }
+
+public:
+    explicit QuantileEstimator(float p = 0.5f) : _p(p) {
+        reset();
+    }
+
+    void reset() {
+        _count = 0;
+        for (int idx = 0; idx < 5; idx++) {
+            _n[idx] = idx;
+        }
+        _np[0] = 0;
+        _np[1] = 2 * _p;
+        _np[2] = 4 * _p;
+        _np[3] = 2 + 2 * _p;
+        _np[4] = 4;
+        _dn[0] = 0;
+        _dn[1] = _p / 2;
+        _dn[2] = _p;
+        _dn[3] = (1 + _p) / 2;
+        _dn[4] = 1;
+    }
+
+    void add(float value) {
+        if (_count < 5) {
+            _q[_count++] = value;
+            std::sort(_q, _q + _count);
+            return;
+        }
+        _count++;
+
+        int cell;
+        if (value < _q[0]) {
+            _q[0] = value;
+            cell = 0;
+        } else if (value >= _q[4]) {
+            _q[4] = value;
+            cell = 3;
+        } else {
+            cell = (int) (std::upper_bound(_q + 1, _q + 4, value) - _q) - 1;
+        }
+        for (int idx = cell + 1; idx < 5; idx++) {
+            _n[idx]++;
+        }
+        for (int idx = 0; idx < 5; idx++) {
+            _np[idx] += _dn[idx];
+        }
+
+        // pull the middle markers back towards their desired positions
+        for (int idx = 1; idx < 4; idx++) {
+            float delta = _np[idx] - (float) _n[idx];
+            if ((delta >= 1 && _n[idx + 1] - _n[idx] > 1) || (delta <= -1 && _n[idx - 1] - _n[idx] < -1)) {
+                int d = delta > 0 ? 1 : -1;
+                float q = parabolic(idx, d);
+                _q[idx] = _q[idx - 1] < q && q < _q[idx + 1] ? q : linear(idx, d);
+                _n[idx] += d;
+            }
+        }
+    }
+
+    [[nodiscard]] float value() const {
+        if (_count >= 5) {
+            return _q[2];
+        }
+        if (_count == 0) {
+            return 0;
+        }
+        return _q[(size_t) std::lround(_p * (float) (_count - 1))];
+    }
+
+    [[nodiscard]] uint32_t count() const {
+        return _count;
+    }
+};
+
+/**
+ * Count, min, max, mean and p50/p90/p99 of one metric over a window, under 300 bytes however
+ * many samples it sees.
+ */
+struct MetricWindow {
+    uint32_t count{0};
+    float min{std::numeric_limits<float>::max()};
+    float max{std::numeric_limits<float>::lowest()};
+    double sum{0};
+    QuantileEstimator p50{0.5f};
+    QuantileEstimator p90{0.9f};
+    QuantileEstimator p99{0.99f};
+
+    void add(float value) {
+        count++;
+        min = std::min(min, value);
+        max = std::max(max, value);
+        sum += value;
+        p50.add(value);
+        p90.add(value);
+        p99.add(value);
+    }
+
+    [[nodiscard]] float mean() const {
+        return count ? (float) (sum / count) : 0;
+    }
+
+    void reset() {
+        *this = MetricWindow();
+    }
+};
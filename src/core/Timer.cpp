@@ -5,6 +5,9 @@
 #include "Timer.h"
 
 void SoftwareTimer::attach(uint32_t milliseconds, bool repeat, const std::function<void()> &callback) {
+    HeapScope scope(Heap_Timer);
+    // attached again, e.g. on a config reload: the old timer would keep firing next to the new one
+    detach();
     _callback = callback;
     _timer = xTimerCreate(
             "timer",
@@ -17,7 +20,14 @@ void SoftwareTimer::attach(uint32_t milliseconds, bool repeat, const std::functi
     xTimerStart(_timer, 0);
 }
 
+void SoftwareTimer::detach() {
+    if (_timer) {
+        xTimerStop(_timer, 0);
+        xTimerDelete(_timer, 0);
+        _timer = nullptr;
+    }
+}
+
 SoftwareTimer::~SoftwareTimer() {
-    xTimerStop(_timer, 0);
-    xTimerDelete(_timer, 0);
+    detach();
 }
\ No newline at end of file
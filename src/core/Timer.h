@@ -8,6 +8,8 @@
 #include <functional>
 #include <memory>
 
+#include "Heap.h"
+
 class Timer {
 public:
     typedef std::shared_ptr<Timer> Ptr;
@@ -37,6 +39,7 @@ private:
 
 public:
     void attach(uint32_t milliseconds, bool repeat, const std::function<void()> &callback) override {
+        HeapScope scope(Heap_Timer);
         _callback = callback;
 
         esp_timer_create_args_t _timerConfig;
@@ -91,5 +94,7 @@ public:
 
     void attach(uint32_t milliseconds, bool repeat, const std::function<void()> &callback) override;
 
+    void detach();
+
     ~SoftwareTimer() override;
 };
@@ -0,0 +1,267 @@
+#include <LittleFS.h>
+#include <esp_timer.h>
+#include <freertos/task.h>
+
+#include "Trace.h"
+
+static const uint8_t TRACE_MAGIC[] = {'B', 'T', 'R', '1'};
+// varint delta, id and size
+static const size_t TRACE_HEADER_MAX = 10 + 3 + 10;
+
+static size_t encodeHeader(uint8_t *out, uint64_t deltaUs, MsgId id, size_t size) {
+    ByteWriter writer(out, TRACE_HEADER_MAX);
+    writer.putVarint(deltaUs);
+    writer.putVarint(id);
+    writer.putVarint(size);
+    return writer.size();
+}
+
+TraceRing::TraceRing(size_t capacity) {
+    HeapScope scope(Heap_Bus);
+    _buffer.resize(capacity);
+}
+
+uint64_t TraceRing::readVarint(uint64_t &pos) const {
+    uint64_t value = 0;
+    for (uint8_t shift = 0; shift < 64; shift += 7) {
+        uint8_t byte = _buffer[pos++ % _buffer.size()];
+        value |= (uint64_t) (byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            break;
+        }
+    }
+    return value;
+}
+
+void TraceRing::evict() {
+    uint64_t pos = _tail;
+    _baseUs += readVarint(pos);
+    readVarint(pos);
+    pos += readVarint(pos);
+    _tail = pos;
+    _count--;
+    _evicted++;
+}
+
+void TraceRing::write(uint64_t timeUs, MsgId id, const uint8_t *payload, size_t size) {
+    if (!_count) {
+        _baseUs = _lastUs = timeUs;
+    }
+
+    uint8_t header[TRACE_HEADER_MAX];
+    size_t headerSize = encodeHeader(header, timeUs - _lastUs, id, size);
+    size_t total = headerSize + size;
+    if (total > _buffer.size()) {
+        _dropped++;
+        return;
+    }
+    while (_buffer.size() - (_head - _tail) < total) {
+        evict();
+    }
+
+    auto copy = [this](const uint8_t *data, size_t size) {
+        size_t offset = _head % _buffer.size();
+        size_t first = std::min(size, _buffer.size() - offset);
+        memcpy(_buffer.data() + offset, data, first);
+        memcpy(_buffer.data(), data + first, size - first);
+        _head += size;
+    };
+    copy(header, headerSize);
+    copy(payload, size);
+    _lastUs = timeUs;
+    _count++;
+}
+
+bool TraceRing::next(TraceRecord &record) {
+    if (_readPos < _tail) {
+        // evicted under the reader, continue from the oldest record left
+        rewind();
+    }
+    if (_readPos >= _head) {
+        return false;
+    }
+
+    _readUs += readVarint(_readPos);
+    record.timeUs = _readUs;
+    record.id = (MsgId) readVarint(_readPos);
+    record.size = readVarint(_readPos);
+
+    _record.resize(record.size);
+    for (size_t idx = 0; idx < record.size; idx++) {
+        _record[idx] = _buffer[_readPos++ % _buffer.size()];
+    }
+    record.payload = _record.data();
+    return true;
+}
+
+void TraceRing::rewind() {
+    _readPos = _tail;
+    _readUs = _baseUs;
+}
+
+void TraceRing::clear() {
+    _head = _tail = _readPos = 0;
+    _count = 0;
+}
+
+void TraceRing::dump(TraceSink &sink) {
+    rewind();
+    TraceRecord record;
+    while (next(record)) {
+        sink.write(record.timeUs, record.id, record.payload, record.size);
+    }
+}
+
+TraceFile::TraceFile(std::string_view path) : _path(path) {}
+
+bool TraceFile::create() {
+    close();
+    _file = LittleFS.open(_path.c_str(), FILE_WRITE);
+    if (!_file) {
+        esp_loge(trace, "can't create: %s", _path.c_str());
+        return false;
+    }
+    _file.write(TRACE_MAGIC, sizeof(TRACE_MAGIC));
+    _lastUs = 0;
+    return true;
+}
+
+bool TraceFile::open() {
+    close();
+    _file = LittleFS.open(_path.c_str(), FILE_READ);
+    if (!_file) {
+        esp_loge(trace, "can't open: %s", _path.c_str());
+        return false;
+    }
+    uint8_t magic[sizeof(TRACE_MAGIC)];
+    if (_file.read(magic, sizeof(magic)) != sizeof(magic) || memcmp(magic, TRACE_MAGIC, sizeof(magic)) != 0) {
+        esp_loge(trace, "not a trace: %s", _path.c_str());
+        _file.close();
+        return false;
+    }
+    _readUs = 0;
+    return true;
+}
+
+void TraceFile::write(uint64_t timeUs, MsgId id, const uint8_t *payload, size_t size) {
+    if (!_file) {
+        return;
+    }
+    // the first record carries the absolute time
+    uint8_t header[TRACE_HEADER_MAX];
+    size_t headerSize = encodeHeader(header, timeUs - _lastUs, id, size);
+    _lastUs = timeUs;
+
+    if (_blockSize + headerSize + size > BlockSize) {
+        flush();
+    }
+    if (headerSize + size > BlockSize) {
+        _file.write(header, headerSize);
+        _file.write(payload, size);
+        return;
+    }
+    memcpy(_block + _blockSize, header, headerSize);
+    memcpy(_block + _blockSize + headerSize, payload, size);
+    _blockSize += headerSize + size;
+}
+
+bool TraceFile::readVarint(uint64_t &value) {
+    value = 0;
+    for (uint8_t shift = 0; shift < 64; shift += 7) {
+        int byte = _file.read();
+        if (byte < 0) {
+            return false;
+        }
+        value |= (uint64_t) (byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool TraceFile::next(TraceRecord &record) {
+    uint64_t delta, id, size;
+    if (!_file || !readVarint(delta) || !readVarint(id) || !readVarint(size)) {
+        return false;
+    }
+    _record.resize(size);
+    if (_file.read(_record.data(), size) != size) {
+        return false;
+    }
+    _readUs += delta;
+    record.timeUs = _readUs;
+    record.id = (MsgId) id;
+    record.payload = _record.data();
+    record.size = size;
+    return true;
+}
+
+void TraceFile::rewind() {
+    open();
+}
+
+void TraceFile::flush() {
+    if (_file && _blockSize) {
+        _file.write(_block, _blockSize);
+        _blockSize = 0;
+    }
+}
+
+void TraceFile::close() {
+    if (_file) {
+        flush();
+        _file.close();
+    }
+}
+
+TraceFile::~TraceFile() {
+    close();
+}
+
+void BusRecorder::onMessage(const Message &msg) {
+    if (!_enabled) {
+        return;
+    }
+    ByteWriter writer(_payload, MaxPayload);
+    size_t size = 0;
+    if (_codecs.encode(msg, writer)) {
+        size = writer.size();
+    } else if (writer.overflow()) {
+        _truncated++;
+    } else {
+        _unknown++;
+    }
+    _sink.write(esp_timer_get_time(), msg.getMsgId(), _payload, size);
+    _recorded++;
+}
+
+size_t BusReplay::run(TraceSource &source, float speed) {
+    TraceRecord record;
+    size_t count = 0;
+    int64_t startUs = esp_timer_get_time();
+    uint64_t firstUs = 0;
+
+    while (source.next(record)) {
+        if (!count++) {
+            firstUs = record.timeUs;
+        }
+        if (speed > 0) {
+            auto dueUs = startUs + (int64_t) ((record.timeUs - firstUs) / speed);
+            auto leftUs = dueUs - esp_timer_get_time();
+            if (leftUs >= 1000) {
+                vTaskDelay(pdMS_TO_TICKS(leftUs / 1000));
+            }
+        }
+
+        ByteReader reader(record.payload, record.size);
+        auto msg = _codecs.decode(record.id, reader);
+        if (!msg) {
+            _skipped++;
+            continue;
+        }
+        _bus.postMessage(msg);
+        _posted++;
+    }
+    return count;
+}
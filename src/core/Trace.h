@@ -0,0 +1,208 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <FS.h>
+
+#include "Codec.h"
+
+/**
+ * One captured message: absolute time, id and the codec payload (empty when the type had no
+ * codec). payload points into the source and stays valid until the next call to next().
+ *
+ * On the wire a record is varint(time delta us), varint(id), varint(size), payload.
+ */
+struct TraceRecord {
+    uint64_t timeUs{0};
+    MsgId id{0};
+    const uint8_t *payload{nullptr};
+    size_t size{0};
+};
+
+class TraceSink {
+public:
+    virtual void write(uint64_t timeUs, MsgId id, const uint8_t *payload, size_t size) = 0;
+
+    virtual ~TraceSink() = default;
+};
+
+class TraceSource {
+public:
+    virtual bool next(TraceRecord &record) = 0;
+
+    virtual void rewind() = 0;
+
+    virtual ~TraceSource() = default;
+};
+
+/**
+ * Fixed size RAM ring, the oldest records are dropped to make room. Not thread safe: read it
+ * once the recorder is detached or the bus is idle.
+ */
+class TraceRing : public TraceSink, public TraceSource {
+    std::vector<uint8_t> _buffer;
+    std::vector<uint8_t> _record;
+    // absolute byte positions, the buffer index is pos % capacity
+    uint64_t _head{0};
+    uint64_t _tail{0};
+    uint64_t _lastUs{0};
+    // time of the record before the tail, the tail delta is relative to it
+    uint64_t _baseUs{0};
+    size_t _count{0};
+    uint32_t _evicted{0};
+    uint32_t _dropped{0};
+
+    uint64_t _readPos{0};
+    uint64_t _readUs{0};
+private:
+    uint64_t readVarint(uint64_t &pos) const;
+
+    void evict();
+
+public:
+    explicit TraceRing(size_t capacity);
+
+    void write(uint64_t timeUs, MsgId id, const uint8_t *payload, size_t size) override;
+
+    bool next(TraceRecord &record) override;
+
+    void rewind() override;
+
+    void clear();
+
+    [[nodiscard]] size_t size() const {
+        return _count;
+    }
+
+    [[nodiscard]] size_t bytes() const {
+        return _head - _tail;
+    }
+
+    /**
+     * Records overwritten by newer ones.
+     */
+    [[nodiscard]] uint32_t getEvictedCount() const {
+        return _evicted;
+    }
+
+    /**
+     * Records larger than the whole ring.
+     */
+    [[nodiscard]] uint32_t getDroppedCount() const {
+        return _dropped;
+    }
+
+    /**
+     * Writes the retained records to sink, e.g. a TraceFile for offline replay.
+     */
+    void dump(TraceSink &sink);
+};
+
+/**
+ * Trace on LittleFS, records are buffered and written in blocks.
+ */
+class TraceFile : public TraceSink, public TraceSource {
+    static constexpr size_t BlockSize = 512;
+
+    std::string _path;
+    fs::File _file;
+    uint8_t _block[BlockSize]{};
+    size_t _blockSize{0};
+    uint64_t _lastUs{0};
+
+    std::vector<uint8_t> _record;
+    uint64_t _readUs{0};
+private:
+    bool readVarint(uint64_t &value);
+
+public:
+    explicit TraceFile(std::string_view path);
+
+    /**
+     * Truncates the file and starts a new trace.
+     */
+    bool create();
+
+    bool open();
+
+    void write(uint64_t timeUs, MsgId id, const uint8_t *payload, size_t size) override;
+
+    bool next(TraceRecord &record) override;
+
+    void rewind() override;
+
+    void flush();
+
+    void close();
+
+    ~TraceFile() override;
+};
+
+/**
+ * Subscribe it to a bus to capture every broadcast message. Replies consumed by a pending
+ * request never reach subscribers and are not captured.
+ */
+class BusRecorder : public MessageSubscriber {
+    static constexpr size_t MaxPayload = 256;
+
+    const CodecRegistry &_codecs;
+    TraceSink &_sink;
+    uint8_t _payload[MaxPayload]{};
+    bool _enabled{true};
+    uint32_t _recorded{0};
+    uint32_t _unknown{0};
+    uint32_t _truncated{0};
+public:
+    BusRecorder(const CodecRegistry &codecs, TraceSink &sink) : _codecs(codecs), _sink(sink) {}
+
+    void onMessage(const Message &msg) override;
+
+    void setEnabled(bool enabled) {
+        _enabled = enabled;
+    }
+
+    [[nodiscard]] uint32_t getRecordedCount() const {
+        return _recorded;
+    }
+
+    /**
+     * Captured without payload because the type has no codec.
+     */
+    [[nodiscard]] uint32_t getUnknownCount() const {
+        return _unknown;
+    }
+
+    /**
+     * Captured without payload because it encoded to more than MaxPayload bytes.
+     */
+    [[nodiscard]] uint32_t getTruncatedCount() const {
+        return _truncated;
+    }
+};
+
+/**
+ * Posts a trace back into a bus. speed 1 keeps the original pacing, 10 plays ten times faster,
+ * 0 posts as fast as the bus takes it.
+ */
+class BusReplay {
+    const CodecRegistry &_codecs;
+    MessageBus &_bus;
+    uint32_t _posted{0};
+    uint32_t _skipped{0};
+public:
+    BusReplay(const CodecRegistry &codecs, MessageBus &bus) : _codecs(codecs), _bus(bus) {}
+
+    size_t run(TraceSource &source, float speed = 1.0f);
+
+    [[nodiscard]] uint32_t getPostedCount() const {
+        return _posted;
+    }
+
+    /**
+     * Records without a codec or with a payload the codec rejected.
+     */
+    [[nodiscard]] uint32_t getSkippedCount() const {
+        return _skipped;
+    }
+};
@@ -0,0 +1,163 @@
+#include <algorithm>
+
+#include "BridgeService.h"
+
+BridgeService::BridgeService(Registry &registry, MqttService &mqtt, const CodecRegistry &codecs,
+                             std::string_view exportTopic, std::string_view importTopic, uint32_t lingerMs)
+        : TService(registry), _mqtt(mqtt), _codecs(codecs), _lingerMs(lingerMs) {
+    registry.getPropsLoader().addConsumer(this);
+    _exportTopic = mqtt.addTopic(exportTopic, 1);
+    mqtt.subscribe(importTopic, 1, [this](std::string_view, std::string_view data) {
+        importBatch(data);
+    });
+}
+
+void BridgeService::setup() {
+    auto &bus = getRegistry().getMessageBus();
+    bus.subscribe(BridgeFlush::ID, this);
+    for (auto id: _exports) {
+        bus.subscribe(id, this);
+    }
+}
+
+void BridgeService::applyProperties(const MqttProperties &props) {
+    _origin = messageKey(props.deviceName);
+}
+
+bool BridgeService::exportId(MsgId id) {
+    if (!_codecs.contains(id)) {
+        esp_loge(bridge, "no codec for 0x%04x", id);
+        return false;
+    }
+    if (std::find(_exports.begin(), _exports.end(), id) == _exports.end()) {
+        HeapScope scope(Heap_Bus);
+        _exports.push_back(id);
+    }
+    return true;
+}
+
+bool BridgeService::importId(MsgId id) {
+    if (!_codecs.contains(id)) {
+        esp_loge(bridge, "no codec for 0x%04x", id);
+        return false;
+    }
+    if (!isImported(id)) {
+        HeapScope scope(Heap_Bus);
+        _imports.push_back(id);
+    }
+    return true;
+}
+
+bool BridgeService::isImported(MsgId id) const {
+    return std::find(_imports.begin(), _imports.end(), id) != _imports.end();
+}
+
+void BridgeService::onMessage(const Message &msg) {
+    switch (msg.getMsgId()) {
+        case BridgeFlush::ID:
+            // a batch filled up and went out since this one was scheduled
+            if (static_cast<const BridgeFlush &>(msg).generation == _generation) {
+                flush();
+            }
+            break;
+        default:
+            if (!_importing) {
+                exportMessage(msg);
+            }
+            break;
+    }
+}
+
+void BridgeService::exportMessage(const Message &msg) {
+    ByteWriter payload(_record, sizeof(_record));
+    if (!_codecs.encode(msg, payload)) {
+        _stats.oversize += payload.overflow();
+        return;
+    }
+
+    uint8_t header[3 + 10];
+    ByteWriter record(header, sizeof(header));
+    record.putVarint(msg.getMsgId());
+    record.putVarint(payload.size());
+    if (HeaderSize + record.size() + payload.size() > MaxBatch) {
+        _stats.oversize++;
+        return;
+    }
+    if (_batchSize + record.size() + payload.size() > MaxBatch) {
+        flush();
+    }
+
+    bool first = !_batchSize;
+    if (first) {
+        ByteWriter batch(_batch, HeaderSize);
+        batch.put(Version);
+        batch.put(_origin);
+        _batchSize = batch.size();
+    }
+    memcpy(_batch + _batchSize, header, record.size());
+    memcpy(_batch + _batchSize + record.size(), payload.data(), payload.size());
+    _batchSize += record.size() + payload.size();
+    _stats.exported++;
+
+    if (!_lingerMs) {
+        flush();
+    } else if (first) {
+        BridgeFlush due;
+        due.generation = _generation;
+        getRegistry().getMessageBus().scheduleMessage(_lingerMs, due);
+    }
+}
+
+void BridgeService::flush() {
+    if (!_batchSize) {
+        return;
+    }
+    if (_mqtt.publish(_exportTopic, std::string_view((const char *) _batch, _batchSize))) {
+        _stats.batchesOut++;
+        _stats.bytesOut += _batchSize;
+    } else {
+        _stats.failed++;
+    }
+    _batchSize = 0;
+    _generation++;
+}
+
+void BridgeService::importBatch(std::string_view data) {
+    ByteReader in((const uint8_t *) data.data(), data.size());
+    auto version = in.get<uint8_t>();
+    auto origin = in.get<uint32_t>();
+    if (in.error() || version != Version) {
+        _stats.rejected++;
+        return;
+    }
+    if (origin == _origin) {
+        _stats.echoes++;
+        return;
+    }
+    _stats.batchesIn++;
+
+    auto &bus = getRegistry().getMessageBus();
+    while (in.remaining()) {
+        auto id = (MsgId) in.getVarint();
+        auto payload = in.getView();
+        if (in.error()) {
+            _stats.rejected++;
+            return;
+        }
+        if (!isImported(id)) {
+            _stats.rejected++;
+            continue;
+        }
+        ByteReader reader((const uint8_t *) payload.data(), payload.size());
+        auto imported = _codecs.decode(id, reader);
+        if (!imported) {
+            _stats.rejected++;
+            continue;
+        }
+        // dispatched in place rather than posted, so the export side can tell it apart
+        _importing = true;
+        bus.sendMessage(*imported);
+        _importing = false;
+        _stats.imported++;
+    }
+}
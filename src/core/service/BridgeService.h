@@ -0,0 +1,115 @@
+#pragma once
+
+#include <vector>
+
+#include "SysService.h"
+#include "MqttService.h"
+#include "core/Codec.h"
+#include "core/Registry.h"
+
+struct BridgeFlush : TMessage<Sys_Bridge_Flush, System::Sys_Core> {
+    uint32_t generation{0};
+};
+
+struct BridgeStats {
+    uint32_t exported{0};
+    uint32_t imported{0};
+    uint32_t batchesOut{0};
+    uint32_t batchesIn{0};
+    uint64_t bytesOut{0};
+    // batches the client refused, not connected yet or outbox full
+    uint32_t failed{0};
+    // our own batches routed back by the broker
+    uint32_t echoes{0};
+    // records of types not imported, or batches that did not decode
+    uint32_t rejected{0};
+    // messages that encoded to more than a batch holds
+    uint32_t oversize{0};
+};
+
+/**
+ * Carries bus messages between devices over MQTT. Exported types are encoded with their
+ * CodecRegistry codec and published to the export topic, batches from the import topic are
+ * decoded and dispatched on the local bus as if they had been posted here. Fleet routing
+ * (which device's export reaches which device's import) is the broker's job.
+ *
+ * A batch is version, origin (the device name hash, little endian uint32) and records of
+ * varint(MsgId), varint(size), payload. Records collect until the batch is full or lingerMs
+ * after the first one, 0 publishes every message on its own.
+ *
+ * Loops are cut three ways: imported messages are not exported again, batches carrying our
+ * own origin are dropped, and only types registered with importType() are accepted.
+ *
+ * Everything runs on the bus task, the import callback too: MqttService hands payloads over
+ * to it (the default), so a batch is decoded straight out of the inbound buffer.
+ */
+class BridgeService
+        : public TService<Sys_Bridge_Service, System::Sys_Core>,
+          public MessageSubscriber,
+          public TPropertiesConsumer<BridgeService, MqttProperties> {
+    static constexpr uint8_t Version = 1;
+    static constexpr size_t HeaderSize = 1 + sizeof(uint32_t);
+    // a published batch still fits a default SharedBuffer pool block
+    static constexpr size_t MaxBatch = SharedBuffer::PoolCapacity;
+
+    MqttService &_mqtt;
+    const CodecRegistry &_codecs;
+    MqttTopicId _exportTopic;
+    uint32_t _lingerMs;
+    uint32_t _origin{0};
+
+    std::vector<MsgId> _exports;
+    std::vector<MsgId> _imports;
+
+    uint8_t _batch[MaxBatch]{};
+    size_t _batchSize{0};
+    uint32_t _generation{0};
+    uint8_t _record[MaxBatch]{};
+    // dispatching an imported message, whatever it triggers synchronously is not exported
+    bool _importing{false};
+
+    BridgeStats _stats;
+private:
+    void exportMessage(const Message &msg);
+
+    void importBatch(std::string_view data);
+
+    [[nodiscard]] bool isImported(MsgId id) const;
+
+public:
+    BridgeService(Registry &registry, MqttService &mqtt, const CodecRegistry &codecs,
+                  std::string_view exportTopic = "/bus/out", std::string_view importTopic = "/bus/in",
+                  uint32_t lingerMs = 20);
+
+    void setup() override;
+
+    void applyProperties(const MqttProperties &props);
+
+    void onMessage(const Message &msg) override;
+
+    /**
+     * False when the type has no codec. Call before setup().
+     */
+    bool exportId(MsgId id);
+
+    bool importId(MsgId id);
+
+    template<typename Msg>
+    bool exportType() {
+        return exportId(Msg::ID);
+    }
+
+    template<typename Msg>
+    bool importType() {
+        return importId(Msg::ID);
+    }
+
+    /**
+     * Publishes the records collected so far.
+     */
+    void flush();
+
+    [[nodiscard]] const BridgeStats &getStats() const {
+        return _stats;
+    }
+};
@@ -0,0 +1,38 @@
+#include "FileService.h"
+
+FileService::FileService(Registry &registry, WorkerService &workers, FileCache &cache)
+        : TService(registry), _workers(workers), _cache(cache) {}
+
+void FileService::setup() {
+    report();
+}
+
+uint32_t FileService::readAsync(std::string_view path) {
+    FixedString<63> name;
+    if (!name.assign(path)) {
+        esp_loge(file, "path too long: %.*s", (int) path.size(), path.data());
+        return 0;
+    }
+    // never 0, that one means refused
+    uint32_t request = ++_requests;
+    if (!request) {
+        request = ++_requests;
+    }
+    bool submitted = _workers.submit([this, request, name]() {
+        HeapScope scope(Heap_File);
+        auto *msg = new FileRead();
+        msg->request = request;
+        msg->path = name;
+        msg->status = _cache.read(name, msg->data);
+        return Message::Ptr(msg);
+    });
+    return submitted ? request : 0;
+}
+
+void FileService::report() const {
+    _cache.forEachStats([]([[maybe_unused]] const FileStats &stats) {
+        esp_logi(file, "%s: %u reads, %u B, blocks %u hit %u missed %u ahead, %u opens, %u us",
+                 stats.path.c_str(), stats.reads, stats.bytes, stats.hits, stats.misses, stats.prefetched,
+                 stats.opens, stats.ioUs);
+    });
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+
+#include "SysService.h"
+#include "WorkerService.h"
+#include "core/FileCache.h"
+#include "core/Registry.h"
+
+/**
+ * A readAsync() completed, subscribe<FileRead>(request, ...) for a single request.
+ */
+struct FileRead : TMessage<Sys_File_Read, System::Sys_Core> {
+    uint32_t request{0};
+    FixedString<63> path;
+    esp_err_t status{ESP_OK};
+    SharedBuffer data;
+
+    [[nodiscard]] uint32_t getKey() const override {
+        return request;
+    }
+};
+
+/**
+ * File access for the bus: reads through a FileCache on a WorkerService task and posts the
+ * content as FileRead, so the bus task never waits on flash. Setup logs what every file read
+ * so far cost, by then the config and the certificates it names are loaded.
+ */
+class FileService : public TService<Sys_File_Service, System::Sys_Core> {
+    WorkerService &_workers;
+    FileCache &_cache;
+    std::atomic<uint32_t> _requests{0};
+public:
+    FileService(Registry &registry, WorkerService &workers, FileCache &cache = files::cache());
+
+    void setup() override;
+
+    /**
+     * The request id FileRead carries, 0 when the path is longer than FileRead::path holds or
+     * every worker slot is taken.
+     */
+    uint32_t readAsync(std::string_view path);
+
+    /**
+     * Logs the FileStats of every file read so far.
+     */
+    void report() const;
+
+    [[nodiscard]] FileCache &getCache() {
+        return _cache;
+    }
+};
@@ -0,0 +1,44 @@
+#include "HeapService.h"
+
+void toJson(const HeapReport &msg, cJSON *json) {
+    cJSON_AddNumberToObject(json, "free", msg.info.freeBytes);
+    cJSON_AddNumberToObject(json, "min-free", msg.info.minFreeBytes);
+    cJSON_AddNumberToObject(json, "largest-block", msg.info.largestFreeBlock);
+    cJSON_AddNumberToObject(json, "fragmentation", msg.info.fragmentation);
+#ifdef CORE_HEAP_TRACE
+    cJSON *tags = cJSON_AddObjectToObject(json, "tags");
+    for (uint8_t tag = 0; tag < Heap_Tag_Max; tag++) {
+        cJSON *item = cJSON_AddObjectToObject(tags, heap::tagName((HeapTag) tag));
+        cJSON_AddNumberToObject(item, "live", msg.tags[tag].liveBytes);
+        cJSON_AddNumberToObject(item, "peak", msg.tags[tag].peakBytes);
+        cJSON_AddNumberToObject(item, "allocs", msg.tags[tag].allocs);
+        cJSON_AddNumberToObject(item, "frees", msg.tags[tag].frees);
+    }
+#endif
+}
+
+HeapService::HeapService(Registry &registry, uint32_t period) : TService(registry), _period(period) {}
+
+void HeapService::makeReport(HeapReport &report) {
+    report.info = heap::info();
+    for (uint8_t tag = 0; tag < Heap_Tag_Max; tag++) {
+        report.tags[tag] = heap::stats((HeapTag) tag);
+    }
+}
+
+void HeapService::setup() {
+    _timer.attach(_period, true, [this]() {
+        HeapReport report;
+        makeReport(report);
+        esp_logd(
+                heap,
+                "free: %u, largest: %u, fragmentation: %u%%",
+                report.info.freeBytes,
+                report.info.largestFreeBlock,
+                report.info.fragmentation
+        );
+
+        // the timer daemon must not wait for a busy bus, a missed report is replaced by the next
+        getRegistry().getMessageBus().tryPostMessage(report);
+    });
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cJSON.h>
+
+#include "SysService.h"
+#include "core/Registry.h"
+
+void toJson(const HeapReport &msg, cJSON *json);
+
+/**
+ * Posts a HeapReport every period: free/largest block/fragmentation of the 8-bit heap and,
+ * with CORE_HEAP_TRACE, live/peak bytes and allocation counts per HeapTag.
+ */
+class HeapService : public TService<Sys_Heap_Service, System::Sys_Core> {
+    SoftwareTimer _timer;
+    uint32_t _period;
+public:
+    explicit HeapService(Registry &registry, uint32_t period = 60000);
+
+    void setup() override;
+
+    static void makeReport(HeapReport &report);
+};
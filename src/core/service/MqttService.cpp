@@ -1,99 +1,211 @@
 #include "MqttService.h"
-#include <LittleFS.h>
+#include "core/FileCache.h"
+#include <algorithm>
+#include <esp_timer.h>
 
-esp_err_t readFile(std::string_view filePath, std::string &result) {
-    if (auto file = LittleFS.open(filePath.data()); file) {
-        result.clear();
-        while (file.available()) {
-            result.append(file.readString().c_str());
+#if __has_include(<esp_idf_version.h>)
+#include <esp_idf_version.h>
+#endif
+
+// esp_mqtt_client_subscribe_multiple came with IDF 5.1, older clients send a packet per topic
+#if defined(ESP_MQTT_FAKE_CLIENT)
+#define MQTT_SUBSCRIBE_MULTIPLE 1
+#elif defined(ESP_IDF_VERSION_VAL)
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 1, 0)
+#define MQTT_SUBSCRIBE_MULTIPLE 1
+#endif
+#endif
+
+// default esp-mqtt out buffer less the fixed header and the packet id
+static constexpr size_t MqttSubscribeBudget = 1024 - 5 - 2;
+
+SharedBuffer printJson(cJSON *json) {
+    auto buffer = SharedBuffer::allocate(SharedBuffer::PoolCapacity);
+    if (cJSON_PrintPreallocated(json, (char *) buffer.mutableData(), (int) buffer.size(), true)) {
+        buffer.resize(strlen((const char *) buffer.data()));
+        return buffer;
+    }
+    char *res = cJSON_Print(json);
+    SharedBuffer result(res);
+    cJSON_free(res);
+    return result;
+}
+
+SharedBuffer JsonDeltaPublisher::encode(uint32_t topicKey, cJSON *json) {
+    HeapScope scope(Heap_Mqtt);
+    auto &state = _topics[topicKey];
+    bool keyframe = !state.last || state.sinceKeyframe + 1 >= _keyframeEvery;
+
+    cJSON *out;
+    if (keyframe) {
+        out = cJSON_Duplicate(json, true);
+        cJSON_AddBoolToObject(out, "_keyframe", true);
+        state.sinceKeyframe = 0;
+    } else {
+        out = cJSON_CreateObject();
+        for (cJSON *item = json->child; item; item = item->next) {
+            cJSON *last = cJSON_GetObjectItemCaseSensitive(state.last, item->string);
+            if (!last || !cJSON_Compare(item, last, true)) {
+                cJSON_AddItemToObject(out, item->string, cJSON_Duplicate(item, true));
+            }
+        }
+        for (cJSON *item = state.last->child; item; item = item->next) {
+            if (!cJSON_GetObjectItemCaseSensitive(json, item->string)) {
+                cJSON_AddNullToObject(out, item->string);
+            }
         }
-        return ESP_OK;
+        state.sinceKeyframe++;
+    }
+
+    cJSON_Delete(state.last);
+    state.last = json;
+    if (!out->child) {
+        cJSON_Delete(out);
+        _stats.unchanged++;
+        return {};
     }
 
-    return ESP_ERR_INVALID_STATE;
+    cJSON_AddNumberToObject(out, "_seq", ++state.seq);
+    auto payload = printJson(out);
+    cJSON_Delete(out);
+    if (keyframe) {
+        _stats.keyframes++;
+    } else {
+        _stats.deltas++;
+    }
+    _stats.bytes += payload.size();
+    return payload;
+}
+
+void JsonDeltaPublisher::reset() {
+    for (auto &entry: _topics) {
+        cJSON_Delete(entry.second.last);
+        entry.second.last = nullptr;
+    }
+}
+
+JsonDeltaPublisher::~JsonDeltaPublisher() {
+    reset();
 }
 
-RabbitMQSign::RabbitMQSign(const MqttProperties &props)
-        : _product(props.productName),
-          _deviceName(props.deviceName),
-          _clientId(props.deviceName),
-          _username(props.username),
-          _password(props.password),
-          _uri(props.uri) {
-    ESP_ERROR_CHECK(readFile(props.caCertFile, _caCert));
-    ESP_ERROR_CHECK(readFile(props.clientCertFile, _clientCert));
-    ESP_ERROR_CHECK(readFile(props.clientKeyFile, _clientKey));
+RabbitMQSign::RabbitMQSign(const MqttProperties &props) : _props(props) {
+    ESP_ERROR_CHECK(files::cache().read(props.caCertFile, _caCert));
+    ESP_ERROR_CHECK(files::cache().read(props.clientCertFile, _clientCert));
+    ESP_ERROR_CHECK(files::cache().read(props.clientKeyFile, _clientKey));
 }
 
-const std::string &RabbitMQSign::product() {
-    return _product;
+std::string_view RabbitMQSign::product() {
+    return _props.productName;
 }
 
-const std::string &RabbitMQSign::deviceName() {
-    return _deviceName;
+std::string_view RabbitMQSign::deviceName() {
+    return _props.deviceName;
 }
 
-const std::string &RabbitMQSign::username() {
-    return _username;
+std::string_view RabbitMQSign::username() {
+    return _props.username;
 }
 
-const std::string &RabbitMQSign::password() {
-    return _password;
+std::string_view RabbitMQSign::password() {
+    return _props.password;
 }
 
-const std::string &RabbitMQSign::clientId() {
-    return _clientId;
+std::string_view RabbitMQSign::clientId() {
+    return _props.deviceName;
 }
 
-const std::string &RabbitMQSign::uri() {
-    return _uri;
+std::string_view RabbitMQSign::uri() {
+    return _props.uri;
 }
 
-const std::string &RabbitMQSign::caCert() {
+std::string_view RabbitMQSign::caCert() {
     return _caCert;
 }
 
-const std::string &RabbitMQSign::clientCert() {
+std::string_view RabbitMQSign::clientCert() {
     return _clientCert;
 }
 
-const std::string &RabbitMQSign::clientKey() {
+std::string_view RabbitMQSign::clientKey() {
     return _clientKey;
 }
 
-MqttService::MqttService(Registry &registry) : TService(registry) {
+MqttService::MqttService(Registry &registry, size_t inboundBlock, size_t inboundBlocks)
+        : TService(registry), _pool(inboundBlock, inboundBlocks, Heap_Mqtt) {
     registry.getPropsLoader().addConsumer(this);
+    // connection state, readable by services that start after it changed
+    auto &bus = registry.getMessageBus();
+    bus.retain<MqttConnected>();
+    bus.retain<MqttDisconnected>();
+    bus.retain<MqttReady>();
 }
 
 void MqttService::setup() {
-    getRegistry().getMessageBus().subscribe(this);
+    auto &bus = getRegistry().getMessageBus();
+    bus.subscribe(this);
+    // posted from the esp-mqtt task without waiting: a payload that finds the bus full is
+    // dropped, connection events are parked in the spill buffer so none of them is lost
+    bus.setOverflowPolicy(MqttInbound::ID, Overflow_DropNewest);
+    bus.setOverflowPolicy(MqttConnected::ID, Overflow_Spill);
+    bus.setOverflowPolicy(MqttReady::ID, Overflow_Spill);
+    bus.setOverflowPolicy(MqttDisconnected::ID, Overflow_Spill);
 }
 
 void MqttService::applyProperties(const MqttProperties &props) {
+    HeapScope scope(Heap_Mqtt);
     _credentials.reset(new RabbitMQSign(props));
-    _topicPrefix = "/" + props.productName + "/" + props.deviceName;
+    _persistentSession = props.persistentSession;
+    std::string prefix;
+    prefix.reserve(props.productName.size() + props.deviceName.size() + 2);
+    prefix.append("/").append(props.productName).append("/").append(props.deviceName);
+    if (prefix == _topicPrefix) {
+        return;
+    }
+    if (_started) {
+        // the esp-mqtt task reads the topic tables without a lock, and the broker holds the
+        // subscriptions of the old prefix
+        esp_logw(mqtt, "topic prefix stays %s, %s applies after a restart", _topicPrefix.c_str(), prefix.c_str());
+        return;
+    }
+    _topicPrefix = prefix;
+    resolveTopics();
+}
+
+void MqttService::resolveTopics() {
+    _handlerIndex.clear();
+    for (size_t idx = 0; idx < _handlers.size(); idx++) {
+        _handlers[idx].path = _topicPrefix + _handlers[idx].topic;
+        _handlerIndex.emplace(messageKey(_handlers[idx].path), idx);
+    }
+    for (auto &topic: _topics) {
+        topic.path = _topicPrefix + topic.topic;
+    }
 }
 
 void MqttService::onMessage(const WifiConnected &) {
-    esp_logi(mqtt, "uri: %s", _credentials->uri().c_str());
-    esp_logi(mqtt, "username: %s", _credentials->username().c_str());
-    esp_logi(mqtt, "client-id: %s", _credentials->clientId().c_str());
+    HeapScope scope(Heap_Mqtt);
+    esp_logi(mqtt, "uri: %s", _credentials->uri().data());
+    esp_logi(mqtt, "username: %s", _credentials->username().data());
+    esp_logi(mqtt, "client-id: %s", _credentials->clientId().data());
 
     const esp_mqtt_client_config_t config{
-            .uri = _credentials->uri().c_str(),
-            .client_id = _credentials->clientId().c_str(),
-            .username = _credentials->username().c_str(),
-            .password = _credentials->password().c_str(),
+            .uri = _credentials->uri().data(),
+            .client_id = _credentials->clientId().data(),
+            .username = _credentials->username().data(),
+            .password = _credentials->password().data(),
+            .disable_clean_session = _persistentSession,
             .keepalive = 60,
             .disable_auto_reconnect = false,
-            .cert_pem = _credentials->caCert().c_str(),
-            .client_cert_pem = _credentials->clientCert().c_str(),
-            .client_key_pem = _credentials->clientKey().c_str(),
+            .cert_pem = _credentials->caCert().data(),
+            .client_cert_pem = _credentials->clientCert().data(),
+            .client_key_pem = _credentials->clientKey().data(),
             .reconnect_timeout_ms = 1000,
             .skip_cert_common_name_check=true,
     };
 
+    _started = true;
     _client = esp_mqtt_client_init(&config);
+    esp_mqtt_client_register_event(_client, MQTT_EVENT_BEFORE_CONNECT, eventCallback, this);
     esp_mqtt_client_register_event(_client, MQTT_EVENT_CONNECTED, eventCallback, this);
     esp_mqtt_client_register_event(_client, MQTT_EVENT_DISCONNECTED, eventCallback, this);
     esp_mqtt_client_register_event(_client, MQTT_EVENT_DATA, eventCallback, this);
@@ -101,22 +213,37 @@ void MqttService::onMessage(const WifiConnected &) {
     esp_mqtt_client_register_event(_client, MQTT_EVENT_SUBSCRIBED, eventCallback, this);
     esp_mqtt_client_register_event(_client, MQTT_EVENT_PUBLISHED, eventCallback, this);
 
+    _connectStartUs = esp_timer_get_time();
     ESP_ERROR_CHECK(esp_mqtt_client_start(_client));
 }
 
 void MqttService::handleMqttEvent(esp_mqtt_event_handle_t event) {
+    HeapScope scope(Heap_Mqtt);
     switch (event->event_id) {
-        case MQTT_EVENT_CONNECTED: {
-            onConnect();
+        case MQTT_EVENT_BEFORE_CONNECT: {
+            _connectStartUs = esp_timer_get_time();
+            break;
+            case MQTT_EVENT_CONNECTED:
+                onConnect(event);
             break;
             case MQTT_EVENT_SUBSCRIBED:
                 esp_logd(mqtt, "SubTopic: msg-id: %d, qos: %d", event->msg_id, event->qos);
+                onSubscribed(event->msg_id);
             break;
             case MQTT_EVENT_PUBLISHED:
                 esp_logd(mqtt, "PubTopic: msg-id: %d, qos: %d", event->msg_id, event->qos);
+                onPublished(event->msg_id);
             break;
             case MQTT_EVENT_DISCONNECTED:
-                getRegistry().getMessageBus().postMessage(MqttDisconnected{});
+                // SUBACKs of a dropped connection never come, the next connect starts over
+                _pendingSubAcks.clear();
+                portENTER_CRITICAL(&_ackLock);
+                for (auto &inflight: _inflight) {
+                    inflight.msgId = 0;
+                }
+                _ackLatencyUs = 0;
+                portEXIT_CRITICAL(&_ackLock);
+                postFromClient(MqttDisconnected{});
             break;
             case MQTT_EVENT_ERROR: {
                 esp_logw(mqtt, "Handled error");
@@ -139,14 +266,8 @@ void MqttService::handleMqttEvent(esp_mqtt_event_handle_t event) {
                 }
             }
             break;
-            case MQTT_EVENT_DATA: {
-                onMessage(
-                        std::string_view(event->topic, event->topic_len),
-                        std::string_view(event->data, event->data_len),
-                        event->current_data_offset,
-                        event->total_data_len
-                );
-            }
+            case MQTT_EVENT_DATA:
+                onData(event);
             break;
             default:
                 break;
@@ -155,66 +276,291 @@ void MqttService::handleMqttEvent(esp_mqtt_event_handle_t event) {
     }
 }
 
-void MqttService::onConnect() {
-    getRegistry().getMessageBus().postMessage(MqttConnected{});
-    for (auto callback : _callbacks) {
-        auto id = esp_mqtt_client_subscribe(_client, callback.first.data(), 0);
+void MqttService::onConnect(esp_mqtt_event_handle_t event) {
+    _ready = MqttReady{};
+    _ready.connectMs = (esp_timer_get_time() - _connectStartUs) / 1000;
+    // a clean session is never present, whatever the broker says
+    _ready.sessionPresent = _persistentSession && event->session_present;
+    _pendingSubAcks.clear();
+
+    MqttConnected connected;
+    connected.sessionPresent = _ready.sessionPresent;
+    postFromClient(connected);
+
+    if (!_ready.sessionPresent) {
+        subscribeAll();
+    }
+    if (_pendingSubAcks.empty()) {
+        postReady();
+    }
+}
+
+void MqttService::subscribeAll() {
+#ifdef MQTT_SUBSCRIBE_MULTIPLE
+    std::vector<esp_mqtt_topic_t> batch;
+    batch.reserve(_handlers.size());
+    size_t bytes = 0;
+    auto flush = [this, &batch, &bytes]() {
+        auto id = esp_mqtt_client_subscribe_multiple(_client, batch.data(), (int) batch.size());
+        if (id < 0) {
+            esp_loge(mqtt, "Sub failed: %d topics from %s", (int) batch.size(), batch.front().filter);
+        } else {
+            esp_logd(mqtt, "Sub: %d topics, msg-id: %d", (int) batch.size(), id);
+            _pendingSubAcks.push_back(id);
+            _ready.topics += batch.size();
+            _ready.packets++;
+        }
+        batch.clear();
+        bytes = 0;
+    };
+    for (auto &handler: _handlers) {
+        // topic length, topic and the requested qos
+        size_t cost = 2 + handler.path.size() + 1;
+        if (!batch.empty() && bytes + cost > MqttSubscribeBudget) {
+            flush();
+        }
+        batch.push_back({handler.path.c_str(), handler.qos});
+        bytes += cost;
+    }
+    if (!batch.empty()) {
+        flush();
+    }
+#else
+    for (auto &handler: _handlers) {
+        auto id = esp_mqtt_client_subscribe(_client, handler.path.c_str(), handler.qos);
         if (id < 0) {
-            esp_loge(mqtt, "Sub failed: %s", callback.first.data());
+            esp_loge(mqtt, "Sub failed: %s", handler.path.c_str());
         } else {
-            esp_logd(mqtt, "Sub topic: %s", callback.first.data());
+            esp_logd(mqtt, "Sub topic: %s", handler.path.c_str());
+            _pendingSubAcks.push_back(id);
+            _ready.topics++;
+            _ready.packets++;
         }
     }
-};
+#endif
+}
 
-void MqttService::onMessage(std::string_view topic, std::string_view payload, size_t offset, size_t total) {
-    std::string topicName(topic.data(), topic.length());
+void MqttService::onSubscribed(int msgId) {
+    auto it = std::find(_pendingSubAcks.begin(), _pendingSubAcks.end(), msgId);
+    if (it == _pendingSubAcks.end()) {
+        return;
+    }
+    _pendingSubAcks.erase(it);
+    if (_pendingSubAcks.empty()) {
+        postReady();
+    }
+}
 
-    auto it = _partitions.end();
-    if (total > payload.size()) {
-        it = _partitions.find(topicName);
-        if (it == _partitions.end()) {
-            std::tie(it, std::ignore) = _partitions.emplace(topicName, payload);
-        } else {
-            it->second.append(payload);
+void MqttService::postReady() {
+    _ready.readyMs = (esp_timer_get_time() - _connectStartUs) / 1000;
+    esp_logi(mqtt, "ready: connect %u ms, subscribed %u ms, %u topics in %u packets, session: %s",
+             _ready.connectMs, _ready.readyMs, _ready.topics, _ready.packets, _ready.sessionPresent ? "resumed" : "new");
+    postFromClient(_ready);
+}
+
+MqttHandlerId MqttService::findHandler(std::string_view path) const {
+    if (auto it = _handlerIndex.find(messageKey(path)); it != _handlerIndex.end() && _handlers[it->second].path == path) {
+        return it->second;
+    }
+    // hash collision, the index only holds the first topic
+    for (size_t idx = 0; idx < _handlers.size(); idx++) {
+        if (_handlers[idx].path == path) {
+            return idx;
+        }
+    }
+    return MqttNoHandler;
+}
+
+void MqttService::onData(esp_mqtt_event_handle_t event) {
+    size_t offset = event->current_data_offset;
+    size_t size = event->data_len;
+    if (!offset) {
+        // a new message, drop whatever a broken transfer left behind
+        _pool.release(_inbound.data);
+        _inbound = InboundState{};
+
+        std::string_view topic(event->topic, event->topic_len);
+        _inbound.handler = findHandler(topic);
+        if (_inbound.handler == MqttNoHandler) {
+            esp_loge(mqtt, "No handle for topic: %.*s", (int) topic.size(), topic.data());
+            return;
         }
-        if (payload.size() + offset < total) {
+        if (!_handoff && size == (size_t) event->total_data_len) {
+            // lend the client's buffer, it stays valid for the duration of the callback
+            HeapScope scope(Heap_User);
+            auto &handler = _handlers[_inbound.handler];
+            handler.callback(handler.path, std::string_view(event->data, size));
+            _inbound = InboundState{};
             return;
         }
+        _inbound.data = _pool.acquire(event->total_data_len);
+        if (!_inbound.data) {
+            _dropped++;
+            esp_logd(mqtt, "inbound pool exhausted, dropped: %.*s", (int) topic.size(), topic.data());
+            return;
+        }
+        _inbound.size = event->total_data_len;
     }
 
-    auto itc = _callbacks.find(topicName);
-    if (itc == _callbacks.end()) {
-        esp_loge(mqtt, "No handle for topic: %s", topicName.data());
-    } else {
-        if (it != _partitions.end()) {
-            itc->second(topicName, it->second);
-            _partitions.erase(it);
-        } else {
-            itc->second(topicName, payload);
+    if (!_inbound.data || offset + size > _inbound.size) {
+        // unknown topic or dropped message
+        return;
+    }
+    memcpy(_inbound.data + offset, event->data, size);
+    if (offset + size < _inbound.size) {
+        return;
+    }
+
+    if (_handoff) {
+        auto *msg = new MqttInbound();
+        msg->handler = _inbound.handler;
+        msg->pool = &_pool;
+        msg->data = _inbound.data;
+        msg->size = _inbound.size;
+        Message::Ptr ptr(msg);
+        // a dropped message gives its buffer back to the pool
+        if (getRegistry().getMessageBus().tryPostMessage(ptr) == Post_Dropped) {
+            _dropped++;
         }
+    } else {
+        HeapScope scope(Heap_User);
+        auto &handler = _handlers[_inbound.handler];
+        handler.callback(handler.path, std::string_view((const char *) _inbound.data, _inbound.size));
+        _pool.release(_inbound.data);
+    }
+    _inbound = InboundState{};
+}
+
+void MqttService::onMessage(const MqttInbound &msg) {
+    if (msg.handler < _handlers.size()) {
+        HeapScope scope(Heap_User);
+        auto &handler = _handlers[msg.handler];
+        handler.callback(handler.path, std::string_view((const char *) msg.data, msg.size));
+    }
+}
+
+void MqttService::onMessage(const MqttMessage &msg) {
+    if (!_client) {
+        return;
+    }
+    if (msg.topicId != MqttNoTopic) {
+        publish(msg.topicId, msg.payload);
+    } else {
+        publish(msg.topic, msg.qos, msg.payload);
     }
 }
 
-void MqttService::subscribe(std::string_view topic, int qos, const MqttDataCallback &callback) {
+MqttHandlerId MqttService::subscribe(std::string_view topic, int qos, const MqttDataCallback &callback) {
+    HeapScope scope(Heap_Mqtt);
     auto topicPath = _topicPrefix;
     topicPath.append(topic);
-    _callbacks.emplace(topicPath, callback);
-//    auto id = esp_mqtt_client_subscribe(_client, topicPath.data(), qos);
-//    if (id < 0) {
-//        esp_loge(mqtt, "Sub failed: %s", topicPath.data());
-//    } else {
-//        esp_logd(mqtt, "Sub topic: %s", topicPath.c_str());
-//    }
+
+    MqttHandlerId id = findHandler(topicPath);
+    if (id != MqttNoHandler) {
+        _handlers[id].qos = qos;
+        _handlers[id].callback = callback;
+        return id;
+    }
+
+    id = _handlers.size();
+    _handlers.push_back(MqttHandler{std::string(topic), topicPath, qos, callback});
+    _handlerIndex.emplace(messageKey(topicPath), id);
+    return id;
+}
+
+MqttTopicId MqttService::addTopic(std::string_view topic, int qos, bool retain) {
+    HeapScope scope(Heap_Mqtt);
+    for (size_t idx = 0; idx < _topics.size(); idx++) {
+        if (_topics[idx].topic == topic) {
+            return idx;
+        }
+    }
+    _topics.push_back(MqttTopic{std::string(topic), _topicPrefix + std::string(topic), qos, retain, {}});
+    return _topics.size() - 1;
+}
+
+bool MqttService::publish(MqttTopicId topic, std::string_view payload) {
+    if (topic >= _topics.size() || !_client) {
+        return false;
+    }
+    auto &entry = _topics[topic];
+    auto id = esp_mqtt_client_publish(_client, entry.path.c_str(), payload.data(), (int) payload.size(), entry.qos, entry.retain);
+    if (id < 0) {
+        entry.stats.failed++;
+        esp_logd(mqtt, "Pub failed: %s:%d", entry.path.c_str(), id);
+        return false;
+    }
+    trackPublish(id);
+    entry.stats.published++;
+    entry.stats.bytes += payload.size();
+    entry.stats.maxPayload = std::max<uint32_t>(entry.stats.maxPayload, payload.size());
+    return true;
+}
+
+const MqttTopicStats *MqttService::getTopicStats(MqttTopicId topic) const {
+    return topic < _topics.size() ? &_topics[topic].stats : nullptr;
 }
 
 void MqttService::publish(std::string_view topic, int qos, std::string_view payload) {
+    HeapScope scope(Heap_Mqtt);
     auto topicPath = _topicPrefix;
     topicPath.append(topic);
 
     esp_logd(mqtt, "Pub: topic: %s, payload: %d", topicPath.c_str(), payload.size());
-    auto id = esp_mqtt_client_publish(_client, topicPath.data(), payload.data(), (int) payload.size(), 0, false);
+    auto id = esp_mqtt_client_publish(_client, topicPath.data(), payload.data(), (int) payload.size(), qos, false);
     if (id < 0) {
         esp_logd(mqtt, "Pub failed: %s:%d", topicPath.data(), id);
+    } else {
+        trackPublish(id);
+    }
+}
+
+int MqttService::getOutboxSize() const {
+    return _client ? esp_mqtt_client_get_outbox_size(_client) : 0;
+}
+
+void MqttService::trackPublish(int msgId) {
+    // QoS 0 has no ack and no id
+    if (msgId <= 0) {
+        return;
+    }
+    auto now = esp_timer_get_time();
+    portENTER_CRITICAL(&_ackLock);
+    // with every slot taken the oldest publishes already tell the latency
+    for (auto &inflight: _inflight) {
+        if (!inflight.msgId) {
+            inflight.msgId = msgId;
+            inflight.sentUs = now;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&_ackLock);
+}
+
+void MqttService::onPublished(int msgId) {
+    auto now = esp_timer_get_time();
+    portENTER_CRITICAL(&_ackLock);
+    for (auto &inflight: _inflight) {
+        if (inflight.msgId == msgId) {
+            auto latency = now - inflight.sentUs;
+            // first ack sets it, then a quarter of every new one
+            _ackLatencyUs = _ackLatencyUs ? _ackLatencyUs + (latency - _ackLatencyUs) / 4 : latency;
+            inflight.msgId = 0;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&_ackLock);
+}
+
+uint32_t MqttService::getAckLatencyMs() const {
+    auto now = esp_timer_get_time();
+    portENTER_CRITICAL(&_ackLock);
+    auto latency = _ackLatencyUs;
+    for (auto &inflight: _inflight) {
+        if (inflight.msgId) {
+            latency = std::max(latency, now - inflight.sentUs);
+        }
     }
+    portEXIT_CRITICAL(&_ackLock);
+    return (uint32_t) (latency / 1000);
 }
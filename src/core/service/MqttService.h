@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <string>
 #include <unordered_map>
 
@@ -8,40 +9,41 @@
 #include "SysService.h"
 #include "core/Registry.h"
 
+/**
+ * Values are NUL terminated and go to esp-mqtt as C strings.
+ */
 class IotCredentials {
 public:
     typedef std::unique_ptr<IotCredentials> Ptr;
 
-    virtual const std::string &product() = 0;
+    virtual std::string_view product() = 0;
 
-    virtual const std::string &deviceName() = 0;
+    virtual std::string_view deviceName() = 0;
 
-    virtual const std::string &username() = 0;
+    virtual std::string_view username() = 0;
 
-    virtual const std::string &password() = 0;
+    virtual std::string_view password() = 0;
 
-    virtual const std::string &clientId() = 0;
+    virtual std::string_view clientId() = 0;
 
-    virtual const std::string &uri() = 0;
+    virtual std::string_view uri() = 0;
 
-    virtual const std::string &caCert() = 0;
+    virtual std::string_view caCert() = 0;
 
 
-    virtual const std::string &clientCert() = 0;
+    virtual std::string_view clientCert() = 0;
 
-    virtual const std::string &clientKey() = 0;
+    virtual std::string_view clientKey() = 0;
 
     virtual ~IotCredentials() = default;
 };
 
 
+/**
+ * Points into the loaded MqttProperties, only the certificates read from files are owned here.
+ */
 class RabbitMQSign : public IotCredentials {
-    std::string _product;
-    std::string _deviceName;
-    std::string _username;
-    std::string _password;
-    std::string _clientId;
-    std::string _uri;
+    const MqttProperties &_props;
 
     std::string _caCert;
     std::string _clientCert;
@@ -49,79 +51,299 @@ class RabbitMQSign : public IotCredentials {
 public:
     RabbitMQSign(const MqttProperties &props);
 
-    const std::string &product() override;
+    std::string_view product() override;
 
-    const std::string &deviceName() override;
+    std::string_view deviceName() override;
 
-    const std::string &username() override;
+    std::string_view username() override;
 
-    const std::string &password() override;
+    std::string_view password() override;
 
-    const std::string &clientId() override;
+    std::string_view clientId() override;
 
-    const std::string &uri() override;
+    std::string_view uri() override;
 
-    const std::string &caCert() override;
+    std::string_view caCert() override;
 
-    const std::string &clientKey() override;
+    std::string_view clientKey() override;
 
-    const std::string &clientCert() override;
+    std::string_view clientCert() override;
 };
 
 typedef std::function<void(std::string_view, std::string_view)> MqttDataCallback;
 
 
+/**
+ * Parses data into a new E, empty when data is not JSON. The parse half of recvJsonMqttMsg,
+ * for a WorkerService job that hands the message back to the bus.
+ */
 template<typename E>
-void recvJsonMqttMsg(MessageBus &bus, std::string_view data) {
+Message::Ptr parseJsonMqttMsg(std::string_view data) {
+    HeapScope scope(Heap_Mqtt);
     auto json = cJSON_ParseWithLength(data.data(), data.length());
-    if (json) {
-        auto event = new E();
-        fromJson(json, *event);
-        cJSON_Delete(json);
-        std::unique_ptr<Message> msg(event);
+    if (!json) {
+        return {};
+    }
+    auto event = new E();
+    fromJson(json, *event);
+    cJSON_Delete(json);
+    return Message::Ptr(event);
+}
+
+template<typename E>
+void recvJsonMqttMsg(MessageBus &bus, std::string_view data) {
+    if (auto msg = parseJsonMqttMsg<E>(data)) {
         bus.postMessage(msg);
     }
 }
 
+/**
+ * Prints json straight into a pooled SharedBuffer, falls back to cJSON_Print when it does not fit.
+ */
+SharedBuffer printJson(cJSON *json);
+
 template<typename Msg>
-void sendJsonMqttMsg(MessageBus &bus, std::string_view topic, const Msg& msg) {
+std::unique_ptr<MqttMessage> printJsonMqttMsg(const Msg& msg) {
+    HeapScope scope(Heap_Mqtt);
     cJSON* json = cJSON_CreateObject();
     toJson(msg, json);
-    const char* res = cJSON_Print(json);
-    auto mqttMessage = new MqttMessage();
+    std::unique_ptr<MqttMessage> mqttMessage(new MqttMessage());
+    mqttMessage->payload = printJson(json);
+    cJSON_Delete(json);
+    return mqttMessage;
+}
+
+/**
+ * The print half of sendJsonMqttMsg, an MqttMessage ready to post.
+ */
+template<typename Msg>
+Message::Ptr makeJsonMqttMsg(std::string_view topic, const Msg& msg) {
+    auto mqttMessage = printJsonMqttMsg(msg);
     mqttMessage->topic = topic;
-    mqttMessage->payload = res;
-    std::unique_ptr<Message> mqtt(mqttMessage);
+    return Message::Ptr(mqttMessage.release());
+}
+
+template<typename Msg>
+Message::Ptr makeJsonMqttMsg(MqttTopicId topic, const Msg& msg) {
+    auto mqttMessage = printJsonMqttMsg(msg);
+    mqttMessage->topicId = topic;
+    return Message::Ptr(mqttMessage.release());
+}
+
+template<typename Msg>
+void sendJsonMqttMsg(MessageBus &bus, std::string_view topic, const Msg& msg) {
+    auto mqtt = makeJsonMqttMsg(topic, msg);
     bus.postMessage(mqtt);
-    cJSON_free((void*)res);
-    cJSON_Delete(json);
 }
 
+template<typename Msg>
+void sendJsonMqttMsg(MessageBus &bus, MqttTopicId topic, const Msg& msg) {
+    auto mqtt = makeJsonMqttMsg(topic, msg);
+    bus.postMessage(mqtt);
+}
+
+struct DeltaPublishStats {
+    uint32_t keyframes{0};
+    uint32_t deltas{0};
+    // nothing changed since the last publish, nothing sent
+    uint32_t unchanged{0};
+    uint64_t bytes{0};
+};
+
+/**
+ * Change-only JSON publishing on top of the toJson() hooks. Per topic it keeps the last state
+ * sent and publishes only the top-level fields that changed since, a removed field as null.
+ * Every keyframeEvery-th message, the first one and the first after reset() carry the full
+ * state. Each publish carries "_seq", one up per publish on that topic, keyframes also
+ * "_keyframe": true, so the receiver can spot a gap and wait for the next keyframe. A message
+ * that changes nothing is not published and takes no sequence number.
+ *
+ * Not thread safe, publish a topic from one task (the bus task or a single worker).
+ */
+class JsonDeltaPublisher {
+    struct TopicState {
+        cJSON *last{nullptr};
+        uint32_t seq{0};
+        uint32_t sinceKeyframe{0};
+    };
+
+    std::unordered_map<uint32_t, TopicState> _topics;
+    uint32_t _keyframeEvery;
+    DeltaPublishStats _stats;
+private:
+    /**
+     * Takes json, empty when there is nothing to publish.
+     */
+    SharedBuffer encode(uint32_t topicKey, cJSON *json);
+
+    template<typename Msg>
+    SharedBuffer encode(uint32_t topicKey, const Msg &msg) {
+        HeapScope scope(Heap_Mqtt);
+        cJSON *json = cJSON_CreateObject();
+        toJson(msg, json);
+        return encode(topicKey, json);
+    }
+
+public:
+    explicit JsonDeltaPublisher(uint32_t keyframeEvery = 60) : _keyframeEvery(keyframeEvery ? keyframeEvery : 1) {}
+
+    JsonDeltaPublisher(const JsonDeltaPublisher &) = delete;
+
+    JsonDeltaPublisher &operator=(const JsonDeltaPublisher &) = delete;
+
+    /**
+     * Empty when msg changed nothing.
+     */
+    template<typename Msg>
+    Message::Ptr make(std::string_view topic, const Msg &msg) {
+        auto payload = encode(messageKey(topic), msg);
+        if (payload.empty()) {
+            return {};
+        }
+        auto mqttMessage = new MqttMessage();
+        mqttMessage->topic = topic;
+        mqttMessage->payload = std::move(payload);
+        return Message::Ptr(mqttMessage);
+    }
+
+    template<typename Msg>
+    Message::Ptr make(MqttTopicId topic, const Msg &msg) {
+        auto payload = encode(topic, msg);
+        if (payload.empty()) {
+            return {};
+        }
+        auto mqttMessage = new MqttMessage();
+        mqttMessage->topicId = topic;
+        mqttMessage->payload = std::move(payload);
+        return Message::Ptr(mqttMessage);
+    }
+
+    template<typename Topic, typename Msg>
+    void send(MessageBus &bus, Topic topic, const Msg &msg) {
+        if (auto mqtt = make(topic, msg)) {
+            bus.postMessage(mqtt);
+        }
+    }
+
+    /**
+     * Next publish of every topic is a keyframe, e.g. after a reconnect.
+     */
+    void reset();
+
+    [[nodiscard]] const DeltaPublishStats &getStats() const {
+        return _stats;
+    }
+
+    ~JsonDeltaPublisher();
+};
+
+struct MqttTopicStats {
+    uint32_t published{0};
+    uint32_t failed{0};
+    uint64_t bytes{0};
+    uint32_t maxPayload{0};
+};
+
 class MqttService
         : public TService<Sys_Mqtt_Service, System::Sys_Core>,
-          public TMessageSubscriber<MqttService, WifiConnected>,
+          public TMessageSubscriber<MqttService, WifiConnected, MqttInbound, MqttMessage>,
           public TPropertiesConsumer<MqttService, MqttProperties> {
 private:
+    // topic as registered, path with the current prefix
+    struct MqttHandler {
+        std::string topic;
+        std::string path;
+        int qos;
+        MqttDataCallback callback;
+    };
+
+    struct MqttTopic {
+        std::string topic;
+        std::string path;
+        int qos;
+        bool retain;
+        MqttTopicStats stats;
+    };
+
+    // message being reassembled on the esp-mqtt task, only the first fragment carries the topic
+    struct InboundState {
+        MqttHandlerId handler{MqttNoHandler};
+        uint8_t *data{nullptr};
+        size_t size{0};
+    };
+
     esp_mqtt_client_handle_t _client{};
+    // set before the client starts, from then on the prefix and topic paths stay as they are
+    std::atomic<bool> _started{false};
     std::string _topicPrefix{};
 
     IotCredentials::Ptr _credentials{};
 
-    std::unordered_map<std::string, std::string> _partitions;
-    std::unordered_map<std::string, MqttDataCallback> _callbacks;
+    // registered before the client starts, read-only on the esp-mqtt task afterwards
+    std::vector<MqttHandler> _handlers;
+    std::unordered_map<uint32_t, MqttHandlerId> _handlerIndex;
+    std::vector<MqttTopic> _topics;
+
+    BufferPool _pool;
+    InboundState _inbound;
+    bool _handoff{true};
+    uint32_t _dropped{0};
+
+    // connect bookkeeping, touched on the esp-mqtt task only
+    bool _persistentSession{false};
+    int64_t _connectStartUs{0};
+    std::vector<int> _pendingSubAcks;
+    MqttReady _ready;
+
+    // QoS 1/2 publishes waiting for their ack, added on the bus task and acked on the esp-mqtt task
+    struct InflightPublish {
+        int msgId{0};
+        int64_t sentUs{0};
+    };
+    static constexpr size_t InflightTracked = 16;
+    InflightPublish _inflight[InflightTracked]{};
+    int64_t _ackLatencyUs{0};
+    mutable portMUX_TYPE _ackLock = portMUX_INITIALIZER_UNLOCKED;
 private:
 
     static void eventCallback(void *event_handler_arg, esp_event_base_t group, int32_t id, void *event_data) {
         ((MqttService *) event_handler_arg)->handleMqttEvent((esp_mqtt_event_handle_t) event_data);
     }
 
-    void onConnect();
-    void onMessage(std::string_view topic, std::string_view payload, size_t offset, size_t total);
+    void onConnect(esp_mqtt_event_handle_t event);
+
+    void subscribeAll();
+
+    void onSubscribed(int msgId);
+
+    void postReady();
+
+    // the esp-mqtt task never waits for room on the bus, keepalives and acks come first
+    template<typename T>
+    void postFromClient(const T &msg) {
+        if (getRegistry().getMessageBus().tryPostMessage(msg) == Post_Dropped) {
+            _dropped++;
+        }
+    }
+
+    void trackPublish(int msgId);
+
+    void onPublished(int msgId);
+
+    MqttHandlerId findHandler(std::string_view path) const;
+
+    void resolveTopics();
+
+    void onData(esp_mqtt_event_handle_t event);
 
     void handleMqttEvent(esp_mqtt_event_handle_t event);
 
 public:
-    explicit MqttService(Registry &registry);;
+    /**
+     * Inbound payloads up to inboundBlock bytes are copied into one of inboundBlocks pooled
+     * buffers, larger ones come from the heap.
+     */
+    explicit MqttService(Registry &registry, size_t inboundBlock = 1024, size_t inboundBlocks = 4);
 
     void setup() override;
 
@@ -129,7 +351,63 @@ public:
 
     void onMessage(const WifiConnected &);
 
-    void subscribe(std::string_view topic, int qos, const MqttDataCallback &callback);
+    void onMessage(const MqttInbound &msg);
+
+    void onMessage(const MqttMessage &msg);
+
+    /**
+     * With handoff (the default) callbacks run on the bus task and the esp-mqtt task only copies
+     * the payload, so keepalive and acks are never held up by a handler. Without it callbacks run
+     * on the esp-mqtt task and single fragment payloads are lent without a copy.
+     */
+    void setHandoff(bool handoff) {
+        _handoff = handoff;
+    }
+
+    /**
+     * Inbound messages and connection events dropped on the esp-mqtt task: every pooled buffer
+     * was in flight, or the bus had no room for them.
+     */
+    [[nodiscard]] uint32_t getDroppedCount() const {
+        return _dropped;
+    }
+
+    [[nodiscard]] const BufferPool &getInboundPool() const {
+        return _pool;
+    }
 
+    /**
+     * Call before the connection comes up, the handler table is read lock-free by the esp-mqtt task.
+     * On every connect the topics go out in as few SUBSCRIBE packets as the client allows, none
+     * when a persistent session was resumed; MqttReady follows the last SUBACK.
+     */
+    MqttHandlerId subscribe(std::string_view topic, int qos, const MqttDataCallback &callback);
+
+    /**
+     * Resolves prefix + topic once, the returned id publishes without building or hashing
+     * strings. It follows prefix changes from the config until the client starts, a later one
+     * applies after a restart. Registering a topic twice returns the first id and keeps its
+     * settings.
+     */
+    MqttTopicId addTopic(std::string_view topic, int qos = 0, bool retain = false);
+
+    bool publish(MqttTopicId topic, std::string_view payload);
+
+    [[nodiscard]] const MqttTopicStats *getTopicStats(MqttTopicId topic) const;
+
+    /**
+     * Bytes esp-mqtt holds for sending or awaiting an ack, zero before the client exists.
+     */
+    [[nodiscard]] int getOutboxSize() const;
+
+    /**
+     * Smoothed publish-to-ack time of QoS 1/2 publishes, or the age of the oldest one still
+     * unacked when that is longer, so a stalled link shows before any ack arrives.
+     */
+    [[nodiscard]] uint32_t getAckLatencyMs() const;
+
+    /**
+     * Builds the topic path on every call, prefer addTopic for anything published repeatedly.
+     */
     void publish(std::string_view topic, int qos, std::string_view payload);
 };
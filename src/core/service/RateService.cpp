@@ -0,0 +1,117 @@
+#include <algorithm>
+
+#include "RateService.h"
+
+RateService::RateService(Registry &registry, MqttService &mqtt) : TService(registry), _mqtt(mqtt) {
+    registry.getPropsLoader().addConsumer(this);
+    applyProperties(RateProperties{});
+    for (auto &bucket: _buckets) {
+        bucket.tokens = bucket.burst;
+    }
+}
+
+void RateService::setup() {
+    getRegistry().getMessageBus().subscribe(this);
+    _started = true;
+    _timer.attach(_tickMs, true, [this]() {
+        tick();
+    });
+}
+
+void RateService::applyProperties(const RateProperties &props) {
+    portENTER_CRITICAL(&_lock);
+    for (uint8_t cls = 0; cls < Rate_Class_Max; cls++) {
+        auto &bucket = _buckets[cls];
+        auto &config = props.classes[cls];
+        bucket.rate = std::max(0.0f, config.rate);
+        bucket.burst = (uint32_t) (std::max(1.0f, config.burst) * TokenScale);
+        bucket.minScale = std::clamp(config.minScale, 0.0f, 1.0f);
+        bucket.tokens = std::min(bucket.tokens, bucket.burst);
+    }
+    _outboxTarget = props.outboxTarget;
+    _ackTargetMs = props.ackTargetMs;
+    _recoverStep = props.recoverStep;
+    portEXIT_CRITICAL(&_lock);
+
+    if (props.tickMs && props.tickMs != _tickMs) {
+        _tickMs = props.tickMs;
+        if (_started) {
+            _timer.attach(_tickMs, true, [this]() {
+                tick();
+            });
+        }
+    }
+}
+
+void RateService::onMessage(const MqttConnected &) {
+    portENTER_CRITICAL(&_lock);
+    _connected = true;
+    portEXIT_CRITICAL(&_lock);
+}
+
+void RateService::onMessage(const MqttDisconnected &) {
+    portENTER_CRITICAL(&_lock);
+    _connected = false;
+    _congested = false;
+    // the outbox drains after a reconnect, come back from the floor
+    _scale = 0;
+    portEXIT_CRITICAL(&_lock);
+}
+
+bool RateService::tryAcquire(RateClass cls, uint32_t cost) {
+    cost *= TokenScale;
+    portENTER_CRITICAL(&_lock);
+    auto &bucket = _buckets[cls];
+    bool granted = _connected && bucket.tokens >= cost;
+    if (granted) {
+        bucket.tokens -= cost;
+        bucket.stats.granted++;
+    } else {
+        bucket.stats.denied++;
+    }
+    portEXIT_CRITICAL(&_lock);
+    return granted;
+}
+
+void RateService::tick() {
+    auto outbox = (uint32_t) std::max(0, _mqtt.getOutboxSize());
+    auto ackMs = _mqtt.getAckLatencyMs();
+
+    portENTER_CRITICAL(&_lock);
+    // nothing saved up while down, a reconnect does not start with a burst
+    if (_connected) {
+        _congested = outbox > _outboxTarget || ackMs > _ackTargetMs;
+        if (_congested) {
+            _scale /= 2;
+            _congestedTicks++;
+        } else {
+            _scale = std::min(1.0f, _scale + _recoverStep);
+        }
+        for (auto &bucket: _buckets) {
+            auto refill = (uint32_t) (bucket.rate * std::max(bucket.minScale, _scale) * (float) _tickMs);
+            bucket.tokens = std::min(bucket.burst, bucket.tokens + refill);
+        }
+    }
+    portEXIT_CRITICAL(&_lock);
+}
+
+float RateService::getScale() const {
+    portENTER_CRITICAL(&_lock);
+    auto scale = _scale;
+    portEXIT_CRITICAL(&_lock);
+    return scale;
+}
+
+bool RateService::isCongested() const {
+    portENTER_CRITICAL(&_lock);
+    auto congested = _congested;
+    portEXIT_CRITICAL(&_lock);
+    return congested;
+}
+
+RateClassStats RateService::getStats(RateClass cls) const {
+    portENTER_CRITICAL(&_lock);
+    auto stats = _buckets[cls].stats;
+    portEXIT_CRITICAL(&_lock);
+    return stats;
+}
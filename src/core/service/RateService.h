@@ -0,0 +1,90 @@
+#pragma once
+
+#include "SysService.h"
+#include "MqttService.h"
+#include "core/Registry.h"
+
+struct RateClassStats {
+    uint32_t granted{0};
+    uint32_t denied{0};
+};
+
+/**
+ * Publish budgets for producers that would otherwise publish on a fixed timer. Every class of
+ * RateClass has a token bucket, a producer calls tryAcquire() before it publishes and skips
+ * the publish when it is refused.
+ *
+ * Every tick looks at the MQTT outbox and the ack latency: above either target the link is
+ * congested and the shared rate scale halves, otherwise it grows by recoverStep back to full
+ * rate. A class refills at rate * max(minScale, scale), so with the default minScale control
+ * is never slowed, state down to half and telemetry down to a tenth. Nothing is granted while
+ * MQTT is down, and after a reconnect the rate ramps up again from the floor.
+ *
+ * Rates, bursts and targets come from the "rate" config section. tryAcquire() can be called
+ * from any task.
+ */
+class RateService
+        : public TService<Sys_Rate_Service, System::Sys_Core>,
+          public TMessageSubscriber<RateService, MqttConnected, MqttDisconnected>,
+          public TPropertiesConsumer<RateService, RateProperties> {
+    // whole tokens are 1000, refills stay exact at low rates and short ticks
+    static constexpr uint32_t TokenScale = 1000;
+
+    struct Bucket {
+        uint32_t tokens{0};
+        uint32_t burst{0};
+        float rate{0};
+        float minScale{0};
+        RateClassStats stats;
+    };
+
+    MqttService &_mqtt;
+    Bucket _buckets[Rate_Class_Max];
+    uint32_t _tickMs{250};
+    uint32_t _outboxTarget{4096};
+    uint32_t _ackTargetMs{1000};
+    float _recoverStep{0.05f};
+
+    float _scale{1};
+    bool _connected{false};
+    bool _congested{false};
+    uint32_t _congestedTicks{0};
+    bool _started{false};
+    SoftwareTimer _timer;
+    // tryAcquire() comes from any task, ticks from the timer task
+    mutable portMUX_TYPE _lock = portMUX_INITIALIZER_UNLOCKED;
+public:
+    RateService(Registry &registry, MqttService &mqtt);
+
+    void setup() override;
+
+    void applyProperties(const RateProperties &props);
+
+    void onMessage(const MqttConnected &msg);
+
+    void onMessage(const MqttDisconnected &msg);
+
+    /**
+     * Takes cost publishes from the class budget, false (and nothing taken) when the budget
+     * is short or MQTT is down.
+     */
+    bool tryAcquire(RateClass cls, uint32_t cost = 1);
+
+    /**
+     * Samples the link and refills the buckets, runs every tickMs.
+     */
+    void tick();
+
+    /**
+     * Share of the full rate the throttled classes get, 0 to 1.
+     */
+    [[nodiscard]] float getScale() const;
+
+    [[nodiscard]] bool isCongested() const;
+
+    [[nodiscard]] uint32_t getCongestedTicks() const {
+        return _congestedTicks;
+    }
+
+    [[nodiscard]] RateClassStats getStats(RateClass cls) const;
+};
@@ -0,0 +1,88 @@
+#include "SysService.h"
+#include "core/Codec.h"
+
+void addSystemCodecs(CodecRegistry &codecs) {
+    codecs.add<WifiConnected>([](const WifiConnected &msg, ByteWriter &out) {
+        out.putString(msg.ip);
+        out.putString(msg.gw);
+        out.putString(msg.mask);
+        out.putString(msg.mac);
+        out.put(msg.channel);
+        out.put(msg.fastConnect);
+        out.putVarint(msg.associateMs);
+        out.putVarint(msg.dhcpMs);
+        out.putVarint(msg.totalMs);
+        out.put(msg.attempts);
+    }, [](ByteReader &in, WifiConnected &msg) {
+        msg.ip = in.getView();
+        msg.gw = in.getView();
+        msg.mask = in.getView();
+        msg.mac = in.getView();
+        msg.channel = in.get<uint8_t>();
+        msg.fastConnect = in.get<bool>();
+        msg.associateMs = in.getVarint();
+        msg.dhcpMs = in.getVarint();
+        msg.totalMs = in.getVarint();
+        msg.attempts = in.get<uint8_t>();
+    });
+    codecs.add<WifiDisconnected>([](const WifiDisconnected &msg, ByteWriter &out) {
+        out.put(msg.reason);
+    }, [](ByteReader &in, WifiDisconnected &msg) {
+        msg.reason = in.get<uint8_t>();
+    });
+    codecs.add<MqttConnected>([](const MqttConnected &msg, ByteWriter &out) {
+        out.put(msg.sessionPresent);
+    }, [](ByteReader &in, MqttConnected &msg) {
+        msg.sessionPresent = in.get<bool>();
+    });
+    codecs.add<MqttReady>([](const MqttReady &msg, ByteWriter &out) {
+        out.putVarint(msg.connectMs);
+        out.putVarint(msg.readyMs);
+        out.putVarint(msg.topics);
+        out.putVarint(msg.packets);
+        out.put(msg.sessionPresent);
+    }, [](ByteReader &in, MqttReady &msg) {
+        msg.connectMs = in.getVarint();
+        msg.readyMs = in.getVarint();
+        msg.topics = in.getVarint();
+        msg.packets = in.getVarint();
+        msg.sessionPresent = in.get<bool>();
+    });
+    codecs.add<MqttDisconnected>([](const MqttDisconnected &msg, ByteWriter &out) {
+        out.put<int32_t>(msg.reason);
+    }, [](ByteReader &in, MqttDisconnected &msg) {
+        msg.reason = in.get<int32_t>();
+    });
+    codecs.add<MqttMessage>([](const MqttMessage &msg, ByteWriter &out) {
+        out.putString(msg.topic);
+        out.putString(msg.payload);
+        out.put<uint8_t>(msg.qos);
+        out.putVarint(msg.topicId);
+    }, [](ByteReader &in, MqttMessage &msg) {
+        msg.topic = in.getView();
+        msg.payload = in.getView();
+        msg.qos = in.get<uint8_t>();
+        msg.topicId = in.getVarint();
+    });
+    codecs.add<TelemetrySummary>([](const TelemetrySummary &msg, ByteWriter &out) {
+        out.putString(msg.metric);
+        out.putVarint(msg.windowMs);
+        out.putVarint(msg.count);
+        out.put(msg.min);
+        out.put(msg.max);
+        out.put(msg.mean);
+        out.put(msg.p50);
+        out.put(msg.p90);
+        out.put(msg.p99);
+    }, [](ByteReader &in, TelemetrySummary &msg) {
+        msg.metric = in.getView();
+        msg.windowMs = in.getVarint();
+        msg.count = in.getVarint();
+        msg.min = in.get<float>();
+        msg.max = in.get<float>();
+        msg.mean = in.get<float>();
+        msg.p50 = in.get<float>();
+        msg.p90 = in.get<float>();
+        msg.p99 = in.get<float>();
+    });
+}
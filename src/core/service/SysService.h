@@ -4,10 +4,20 @@
 
 #pragma once
 #include "core/MessageBus.h"
+#include "core/Heap.h"
+#include "core/BufferPool.h"
+#include "core/SharedBuffer.h"
+#include "core/FixedString.h"
 
 enum SystemServiceId {
     Sys_Wifi_Service,
     Sys_Mqtt_Service,
+    Sys_Heap_Service,
+    Sys_Worker_Service,
+    Sys_Telemetry_Service,
+    Sys_Bridge_Service,
+    Sys_Rate_Service,
+    Sys_File_Service,
 };
 
 enum SystemMessage {
@@ -16,13 +26,31 @@ enum SystemMessage {
     Sys_Mqtt_Connected,
     Sys_Mqtt_Disconnected,
     Sys_Mqtt_Message,
+    Sys_Heap_Report,
+    Sys_Mqtt_Inbound,
+    Sys_Telemetry_Sample,
+    Sys_Telemetry_Summary,
+    Sys_Mqtt_Ready,
+    Sys_Bridge_Flush,
+    Sys_File_Read,
+    Sys_Telemetry_Flush,
 };
 
 struct WifiConnected : TMessage<Sys_Wifi_Connected, System::Sys_Core> {
-    std::string ip;
-    std::string gw;
-    std::string mask;
-    std::string mac;
+    // dotted quads and a colon separated MAC, inline so retaining and posting never allocate
+    FixedString<15> ip;
+    FixedString<15> gw;
+    FixedString<15> mask;
+    FixedString<17> mac;
+    uint8_t channel{0};
+    // went straight to the cached BSSID/channel without a scan
+    bool fastConnect{false};
+    // begin (or link loss) to associated, covers scan, association and the WPA handshake
+    uint32_t associateMs{0};
+    // associated to IP, zero with a static address
+    uint32_t dhcpMs{0};
+    uint32_t totalMs{0};
+    uint8_t attempts{0};
 };
 
 struct WifiDisconnected : TMessage<Sys_Wifi_Disconnected, System::Sys_Core> {
@@ -30,14 +58,127 @@ struct WifiDisconnected : TMessage<Sys_Wifi_Disconnected, System::Sys_Core> {
 };
 
 struct MqttConnected : TMessage<Sys_Mqtt_Connected, System::Sys_Core> {
+    // the broker kept the persistent session, subscriptions included
+    bool sessionPresent{false};
+};
+
+/**
+ * Every subscription of a (re)connect is acknowledged, inbound topics are live from here on.
+ */
+struct MqttReady : TMessage<Sys_Mqtt_Ready, System::Sys_Core> {
+    // connect attempt to CONNACK
+    uint32_t connectMs{0};
+    // connect attempt to the last SUBACK, equals connectMs when nothing was subscribed
+    uint32_t readyMs{0};
+    uint16_t topics{0};
+    // SUBSCRIBE packets sent, zero when the session was resumed
+    uint16_t packets{0};
+    bool sessionPresent{false};
 };
 
 struct MqttDisconnected : TMessage<Sys_Mqtt_Disconnected, System::Sys_Core> {
     int reason;
 };
 
+typedef uint16_t MqttTopicId;
+
+static const MqttTopicId MqttNoTopic = 0xffff;
+
+/**
+ * Published by MqttService under its topic prefix. Copies of the message share topic and payload.
+ * A topicId from MqttService::addTopic takes precedence over topic and qos.
+ */
 struct MqttMessage : TMessage<Sys_Mqtt_Message, System::Sys_Core> {
-    std::string topic;
-    std::string payload;
-    int qos;
-};
\ No newline at end of file
+    SharedBuffer topic;
+    SharedBuffer payload;
+    int qos{0};
+    MqttTopicId topicId{MqttNoTopic};
+
+    // subscribe<MqttMessage>(messageKey(topic), ...) for a single topic
+    [[nodiscard]] uint32_t getKey() const override {
+        return messageKey(topic);
+    }
+};
+
+typedef uint16_t MqttHandlerId;
+
+static const MqttHandlerId MqttNoHandler = 0xffff;
+
+/**
+ * Payload copied off the esp-mqtt task into a pooled buffer, the buffer goes back to its pool
+ * together with the message.
+ */
+struct MqttInbound : TMessage<Sys_Mqtt_Inbound, System::Sys_Core> {
+    MqttHandlerId handler{MqttNoHandler};
+    BufferPool *pool{nullptr};
+    uint8_t *data{nullptr};
+    size_t size{0};
+
+    MqttInbound() = default;
+
+    MqttInbound(const MqttInbound &) = delete;
+
+    MqttInbound &operator=(const MqttInbound &) = delete;
+
+    ~MqttInbound() override {
+        if (pool) {
+            pool->release(data);
+        }
+    }
+};
+
+struct HeapReport : TMessage<Sys_Heap_Report, System::Sys_Core> {
+    HeapInfo info;
+    HeapTagStats tags[Heap_Tag_Max];
+
+    [[nodiscard]] bool isConflated() const override {
+        return true;
+    }
+};
+/**
+ * One reading of a numeric metric, TelemetryService turns a window of them into a summary.
+ */
+struct TelemetrySample : TMessage<Sys_Telemetry_Sample, System::Sys_Core> {
+    // static storage (a literal), copies of the sample keep pointing at it
+    const char *metric{""};
+    float value{0};
+
+    [[nodiscard]] uint32_t getKey() const override {
+        return messageKey(metric);
+    }
+};
+
+struct TelemetrySummary : TMessage<Sys_Telemetry_Summary, System::Sys_Core> {
+    // longer metric names are cut
+    FixedString<31> metric;
+    uint32_t windowMs{0};
+    uint32_t count{0};
+    float min{0};
+    float max{0};
+    float mean{0};
+    // estimates, exact up to five samples
+    float p50{0};
+    float p90{0};
+    float p99{0};
+};
+
+/**
+ * Inline payload (bytes past the Message header) of the core messages above, checked at compile
+ * time. A field that outgrows its budget, or a std::string slipping back in, fails the build here.
+ */
+template<typename Msg, size_t Payload>
+constexpr bool fitsInline = sizeof(Msg) <= sizeof(Message) + Payload;
+
+static_assert(fitsInline<WifiConnected, 88>, "WifiConnected outgrew its inline budget");
+static_assert(fitsInline<WifiDisconnected, 8>, "WifiDisconnected outgrew its inline budget");
+static_assert(fitsInline<MqttConnected, 8>, "MqttConnected outgrew its inline budget");
+static_assert(fitsInline<MqttReady, 16>, "MqttReady outgrew its inline budget");
+static_assert(fitsInline<MqttDisconnected, 8>, "MqttDisconnected outgrew its inline budget");
+static_assert(fitsInline<TelemetrySummary, 72>, "TelemetrySummary outgrew its inline budget");
+
+class CodecRegistry;
+
+/**
+ * Binary codecs for the core messages above, for bus traces and bridges.
+ */
+void addSystemCodecs(CodecRegistry &codecs);
@@ -0,0 +1,111 @@
+#include "TelemetryService.h"
+
+void toJson(const TelemetrySample &msg, cJSON *json) {
+    cJSON_AddStringToObject(json, "metric", msg.metric);
+    cJSON_AddNumberToObject(json, "value", msg.value);
+}
+
+void toJson(const TelemetrySummary &msg, cJSON *json) {
+    cJSON_AddStringToObject(json, "metric", msg.metric.c_str());
+    cJSON_AddNumberToObject(json, "window-ms", msg.windowMs);
+    cJSON_AddNumberToObject(json, "count", msg.count);
+    cJSON_AddNumberToObject(json, "min", msg.min);
+    cJSON_AddNumberToObject(json, "max", msg.max);
+    cJSON_AddNumberToObject(json, "mean", msg.mean);
+    cJSON_AddNumberToObject(json, "p50", msg.p50);
+    cJSON_AddNumberToObject(json, "p90", msg.p90);
+    cJSON_AddNumberToObject(json, "p99", msg.p99);
+}
+
+TelemetryService::TelemetryService(Registry &registry) : TService(registry) {
+    registry.getPropsLoader().addConsumer(this);
+}
+
+void TelemetryService::setup() {
+    getRegistry().getMessageBus().subscribe(this);
+    _started = true;
+    startTimer();
+}
+
+void TelemetryService::startTimer() {
+    // the timer daemon must not wait for the bus, a lost tick only makes one window longer
+    _timer.attach(_windowMs, true, [this]() {
+        getRegistry().getMessageBus().tryPostMessage(TelemetryFlush{});
+    });
+}
+
+void TelemetryService::applyProperties(const TelemetryProperties &props) {
+    portENTER_CRITICAL(&_lock);
+    _configured = props.metricCount > 0;
+    _slotCount = props.metricCount;
+    for (uint8_t idx = 0; idx < TelemetryMaxMetrics; idx++) {
+        _slots[idx].metric = idx < props.metricCount ? props.metrics[idx] : std::string_view();
+        _slots[idx].window.reset();
+    }
+    portEXIT_CRITICAL(&_lock);
+
+    if (props.windowMs && props.windowMs != _windowMs) {
+        _windowMs = props.windowMs;
+        if (_started) {
+            startTimer();
+        }
+    }
+}
+
+// with _lock held
+TelemetryService::Slot *TelemetryService::find(std::string_view metric) {
+    for (uint8_t idx = 0; idx < _slotCount; idx++) {
+        if (_slots[idx].metric == metric) {
+            return &_slots[idx];
+        }
+    }
+    if (_configured || _slotCount == TelemetryMaxMetrics) {
+        return nullptr;
+    }
+    auto *slot = &_slots[_slotCount++];
+    slot->metric = metric;
+    return slot;
+}
+
+void TelemetryService::onMessage(const TelemetrySample &msg) {
+    portENTER_CRITICAL(&_lock);
+    if (auto *slot = find(msg.metric)) {
+        slot->window.add(msg.value);
+    } else {
+        _ignored++;
+    }
+    portEXIT_CRITICAL(&_lock);
+}
+
+void TelemetryService::onMessage(const TelemetryFlush &) {
+    flush();
+}
+
+void TelemetryService::flush() {
+    // a window at a time: one on the stack and one copy per critical section
+    for (uint8_t idx = 0; idx < TelemetryMaxMetrics; idx++) {
+        MetricWindow window;
+        TelemetrySummary summary;
+        portENTER_CRITICAL(&_lock);
+        bool closed = idx < _slotCount && _slots[idx].window.count;
+        if (closed) {
+            summary.metric = _slots[idx].metric;
+            window = _slots[idx].window;
+            _slots[idx].window.reset();
+        }
+        portEXIT_CRITICAL(&_lock);
+        if (!closed) {
+            continue;
+        }
+        summary.windowMs = _windowMs;
+        summary.count = window.count;
+        summary.min = window.min;
+        summary.max = window.max;
+        summary.mean = window.mean();
+        summary.p50 = window.p50.value();
+        summary.p90 = window.p90.value();
+        summary.p99 = window.p99.value();
+        // the bus task can not wait for its own queue, TelemetrySummary spills in the app
+        getRegistry().getMessageBus().tryPostMessage(summary);
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cJSON.h>
+
+#include "SysService.h"
+#include "core/Registry.h"
+#include "core/Telemetry.h"
+
+void toJson(const TelemetrySample &msg, cJSON *json);
+
+void toJson(const TelemetrySummary &msg, cJSON *json);
+
+struct TelemetryFlush : TMessage<Sys_Telemetry_Flush, System::Sys_Core> {
+};
+
+/**
+ * Aggregates TelemetrySample per metric and posts one TelemetrySummary per metric and window
+ * instead of every sample. Metrics and window length come from the "telemetry" config
+ * section, memory is fixed at TelemetryMaxMetrics windows.
+ */
+class TelemetryService
+        : public TService<Sys_Telemetry_Service, System::Sys_Core>,
+          public TMessageSubscriber<TelemetryService, TelemetrySample, TelemetryFlush>,
+          public TPropertiesConsumer<TelemetryService, TelemetryProperties> {
+    struct Slot {
+        // the configured name, or the sample's own string when nothing is configured
+        std::string_view metric;
+        MetricWindow window;
+    };
+
+    Slot _slots[TelemetryMaxMetrics];
+    uint8_t _slotCount{0};
+    bool _configured{false};
+    uint32_t _windowMs{60000};
+    uint32_t _ignored{0};
+    bool _started{false};
+    SoftwareTimer _timer;
+    // samples arrive and windows close on the bus task, a reload may reset them from another
+    portMUX_TYPE _lock = portMUX_INITIALIZER_UNLOCKED;
+private:
+    Slot *find(std::string_view metric);
+
+    void startTimer();
+
+public:
+    explicit TelemetryService(Registry &registry);
+
+    void setup() override;
+
+    void onMessage(const TelemetrySample &msg);
+
+    void onMessage(const TelemetryFlush &msg);
+
+    void applyProperties(const TelemetryProperties &props);
+
+    /**
+     * Closes the current window, posts a summary for every metric that had samples. Runs on the
+     * bus task, the window timer only posts a TelemetryFlush.
+     */
+    void flush();
+
+    /**
+     * Samples of metrics that are not configured, or that found every window taken.
+     */
+    [[nodiscard]] uint32_t getIgnoredCount() const {
+        return _ignored;
+    }
+};
@@ -2,45 +2,206 @@
 // Created by Ivan Kishchenko on 07/08/2023.
 //
 
+#include <LittleFS.h>
 #include "WifiService.h"
 
+static const char *WIFI_CACHE_FILE = "/wifi-cache.bin";
+static const uint32_t WIFI_CACHE_MAGIC = 0x57464331;
+static const uint32_t WIFI_RETRY_DELAY = 1000;
+
+static uint32_t elapsedMs(int64_t from, int64_t to) {
+    return (uint32_t) ((to - from) / 1000);
+}
+
 WifiService::WifiService(Registry &registry) : TService(registry) {
     registry.getPropsLoader().addConsumer(this);
+    // address and link state, readable by services that start after it changed
+    registry.getMessageBus().retain<WifiConnected>();
+    registry.getMessageBus().retain<WifiDisconnected>();
+}
+
+bool WifiService::loadCache() {
+    if (File file = LittleFS.open(WIFI_CACHE_FILE); file) {
+        WifiCache cache;
+        bool valid = file.read((uint8_t *) &cache, sizeof(cache)) == sizeof(cache);
+        file.close();
+        if (valid && cache.magic == WIFI_CACHE_MAGIC && cache.ssidHash == messageKey(_props->ssid)) {
+            _cache = cache;
+            return true;
+        }
+    }
+    return false;
+}
+
+void WifiService::saveCache() {
+    WifiCache cache = _cache;
+    cache.magic = WIFI_CACHE_MAGIC;
+    cache.ssidHash = messageKey(_props->ssid);
+    if (_props->ip.empty()) {
+        cache.ip = WiFi.localIP();
+        cache.gateway = WiFi.gatewayIP();
+        cache.mask = WiFi.subnetMask();
+        cache.dns = WiFi.dnsIP();
+    }
+
+    WifiCache stored;
+    if (File file = LittleFS.open(WIFI_CACHE_FILE); file) {
+        bool same = file.read((uint8_t *) &stored, sizeof(stored)) == sizeof(stored) && !memcmp(&stored, &cache, sizeof(cache));
+        file.close();
+        if (same) {
+            // nothing changed, spare the flash
+            return;
+        }
+    }
+
+    if (File file = LittleFS.open(WIFI_CACHE_FILE, FILE_WRITE); file) {
+        file.write((const uint8_t *) &cache, sizeof(cache));
+        file.close();
+        _cache = cache;
+    }
+}
+
+void WifiService::applyAddress(bool fast) {
+    if (!_props->ip.empty()) {
+        IPAddress ip, gateway, mask, dns;
+        ip.fromString(_props->ip.data());
+        gateway.fromString(_props->gateway.data());
+        mask.fromString(_props->mask.data());
+        dns.fromString((_props->dns.empty() ? _props->gateway : _props->dns).data());
+        WiFi.config(ip, gateway, mask, dns);
+    } else if (fast && _props->reuseLease && _cache.ip) {
+        WiFi.config(IPAddress(_cache.ip), IPAddress(_cache.gateway), IPAddress(_cache.mask), IPAddress(_cache.dns));
+    } else {
+        // back to DHCP
+        WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE);
+    }
+}
+
+void WifiService::connectFast() {
+    esp_logi(wifi, "fast connect, channel: %d", _cache.channel);
+    _phase = Wifi_Fast;
+    _fastConnect = true;
+    _attempts++;
+    applyAddress(true);
+    WiFi.begin(_props->ssid.data(), _props->password.data(), _cache.channel, _cache.bssid, true);
+    _fallback.attach(_props->fastConnectTimeout, false, [this]() {
+        uint8_t expected = Wifi_Fast;
+        if (_phase.compare_exchange_strong(expected, Wifi_Scan)) {
+            esp_logw(wifi, "fast connect timed out");
+            connectScan();
+        }
+    });
+}
+
+void WifiService::connectScan() {
+    esp_logi(wifi, "scan connect");
+    _phase = Wifi_Scan;
+    _fastConnect = false;
+    _attempts++;
+    applyAddress(false);
+    WiFi.begin(_props->ssid.data(), _props->password.data());
+}
+
+void WifiService::onConnected(const arduino_event_info_t &info) {
+    _associatedUs = esp_timer_get_time();
+    _fallback.detach();
+    memcpy(_cache.bssid, info.wifi_sta_connected.bssid, sizeof(_cache.bssid));
+    _cache.channel = info.wifi_sta_connected.channel;
+}
+
+void WifiService::onGotIp() {
+    _phase = Wifi_Connected;
+    auto now = esp_timer_get_time();
+
+    WifiConnected msg;
+    msg.ip = WiFi.localIP().toString().c_str();
+    msg.mask = WiFi.subnetMask().toString().c_str();
+    msg.gw = WiFi.gatewayIP().toString().c_str();
+    msg.mac = WiFi.macAddress().c_str();
+    msg.channel = _cache.channel;
+    msg.fastConnect = _fastConnect;
+    msg.associateMs = elapsedMs(_startUs, _associatedUs);
+    msg.dhcpMs = elapsedMs(_associatedUs, now);
+    msg.totalMs = elapsedMs(_startUs, now);
+    msg.attempts = _attempts;
+
+    esp_logi(wifi, "Connected");
+    esp_logi(wifi, "IP address: %s/%s", msg.ip.c_str(), msg.mask.c_str());
+    esp_logi(wifi, "GW address: %s", msg.gw.c_str());
+    esp_logi(wifi, "MAC address: %s", msg.mac.c_str());
+    esp_logi(
+            wifi,
+            "%s connect: associate %u ms, dhcp %u ms, total %u ms, attempts %u",
+            msg.fastConnect ? "fast" : "scan", msg.associateMs, msg.dhcpMs, msg.totalMs, msg.attempts
+    );
+
+    saveCache();
+    getRegistry().getMessageBus().postMessage(msg);
+}
+
+void WifiService::onDisconnected(const arduino_event_info_t &info) {
+    WifiDisconnected msg;
+    msg.reason = info.wifi_sta_disconnected.reason;
+    getRegistry().getMessageBus().postMessage(msg);
+
+    uint8_t phase = _phase;
+    if (phase == Wifi_Connected) {
+        esp_logi(wifi, "Lost connection");
+        // time the reconnect the same way as the first connect
+        _startUs = esp_timer_get_time();
+        _attempts = 0;
+        if (_props->fastConnect && _cache.channel) {
+            connectFast();
+        } else {
+            connectScan();
+        }
+    } else if (phase == Wifi_Fast) {
+        if (_phase.compare_exchange_strong(phase, Wifi_Scan)) {
+            esp_logw(wifi, "fast connect failed, reason: %d", msg.reason);
+            _fallback.detach();
+            connectScan();
+        }
+    } else if (phase == Wifi_Scan) {
+        _fallback.attach(WIFI_RETRY_DELAY, false, [this]() {
+            if (_phase == Wifi_Scan) {
+                _attempts++;
+                WiFi.begin();
+            }
+        });
+    }
 }
 
 void WifiService::applyProperties(const WifiProperties &props) {
-    esp_logi(wifi, "SSID: %s", props.ssid.c_str());
-    WiFi.mode(WIFI_AP);
+    esp_logi(wifi, "SSID: %s", props.ssid.data());
+    _props = &props;
+
+    // station only, the AP interface is never used and slows down the connect
+    WiFi.mode(WIFI_STA);
+    // the cache below replaces the driver's own NVS copy of the credentials
+    WiFi.persistent(false);
+    // reconnects are driven from onDisconnected so they can take the fast path
+    WiFi.setAutoReconnect(false);
     WiFi.onEvent([this](arduino_event_id_t event, arduino_event_info_t info) {
         switch (event) {
-            case ARDUINO_EVENT_WIFI_STA_GOT_IP: {
-                WifiConnected msg;
-                msg.ip = WiFi.localIP().toString().c_str();
-                msg.mask = WiFi.subnetMask().toString().c_str();
-                msg.gw = WiFi.gatewayIP().toString().c_str();
-                msg.mac = WiFi.macAddress().c_str();
-
-                esp_logi(wifi, "Connected");
-                esp_logi(wifi, "IP address: %s/%s", msg.ip.c_str(), msg.mask.c_str());
-                esp_logi(wifi, "GW address: %s", msg.gw.c_str());
-                esp_logi(wifi, "MAC address: %s", msg.mac.c_str());
-
-                getRegistry().getMessageBus().postMessage(msg);
-            }
+            case ARDUINO_EVENT_WIFI_STA_GOT_IP:
+                onGotIp();
                 break;
             case ARDUINO_EVENT_WIFI_STA_CONNECTED:
+                onConnected(info);
                 break;
-            case ARDUINO_EVENT_WIFI_STA_DISCONNECTED: {
-                esp_logi(wifi, "Lost connection");
-                WifiDisconnected msg;
-                msg.reason = info.wifi_sta_disconnected.reason;
-                getRegistry().getMessageBus().postMessage(msg);
-            }
+            case ARDUINO_EVENT_WIFI_STA_DISCONNECTED:
+                onDisconnected(info);
                 break;
             default:
                 break;
         }
     });
-    WiFi.setAutoReconnect(true);
-    WiFi.begin(props.ssid.c_str(), props.password.c_str());
+
+    _startUs = esp_timer_get_time();
+    _attempts = 0;
+    if (props.fastConnect && loadCache()) {
+        connectFast();
+    } else {
+        connectScan();
+    }
 }
@@ -4,12 +4,65 @@
 
 #pragma once
 
+#include <atomic>
 #include <WiFi.h>
 #include "SysService.h"
 #include "core/Registry.h"
 #include "core/Properties.h"
+#include "core/Timer.h"
+
+/**
+ * Last successful association, kept on LittleFS so a reboot can skip the scan.
+ */
+struct WifiCache {
+    uint32_t magic{0};
+    uint32_t ssidHash{0};
+    uint8_t bssid[6]{};
+    uint8_t channel{0};
+    uint8_t reserved{0};
+    uint32_t ip{0};
+    uint32_t gateway{0};
+    uint32_t mask{0};
+    uint32_t dns{0};
+};
 
 class WifiService : public TService<Sys_Wifi_Service, System::Sys_Core>, public TPropertiesConsumer<WifiService, WifiProperties> {
+    enum Phase : uint8_t {
+        Wifi_Idle,
+        Wifi_Fast,
+        Wifi_Scan,
+        Wifi_Connected,
+    };
+
+    // owned by the properties loader
+    const WifiProperties *_props{nullptr};
+    WifiCache _cache;
+    EspTimer _fallback;
+
+    std::atomic<uint8_t> _phase{Wifi_Idle};
+    // written by the fallback timer (esp_timer task) and the Wi-Fi event task
+    std::atomic<bool> _fastConnect{false};
+    std::atomic<uint8_t> _attempts{0};
+    int64_t _startUs{0};
+    int64_t _associatedUs{0};
+
+private:
+    bool loadCache();
+
+    void saveCache();
+
+    void applyAddress(bool fast);
+
+    void connectFast();
+
+    void connectScan();
+
+    void onConnected(const arduino_event_info_t &info);
+
+    void onGotIp();
+
+    void onDisconnected(const arduino_event_info_t &info);
+
 public:
     explicit WifiService(Registry &registry);
 
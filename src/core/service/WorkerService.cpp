@@ -0,0 +1,129 @@
+#include <cstdio>
+#include <esp_timer.h>
+
+#include "WorkerService.h"
+
+WorkerService::WorkerService(Registry &registry, uint8_t workers, uint8_t slots, uint32_t stackSize, UBaseType_t priority)
+        : TService(registry), _stackSize(stackSize), _priority(priority) {
+    HeapScope scope(Heap_User);
+    _slots.resize(slots ? slots : 1);
+    _workers.resize(workers ? workers : 1);
+    _free = xQueueCreate(_slots.size(), sizeof(uint8_t));
+    _work = xQueueCreate(_slots.size() + _workers.size(), sizeof(uint8_t));
+    _stopped = xSemaphoreCreateBinary();
+    for (uint8_t idx = 0; idx < _slots.size(); idx++) {
+        xQueueSendToBack(_free, &idx, 0);
+    }
+    for (uint8_t idx = 0; idx < _workers.size(); idx++) {
+        _workers[idx].service = this;
+        _workers[idx].index = idx;
+    }
+}
+
+void WorkerService::setup() {
+    _startUs = esp_timer_get_time();
+    for (auto &worker: _workers) {
+        char name[16];
+        snprintf(name, sizeof(name), "worker%u", worker.index);
+        if (xTaskCreate(run, name, _stackSize, &worker, _priority, nullptr) != pdPASS) {
+            esp_loge(worker, "%s: task not created", name);
+            continue;
+        }
+        _running++;
+    }
+}
+
+void WorkerService::run(void *arg) {
+    auto &worker = *static_cast<Worker *>(arg);
+    auto *service = worker.service;
+    uint8_t slot;
+    while (xQueueReceive(service->_work, &slot, portMAX_DELAY) == pdPASS && slot != StopSlot) {
+        service->execute(worker, slot);
+    }
+    xSemaphoreGive(service->_stopped);
+    vTaskDelete(nullptr);
+}
+
+void WorkerService::execute(Worker &worker, uint8_t slot) {
+    HeapScope scope(Heap_User);
+    auto start = esp_timer_get_time();
+    Message::Ptr result = _slots[slot]();
+    _slots[slot] = nullptr;
+    xQueueSendToBack(_free, &slot, 0);
+    if (result) {
+        getRegistry().getMessageBus().postMessage(result);
+    }
+
+    auto elapsed = (uint32_t) (esp_timer_get_time() - start);
+    portENTER_CRITICAL(&_statsLock);
+    worker.stats.jobs++;
+    worker.stats.busyUs += elapsed;
+    if (elapsed > worker.stats.maxJobUs) {
+        worker.stats.maxJobUs = elapsed;
+    }
+    portEXIT_CRITICAL(&_statsLock);
+}
+
+bool WorkerService::submit(Job &&job) {
+    uint8_t slot;
+    if (xQueueReceive(_free, &slot, 0) != pdPASS) {
+        portENTER_CRITICAL(&_statsLock);
+        uint32_t rejected = ++_rejected;
+        portEXIT_CRITICAL(&_statsLock);
+        // a burst rejects jobs by the hundred, the callers see false and getRejectedCount() keeps the total
+        if (rejected == 1 || rejected % 100 == 0) {
+            esp_logd(worker, "all %u slots busy, %u jobs dropped so far", (unsigned) _slots.size(), rejected);
+        }
+        return false;
+    }
+    {
+        HeapScope scope(Heap_User);
+        _slots[slot] = std::move(job);
+    }
+    portENTER_CRITICAL(&_statsLock);
+    _submitted++;
+    portEXIT_CRITICAL(&_statsLock);
+    // never blocks, the queue has room for every slot
+    xQueueSendToBack(_work, &slot, 0);
+    return true;
+}
+
+WorkerStats WorkerService::getStats(uint8_t worker) {
+    if (worker >= _workers.size()) {
+        return {};
+    }
+    portENTER_CRITICAL(&_statsLock);
+    WorkerStats stats = _workers[worker].stats;
+    portEXIT_CRITICAL(&_statsLock);
+    auto uptime = esp_timer_get_time() - _startUs;
+    if (_running && uptime > 0) {
+        stats.utilisation = (uint8_t) std::min<uint64_t>(100, stats.busyUs * 100 / uptime);
+    }
+    return stats;
+}
+
+uint32_t WorkerService::getSubmittedCount() {
+    portENTER_CRITICAL(&_statsLock);
+    uint32_t count = _submitted;
+    portEXIT_CRITICAL(&_statsLock);
+    return count;
+}
+
+uint32_t WorkerService::getRejectedCount() {
+    portENTER_CRITICAL(&_statsLock);
+    uint32_t count = _rejected;
+    portEXIT_CRITICAL(&_statsLock);
+    return count;
+}
+
+WorkerService::~WorkerService() {
+    // queued jobs run first, then one worker at a time takes a stop and leaves
+    for (uint8_t idx = 0; idx < _running; idx++) {
+        uint8_t stop = StopSlot;
+        xQueueSendToBack(_work, &stop, portMAX_DELAY);
+        xSemaphoreTake(_stopped, portMAX_DELAY);
+    }
+    vSemaphoreDelete(_stopped);
+    vQueueDelete(_work);
+    vQueueDelete(_free);
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+#include "SysService.h"
+#include "core/Registry.h"
+
+struct WorkerStats {
+    uint32_t jobs{0};
+    uint64_t busyUs{0};
+    uint32_t maxJobUs{0};
+    // busy share of the time since setup, percent
+    uint8_t utilisation{0};
+};
+
+/**
+ * Runs heavy handlers (JSON parsing and printing, file reads) on its own worker tasks so the
+ * bus task keeps dispatching. A job returns the message it produced, the worker posts it to
+ * the bus. Jobs live in a fixed set of slots: with all of them queued or running submit()
+ * refuses the job instead of growing, which bounds the memory held by pending work.
+ */
+class WorkerService : public TService<Sys_Worker_Service, System::Sys_Core> {
+public:
+    typedef std::function<Message::Ptr()> Job;
+private:
+    static constexpr uint8_t StopSlot = 0xff;
+
+    struct Worker {
+        WorkerService *service;
+        uint8_t index;
+        WorkerStats stats;
+    };
+
+    std::vector<Job> _slots;
+    std::vector<Worker> _workers;
+    // slot indexes, free ones and the ones waiting for a worker
+    QueueHandle_t _free;
+    QueueHandle_t _work;
+    SemaphoreHandle_t _stopped;
+    uint32_t _stackSize;
+    UBaseType_t _priority;
+    uint8_t _running{0};
+    int64_t _startUs{0};
+
+    uint32_t _submitted{0};
+    uint32_t _rejected{0};
+    portMUX_TYPE _statsLock = portMUX_INITIALIZER_UNLOCKED;
+private:
+    static void run(void *arg);
+
+    void execute(Worker &worker, uint8_t slot);
+
+public:
+    explicit WorkerService(Registry &registry, uint8_t workers = 1, uint8_t slots = 8, uint32_t stackSize = 4096, UBaseType_t priority = 1);
+
+    WorkerService(const WorkerService &) = delete;
+
+    WorkerService &operator=(const WorkerService &) = delete;
+
+    void setup() override;
+
+    /**
+     * False when every slot is taken, the job is dropped and counted as rejected.
+     */
+    bool submit(Job &&job);
+
+    /**
+     * Subscribes handler to Msg on the bus, each message is copied into a job. The message a
+     * handler returns is posted back to the bus, return nothing for fire and forget work.
+     */
+    template<typename Msg>
+    MessageSubscriber *offload(const std::function<Message::Ptr(const Msg &msg)> &handler) {
+        MessageBus &bus = getRegistry().getMessageBus();
+        return bus.subscribe<Msg>([this, handler](const Msg &msg) {
+            submit([handler, msg]() {
+                return handler(msg);
+            });
+        });
+    }
+
+    [[nodiscard]] uint8_t getWorkerCount() const {
+        return (uint8_t) _workers.size();
+    }
+
+    [[nodiscard]] WorkerStats getStats(uint8_t worker);
+
+    [[nodiscard]] uint32_t getSubmittedCount();
+
+    [[nodiscard]] uint32_t getRejectedCount();
+
+    /**
+     * Jobs queued or running.
+     */
+    [[nodiscard]] size_t getInFlight() const {
+        return _slots.size() - uxQueueMessagesWaiting(_free);
+    }
+
+    ~WorkerService() override;
+};
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <deque>
+
+#include "core/MessageBus.h"
+#include "VirtualClock.h"
+
+/**
+ * TMessageBus backend on a VirtualClock: a plain FIFO that never blocks and timers that fire
+ * from VirtualClock::advance(). A post that would wait forever grows the queue past its nominal
+ * length instead of blocking the only thread, getHighWater() tells how deep a real queue would
+ * have had to be. Any shorter wait fails at once, as a real queue would once the wait runs out.
+ */
+class SimBusBackend {
+    VirtualClock &_clock;
+    std::deque<void *> _queue;
+    size_t _length{0};
+    size_t _highWater{0};
+    uint32_t _overflows{0};
+public:
+    static constexpr bool Simulated = true;
+
+    explicit SimBusBackend(VirtualClock &clock = sim::clock()) : _clock(clock) {}
+
+    void create(size_t length) {
+        _length = length;
+    }
+
+    explicit operator bool() const {
+        return _length != 0;
+    }
+
+    bool send(void *item, TickType_t wait) {
+        if (_queue.size() >= _length && wait != portMAX_DELAY) {
+            return false;
+        }
+        _queue.push_back(item);
+        _highWater = std::max(_highWater, _queue.size());
+        if (_queue.size() > _length) {
+            _overflows++;
+        }
+        return true;
+    }
+
+    bool sendFromISR(void *item, BaseType_t *woken) {
+        if (_queue.size() >= _length) {
+            return false;
+        }
+        *woken = pdFALSE;
+        return send(item, 0);
+    }
+
+    bool receive(void *&item, TickType_t) {
+        if (_queue.empty()) {
+            return false;
+        }
+        item = _queue.front();
+        _queue.pop_front();
+        return true;
+    }
+
+    [[nodiscard]] TickType_t now() const {
+        return pdMS_TO_TICKS(_clock.nowMs());
+    }
+
+    Timer *createTimer() {
+        return new VirtualTimer(_clock);
+    }
+
+    VirtualClock &getClock() {
+        return _clock;
+    }
+
+    [[nodiscard]] size_t getHighWater() const {
+        return _highWater;
+    }
+
+    /**
+     * Posts that would have blocked on a real queue of the nominal length.
+     */
+    [[nodiscard]] uint32_t getOverflowCount() const {
+        return _overflows;
+    }
+};
+
+template<size_t queueSize = 10, size_t conflateSize = 8, size_t pendingSize = 8>
+using TSimMessageBus = TMessageBus<queueSize, conflateSize, pendingSize, 4, 64, SimBusBackend>;
+
+namespace sim {
+    /**
+     * Dispatches everything bus has queued whenever clock moves.
+     */
+    inline void attach(VirtualClock &clock, MessageBus &bus) {
+        clock.addPump([&bus]() {
+            bus.loop();
+        });
+    }
+}
@@ -0,0 +1,100 @@
+#include <algorithm>
+#include "VirtualClock.h"
+
+void VirtualClock::arm(VirtualTimer *timer) {
+    timer->_sequence = ++_sequence;
+    if (!timer->_armed) {
+        timer->_armed = true;
+        _timers.push_back(timer);
+    }
+}
+
+void VirtualClock::disarm(VirtualTimer *timer) {
+    if (timer->_armed) {
+        timer->_armed = false;
+        _timers.erase(std::find(_timers.begin(), _timers.end(), timer));
+    }
+}
+
+VirtualTimer *VirtualClock::next(uint64_t until) {
+    VirtualTimer *found = nullptr;
+    for (auto *timer: _timers) {
+        if (timer->_dueUs > until) {
+            continue;
+        }
+        // same deadline: the one armed first fires first
+        if (!found || timer->_dueUs < found->_dueUs || (timer->_dueUs == found->_dueUs && timer->_sequence < found->_sequence)) {
+            found = timer;
+        }
+    }
+    return found;
+}
+
+void VirtualClock::pump() {
+    for (auto &pump: _pumps) {
+        pump();
+    }
+}
+
+void VirtualClock::addPump(const std::function<void()> &pump) {
+    _pumps.push_back(pump);
+}
+
+void VirtualClock::advance(uint64_t milliseconds) {
+    advanceUs(milliseconds * 1000);
+}
+
+void VirtualClock::advanceUs(uint64_t microseconds) {
+    uint64_t until = _nowUs + microseconds;
+    while (auto *timer = next(until)) {
+        _nowUs = timer->_dueUs;
+        if (timer->_periodUs) {
+            timer->_dueUs += timer->_periodUs;
+            arm(timer);
+        } else {
+            disarm(timer);
+        }
+        _fired++;
+        // the callback may delete its own timer, as the bus does for one shot timers
+        timer->_callback();
+        pump();
+    }
+    _nowUs = until;
+    pump();
+}
+
+bool VirtualClock::step() {
+    auto *timer = next(UINT64_MAX);
+    if (!timer) {
+        return false;
+    }
+    advanceUs(timer->_dueUs - _nowUs);
+    return true;
+}
+
+VirtualClock::~VirtualClock() {
+    for (auto *timer: _timers) {
+        timer->_armed = false;
+    }
+}
+
+VirtualClock &sim::clock() {
+    static VirtualClock clock;
+    return clock;
+}
+
+void VirtualTimer::attach(uint32_t milliseconds, bool repeat, const std::function<void()> &callback) {
+    HeapScope scope(Heap_Timer);
+    _callback = callback;
+    _dueUs = _clock.nowUs() + milliseconds * 1000ULL;
+    _periodUs = repeat ? milliseconds * 1000ULL : 0;
+    _clock.arm(this);
+}
+
+void VirtualTimer::detach() {
+    _clock.disarm(this);
+}
+
+VirtualTimer::~VirtualTimer() {
+    detach();
+}
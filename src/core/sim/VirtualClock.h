@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "core/Timer.h"
+
+class VirtualTimer;
+
+/**
+ * Time that only moves on advance(), timers fire in deadline order with now() set to their
+ * deadline, so hours of scheduling run in milliseconds and always in the same order.
+ */
+class VirtualClock {
+    friend class VirtualTimer;
+
+    uint64_t _nowUs{0};
+    uint64_t _sequence{0};
+    uint64_t _fired{0};
+    std::vector<VirtualTimer *> _timers;
+    std::vector<std::function<void()>> _pumps;
+
+private:
+    void arm(VirtualTimer *timer);
+
+    void disarm(VirtualTimer *timer);
+
+    VirtualTimer *next(uint64_t until);
+
+    void pump();
+
+public:
+    [[nodiscard]] uint64_t nowUs() const {
+        return _nowUs;
+    }
+
+    [[nodiscard]] uint64_t nowMs() const {
+        return _nowUs / 1000;
+    }
+
+    [[nodiscard]] uint64_t getFiredCount() const {
+        return _fired;
+    }
+
+    [[nodiscard]] size_t getArmedCount() const {
+        return _timers.size();
+    }
+
+    /**
+     * Runs after every timer and at the end of advance(), used to drain simulated buses so
+     * handlers see the time their message was due at.
+     */
+    void addPump(const std::function<void()> &pump);
+
+    void advance(uint64_t milliseconds);
+
+    void advanceUs(uint64_t microseconds);
+
+    /**
+     * Advances to the next armed timer, returns false when none is armed.
+     */
+    bool step();
+
+    ~VirtualClock();
+};
+
+namespace sim {
+    /**
+     * Process wide clock used by backends and timers created without an explicit one.
+     */
+    VirtualClock &clock();
+}
+
+class VirtualTimer : public Timer {
+    friend class VirtualClock;
+
+    VirtualClock &_clock;
+    std::function<void()> _callback;
+    uint64_t _dueUs{0};
+    uint64_t _periodUs{0};
+    uint64_t _sequence{0};
+    bool _armed{false};
+public:
+    explicit VirtualTimer(VirtualClock &clock = sim::clock()) : _clock(clock) {}
+
+    void attach(uint32_t milliseconds, bool repeat, const std::function<void()> &callback) override;
+
+    void detach();
+
+    ~VirtualTimer() override;
+};
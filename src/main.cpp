@@ -1,12 +1,18 @@
 #include "core/Logger.h"
 #include <Arduino.h>
+#include <atomic>
 
 #include "core/Registry.h"
 #include "core/service/WifiService.h"
 #include "core/service/MqttService.h"
+#include "core/service/TelemetryService.h"
+#include "core/service/WorkerService.h"
+#include "core/service/BridgeService.h"
+#include "core/service/RateService.h"
+#include "core/service/FileService.h"
 #include "StatusService.h"
 
-struct MagicAction : TMessage<0> {
+struct MagicAction : TMessage<Usr_Magic_Action> {
     uint8_t actionId{0};
 };
 
@@ -20,28 +26,84 @@ void fromJson(cJSON *json, MagicAction &props) {
     }
 }
 
-class App : public Application, public TMessageSubscriber<App, MagicAction> {
+class App : public Application, public TMessageSubscriber<App, MagicAction, MqttConnected> {
+    // status goes out change-only, used from the worker task only
+    JsonDeltaPublisher _statusDelta{60};
+    // set on the bus task, the next status encode starts over with a keyframe
+    std::atomic<bool> _statusResync{false};
+    CodecRegistry _codecs;
 public:
     void onSetup() override {
+        addSystemCodecs(_codecs);
+        _codecs.add<MagicAction>([](const MagicAction& msg, ByteWriter& out) {
+            out.put(msg.actionId);
+        }, [](ByteReader& in, MagicAction& msg) {
+            msg.actionId = in.get<uint8_t>();
+        });
+
         getRegistry().getPropsLoader().addReader("wifi", defaultPropertiesReader<WifiProperties>);
         getRegistry().getPropsLoader().addReader("mqtt", defaultPropertiesReader<MqttProperties>);
+        getRegistry().getPropsLoader().addReader("telemetry", defaultPropertiesReader<TelemetryProperties>);
+        getRegistry().getPropsLoader().addReader("rate", defaultPropertiesReader<RateProperties>);
 
-        getRegistry().getMessageBus().subscribe(this);
+        auto& bus = getRegistry().getMessageBus();
+        bus.subscribe(this);
+        // periodic state and samples are replaced by the next ones, nobody waits for room for
+        // them; a closed telemetry window is parked until the bus drains
+        bus.setOverflowPolicy(StatusMessage::ID, Overflow_DropNewest);
+        bus.setOverflowPolicy(TelemetrySample::ID, Overflow_DropNewest);
+        bus.setOverflowPolicy(TelemetrySummary::ID, Overflow_Spill);
         getRegistry().create<WifiService>();
 
+        // JSON parsing and printing stay off the bus task; a single worker, so the status
+        // encodes below never run at the same time
+        auto& workers = getRegistry().create<WorkerService>((uint8_t) 1);
+        // logs what reading the config and certificates cost at boot
+        getRegistry().create<FileService>(workers);
         auto& mqtt = getRegistry().create<MqttService>();
-        mqtt.subscribe("/magic-action", 0, [&](std::string_view topic, std::string_view payload) {
-            recvJsonMqttMsg<MagicAction>(getRegistry().getMessageBus(), payload);
+        mqtt.subscribe("/magic-action", 0, [&workers](std::string_view topic, std::string_view payload) {
+            workers.submit([data = std::string(payload)]() {
+                return parseJsonMqttMsg<MagicAction>(data);
+            });
+        });
+        // status and telemetry slow down while the link is congested
+        auto& rate = getRegistry().create<RateService>(mqtt);
+        auto reply = mqtt.addTopic("/magic-action-reply");
+        workers.offload<StatusMessage>([this, reply, &rate](const StatusMessage& msg) {
+            // local subscribers see every status, only the uplink is throttled
+            if (!rate.tryAcquire(Rate_State)) {
+                return Message::Ptr();
+            }
+            if (_statusResync.exchange(false)) {
+                _statusDelta.reset();
+            }
+            return _statusDelta.make(reply, msg);
         });
-        getRegistry().getMessageBus().subscribe<StatusMessage>([this](const StatusMessage& msg) {
-            sendJsonMqttMsg(getRegistry().getMessageBus(), "/magic-action-reply", msg);
+        // one summary per metric and window instead of every sample
+        getRegistry().create<TelemetryService>();
+        auto telemetry = mqtt.addTopic("/telemetry");
+        workers.offload<TelemetrySummary>([telemetry, &rate](const TelemetrySummary& msg) {
+            if (!rate.tryAcquire(Rate_Telemetry)) {
+                return Message::Ptr();
+            }
+            return makeJsonMqttMsg(telemetry, msg);
         });
         getRegistry().create<StatusService>();
+
+        // actions reach the rest of the fleet through the broker, peers' actions arrive here
+        auto& bridge = getRegistry().create<BridgeService>(mqtt, _codecs);
+        bridge.exportType<MagicAction>();
+        bridge.importType<MagicAction>();
     }
 
     void onMessage(const MagicAction& msg) {
         esp_logi(app, "action: %d", msg.actionId);
     }
+
+    void onMessage(const MqttConnected&) {
+        // the broker may have lost what we sent, start over with a keyframe
+        _statusResync = true;
+    }
 };
 
 App app;